@@ -16,47 +16,11 @@
 
 #pragma once
 
-#include <cmath>
 #include "Particle.h"
+#include "thermistor_curve.h"
 
 namespace particle {
 
-/**
- * @brief Resistor divider circuit used for thermistor.
- *
- */
-enum class ThermistorCircuit {
-  NONE,                                 /**< No configuration */
-  LOW_SIDE_DIVIDER,                     /**< Thermistor is on the low side of the divider.  V = Vcc * Rt / (Rt + Rfixed) */
-  HIGH_SIDE_DIVIDER,                    /**< Thermistor is on the high side of the divider.  V = Vcc * Rfixed / (Rt + Rfixed) */
-};
-
-/**
- * @brief Type of thermistor.
- *
- */
-enum class ThermistorType {
-  NONE,                                 /**< No configuration */
-  POSITIVE_COEFF,                       /**< Positive temperature coefficient thermistor */
-  NEGATIVE_COEFF,                       /**< Negative temperature coefficient thermistor */
-};
-
-/**
- * @brief Structure to configure thermistor reading.
- *
- */
-struct ThermistorConfig {
-  ThermistorCircuit circuit;            /**< Circuit details for resistor divider. */
-  ThermistorType type;                  /**< Type of thermistor. */
-  float beta;                           /**< Beta parameter for thermistor. */
-  float t0;                             /**< Temperature for reference resistance. */
-  float r0;                             /**< Reference resitance at reference temperature. */
-  float fixedR;                         /**< Fixed resistor used in resistor divider with thermistor. */
-  float adcResolution;                  /**< Maximum ADC value. */
-  float minTemperature;                 /**< Minumum temperature that can be measured with sensor. */
-  float maxTemperature;                 /**< Maximum temperature that can be measured with sensor. */
-};
-
 /**
  * @brief Thermistor class to read from various resistor topologies and types.
  *
@@ -70,18 +34,7 @@ public:
    *
    */
   Thermistor() :
-    inputPin_(PIN_INVALID),
-    config_((ThermistorConfig){
-      .circuit        = ThermistorCircuit::NONE,
-      .type           = ThermistorType::NONE,
-      .beta           = 1.0,
-      .t0             = 1.0,
-      .r0             = 1.0,
-      .fixedR         = 1.0,
-      .adcResolution  = 4096.0,
-      .minTemperature = 1.0,
-      .maxTemperature = 1.0}),
-    ratioNormalize_(1.0f) {
+    inputPin_(PIN_INVALID) {
 
   }
 
@@ -123,10 +76,7 @@ public:
     CHECK_TRUE((config.t0 > -kelvinCelcius_), SYSTEM_ERROR_INVALID_ARGUMENT);
 
     inputPin_ = inputPin;
-    config_ = config;
-
-    // Compute constants so that they do not need to be calculated on every read
-    ratioNormalize_ = config_.fixedR / config_.r0 * expf(config_.beta / (config_.t0 + kelvinCelcius_));
+    curve_.configure(config);
 
     return SYSTEM_ERROR_NONE;
   }
@@ -137,43 +87,43 @@ public:
    * @return float Temperature in degrees Celcius.
    */
   float getTemperature() {
-    int32_t val = analogRead(inputPin_);
-    float vRatio = val / config_.adcResolution;
-    float rRatio = 1.0;
-
-    switch (config_.circuit) {
-      case ThermistorCircuit::LOW_SIDE_DIVIDER: {
-        rRatio = vRatio / (1.0 - vRatio);
-        break;
-      }
-
-      case ThermistorCircuit::HIGH_SIDE_DIVIDER: {
-        rRatio = (1.0 - vRatio) / vRatio;
-        break;
-      }
-
-      default: {
-        return SYSTEM_ERROR_INVALID_STATE;
-      }
-
-    }
-
-    // T = B / ln(rratio)
-    rRatio *= ratioNormalize_;
-    float temperature = config_.beta / logf(rRatio) - kelvinCelcius_;
-    if ((temperature < config_.minTemperature) || (temperature > config_.maxTemperature)) {
-      temperature = ThermistorError;
-    }
-
-    return temperature;
+    return convert(read());
+  }
+
+  /**
+   * @brief Get a raw ADC reading from the thermistor input.
+   *
+   * @return int32_t ADC reading.
+   */
+  int32_t read() {
+    return analogRead(inputPin_);
+  }
+
+  /**
+   * @brief Convert an ADC reading to temperature by interpolating the lookup table.
+   *
+   * @param val ADC reading.
+   * @return float Temperature in degrees Celcius.
+   */
+  float convert(int32_t val) {
+    return curve_.convert(val);
+  }
+
+  /**
+   * @brief Convert an ADC reading to temperature with the beta equation.
+   *
+   * @param val ADC reading.
+   * @return float Temperature in degrees Celcius.
+   */
+  float convertExact(int32_t val) {
+    return curve_.convertExact(val);
   }
 
 private:
   const float kelvinCelcius_ = 273.15f; // 0 degree Kelvin = -273.15 degrees C
 
   pin_t inputPin_;
-  ThermistorConfig config_;
-  float ratioNormalize_;
+  ThermistorCurve curve_;
 }; // class Thermistor
 
 } // namespace particle
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+namespace particle {
+
+/**
+ * @brief Resistor divider circuit used for thermistor.
+ *
+ */
+enum class ThermistorCircuit {
+  NONE,                                 /**< No configuration */
+  LOW_SIDE_DIVIDER,                     /**< Thermistor is on the low side of the divider.  V = Vcc * Rt / (Rt + Rfixed) */
+  HIGH_SIDE_DIVIDER,                    /**< Thermistor is on the high side of the divider.  V = Vcc * Rfixed / (Rt + Rfixed) */
+};
+
+/**
+ * @brief Type of thermistor.
+ *
+ */
+enum class ThermistorType {
+  NONE,                                 /**< No configuration */
+  POSITIVE_COEFF,                       /**< Positive temperature coefficient thermistor */
+  NEGATIVE_COEFF,                       /**< Negative temperature coefficient thermistor */
+};
+
+// Entries in the ADC to temperature lookup table, evenly spaced over the ADC range
+constexpr size_t ThermistorTableSize = 257;
+
+/**
+ * @brief Structure to configure thermistor reading.
+ *
+ */
+struct ThermistorConfig {
+  ThermistorCircuit circuit;            /**< Circuit details for resistor divider. */
+  ThermistorType type;                  /**< Type of thermistor. */
+  float beta;                           /**< Beta parameter for thermistor. */
+  float t0;                             /**< Temperature for reference resistance. */
+  float r0;                             /**< Reference resitance at reference temperature. */
+  float fixedR;                         /**< Fixed resistor used in resistor divider with thermistor. */
+  float adcResolution;                  /**< Maximum ADC value. */
+  float minTemperature;                 /**< Minumum temperature that can be measured with sensor. */
+  float maxTemperature;                 /**< Maximum temperature that can be measured with sensor. */
+};
+
+/**
+ * @brief Conversion of ADC readings to temperature, without any system dependencies.
+ *
+ */
+class ThermistorCurve {
+public:
+  const float ThermistorError = -300.0; /**< Error value */
+
+  /**
+   * @brief Construct a new, unconfigured, ThermistorCurve object
+   *
+   */
+  ThermistorCurve() :
+    config_((ThermistorConfig){
+      .circuit        = ThermistorCircuit::NONE,
+      .type           = ThermistorType::NONE,
+      .beta           = 1.0,
+      .t0             = 1.0,
+      .r0             = 1.0,
+      .fixedR         = 1.0,
+      .adcResolution  = 4096.0,
+      .minTemperature = 1.0,
+      .maxTemperature = 1.0}),
+    ratioNormalize_(1.0f),
+    tableScale_(0.0f) {
+
+  }
+
+  /**
+   * @brief Compute the conversion constants and lookup table for a configuration.
+   *
+   * @param config Configuration settings, already validated by the caller.
+   */
+  void configure(const ThermistorConfig& config) {
+    config_ = config;
+
+    // Compute constants so that they do not need to be calculated on every read
+    ratioNormalize_ = config_.fixedR / config_.r0 * expf(config_.beta / (config_.t0 + kelvinCelcius_));
+
+    // Tabulate the curve, in hundredths of a degree, once so that reads only interpolate.  Entries
+    // beyond the representable range are saturated rather than dropped so that the range check
+    // still applies after interpolation.
+    tableScale_ = (ThermistorTableSize - 1) / config_.adcResolution;
+    for (size_t i = 0; i < ThermistorTableSize; i++) {
+      float temperature = calculate(i * config_.adcResolution / (ThermistorTableSize - 1));
+      temperature = std::max(temperature * 100.0f, (float)INT16_MIN);
+      temperature = std::min(temperature, (float)INT16_MAX);
+      table_[i] = (int16_t)lroundf(temperature);
+    }
+  }
+
+  /**
+   * @brief Convert an ADC reading to temperature by interpolating the lookup table.
+   *
+   * @param val ADC reading.
+   * @return float Temperature in degrees Celcius.
+   */
+  float convert(int32_t val) const {
+    if (config_.circuit == ThermistorCircuit::NONE) {
+      return ThermistorError;
+    }
+
+    float position = std::max(val, (int32_t)0) * tableScale_;
+    size_t index = (size_t)position;
+    if (index >= ThermistorTableSize - 1) {
+      index = ThermistorTableSize - 2;
+    }
+    float fraction = std::min(position - index, 1.0f);
+
+    float temperature = (table_[index] + (table_[index + 1] - table_[index]) * fraction) / 100.0f;
+
+    return checkRange(temperature);
+  }
+
+  /**
+   * @brief Convert an ADC reading to temperature with the beta equation.
+   *
+   * @param val ADC reading.
+   * @return float Temperature in degrees Celcius.
+   */
+  float convertExact(int32_t val) const {
+    if (config_.circuit == ThermistorCircuit::NONE) {
+      return ThermistorError;
+    }
+
+    return checkRange(calculate(val));
+  }
+
+private:
+  const float kelvinCelcius_ = 273.15f; // 0 degree Kelvin = -273.15 degrees C
+
+  float calculate(float val) const {
+    float vRatio = val / config_.adcResolution;
+    float rRatio = 1.0;
+
+    switch (config_.circuit) {
+      case ThermistorCircuit::LOW_SIDE_DIVIDER: {
+        rRatio = vRatio / (1.0 - vRatio);
+        break;
+      }
+
+      case ThermistorCircuit::HIGH_SIDE_DIVIDER: {
+        rRatio = (1.0 - vRatio) / vRatio;
+        break;
+      }
+
+      default: {
+        return ThermistorError;
+      }
+
+    }
+
+    // A shorted thermistor is as hot as it gets, an open one ends up at absolute zero below
+    if (rRatio <= 0.0f) {
+      return INFINITY;
+    }
+
+    // T = B / ln(rratio)
+    rRatio *= ratioNormalize_;
+    return config_.beta / logf(rRatio) - kelvinCelcius_;
+  }
+
+  float checkRange(float temperature) const {
+    if ((temperature < config_.minTemperature) || (temperature > config_.maxTemperature)) {
+      temperature = ThermistorError;
+    }
+
+    return temperature;
+  }
+
+  ThermistorConfig config_;
+  float ratioNormalize_;
+  float tableScale_;
+  int16_t table_[ThermistorTableSize];
+}; // class ThermistorCurve
+
+} // namespace particle
@@ -35,6 +35,7 @@ SYSTEM_MODE(MANUAL);
 
 #define TEST_THERMISTOR_PIN             (A0)
 static unsigned long UPDATE_DELAY = 1000; // milliseconds
+static constexpr int32_t TEST_ADC_COUNTS = 4096;
 
 // Configuration based on Panasonic ERTJ1VR104FM NTC thermistor
 ThermistorConfig config = {
@@ -51,6 +52,49 @@ ThermistorConfig config = {
 
 Thermistor thermistor;
 
+// Compare the lookup table against the beta equation for every ADC value and time both.  The host
+// test in test/thermistor_test.cpp checks the same error bound without hardware.
+void compareConversions() {
+    float maxError = 0.0f;
+    int32_t maxErrorValue = 0;
+    unsigned int rangeMismatches = 0;
+
+    for (int32_t val = 0; val < TEST_ADC_COUNTS; val++) {
+        float table = thermistor.convert(val);
+        float exact = thermistor.convertExact(val);
+        bool tableError = (table == thermistor.ThermistorError);
+        bool exactError = (exact == thermistor.ThermistorError);
+
+        if (tableError != exactError) {
+            rangeMismatches++;
+        }
+        else if (!tableError && (fabsf(table - exact) > maxError)) {
+            maxError = fabsf(table - exact);
+            maxErrorValue = val;
+        }
+    }
+
+    Serial1.printlnf("max error %.3f degC at ADC %ld, %u range mismatches", maxError, maxErrorValue, rangeMismatches);
+
+    volatile float sink = 0.0f;
+    uint32_t start = System.ticks();
+    for (int32_t val = 0; val < TEST_ADC_COUNTS; val++) {
+        sink = thermistor.convert(val);
+    }
+    uint32_t tableTicks = System.ticks() - start;
+
+    start = System.ticks();
+    for (int32_t val = 0; val < TEST_ADC_COUNTS; val++) {
+        sink = thermistor.convertExact(val);
+    }
+    uint32_t exactTicks = System.ticks() - start;
+    (void)sink;
+
+    Serial1.printlnf("cycles per conversion: table %lu, exact %lu",
+        tableTicks / TEST_ADC_COUNTS,
+        exactTicks / TEST_ADC_COUNTS);
+}
+
 // !!! Note: your experience will be much more rewarding if you use Serial1 versus Serial
 
 void setup() {
@@ -63,6 +107,9 @@ void setup() {
     if (ret != SYSTEM_ERROR_NONE) {
         Serial1.printf("Thermistor.begin() failed.\r\n");
     }
+    else {
+        compareConversions();
+    }
 }
 
 volatile bool once = false;
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "threshold.h"
+
+ThresholdClock Threshold::clock_ = nullptr;
+ThresholdLogger Threshold::logger_ = nullptr;
+
+void Threshold::setClock(ThresholdClock clock) {
+    clock_ = clock;
+}
+
+void Threshold::setLogger(ThresholdLogger logger) {
+    logger_ = logger;
+}
+
+void Threshold::log(ThresholdTransition transition, float value) const {
+    if (logger_ && config_.name) {
+        logger_(config_.name, transition, value);
+    }
+}
+
+Threshold::Threshold(const ThresholdConfig& config)
+    : config_(config) {
+
+    reset();
+}
+
+void Threshold::setLimit(float limit, float hysteresis) {
+    config_.limit = limit;
+    config_.hysteresis = hysteresis;
+}
+
+bool Threshold::isOutside(float value) const {
+    return (config_.direction == ThresholdDirection::ABOVE) ?
+        (value >= config_.limit) : (value <= config_.limit);
+}
+
+bool Threshold::isPastHysteresis(float value) const {
+    return (config_.direction == ThresholdDirection::ABOVE) ?
+        (value <= config_.limit - config_.hysteresis) : (value >= config_.limit + config_.hysteresis);
+}
+
+void Threshold::setState(ThresholdState state, uint64_t now) {
+    if (timed_) {
+        auto elapsed = now - stats_.lastTransitionMs;
+        if (isActive()) {
+            stats_.activeMs += elapsed;
+        }
+        else if (state_ != ThresholdState::UNKNOWN) {
+            stats_.inactiveMs += elapsed;
+        }
+    }
+
+    if ((state_ != ThresholdState::UNKNOWN) && (state != state_)) {
+        stats_.transitions++;
+    }
+    stats_.lastTransitionMs = now;
+    timed_ = true;
+    state_ = state;
+    candidateCount_ = 0;
+}
+
+ThresholdTransition Threshold::update(float value, uint64_t now) {
+    if (!timed_) {
+        stats_.lastTransitionMs = now;
+        timed_ = true;
+    }
+
+    switch (state_) {
+        case ThresholdState::UNKNOWN:
+            setState(ThresholdState::NORMAL, now);
+            // Fall through
+        case ThresholdState::NORMAL: {
+            if (!isOutside(value)) {
+                candidateCount_ = 0;
+                break;
+            }
+            if (++candidateCount_ >= config_.debounce) {
+                setState(ThresholdState::OUTSIDE_LIMIT, now);
+                stats_.entries++;
+                log(ThresholdTransition::ENTERED, value);
+                return ThresholdTransition::ENTERED;
+            }
+            break;
+        }
+
+        case ThresholdState::OUTSIDE_LIMIT:
+            if (isOutside(value)) {
+                break;
+            }
+            // A value already past the hysteresis band exits on this update
+            setState(ThresholdState::INSIDE_LIMIT, now);
+            // Fall through
+        case ThresholdState::INSIDE_LIMIT: {
+            if (isOutside(value)) {
+                setState(ThresholdState::OUTSIDE_LIMIT, now);
+                break;
+            }
+            if (!isPastHysteresis(value)) {
+                candidateCount_ = 0;
+                break;
+            }
+            if (++candidateCount_ >= config_.debounce) {
+                setState(ThresholdState::NORMAL, now);
+                log(ThresholdTransition::EXITED, value);
+                return ThresholdTransition::EXITED;
+            }
+            break;
+        }
+    }
+
+    return ThresholdTransition::NONE;
+}
+
+bool Threshold::isActive() const {
+    return (state_ == ThresholdState::OUTSIDE_LIMIT) || (state_ == ThresholdState::INSIDE_LIMIT);
+}
+
+ThresholdState Threshold::getState() const {
+    return state_;
+}
+
+void Threshold::restore(ThresholdState state) {
+    switch (state) {
+        case ThresholdState::NORMAL:
+        case ThresholdState::OUTSIDE_LIMIT:
+        case ThresholdState::INSIDE_LIMIT:
+            state_ = state;
+            break;
+
+        default:
+            state_ = ThresholdState::UNKNOWN;
+            break;
+    }
+    candidateCount_ = 0;
+    timed_ = false;
+}
+
+void Threshold::reset() {
+    state_ = ThresholdState::UNKNOWN;
+    candidateCount_ = 0;
+    stats_ = {};
+    timed_ = false;
+}
+
+void Threshold::getStats(ThresholdStats& stats, uint64_t now) const {
+    stats = stats_;
+    if (timed_) {
+        auto elapsed = now - stats_.lastTransitionMs;
+        if (isActive()) {
+            stats.activeMs += elapsed;
+        }
+        else if (state_ != ThresholdState::UNKNOWN) {
+            stats.inactiveMs += elapsed;
+        }
+    }
+}
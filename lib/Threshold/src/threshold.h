@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Side of the limit on which the threshold is active.
+ *
+ */
+enum class ThresholdDirection {
+    ABOVE,                          /**< Active at or above the limit */
+    BELOW,                          /**< Active at or below the limit */
+};
+
+/**
+ * @brief State of a threshold.  Values are stable as they are kept in retained memory.
+ *
+ */
+enum class ThresholdState : uint8_t {
+    UNKNOWN = 0,                    /**< Not evaluated yet */
+    NORMAL = 1,                     /**< Value is inside the limit and past the hysteresis band */
+    OUTSIDE_LIMIT = 2,              /**< Value is outside the limit */
+    INSIDE_LIMIT = 3,               /**< Value is back inside the limit but not yet past the hysteresis band */
+};
+
+/**
+ * @brief Change reported by a threshold update.
+ *
+ */
+enum class ThresholdTransition {
+    NONE,                           /**< Threshold stayed active, or stayed inactive */
+    ENTERED,                        /**< Threshold became active */
+    EXITED,                         /**< Threshold became inactive */
+};
+
+/**
+ * @brief Threshold settings.
+ *
+ */
+struct ThresholdConfig {
+    const char* name;               /**< Name used in logs, may be null */
+    ThresholdDirection direction;   /**< Side of the limit on which the threshold is active */
+    float limit;                    /**< Value at which the threshold becomes active (inclusive) */
+    float hysteresis;               /**< Distance past the limit, back inside, where the threshold becomes inactive (inclusive) */
+    unsigned int debounce;          /**< Count of consecutive updates agreeing before the threshold becomes active or inactive */
+};
+
+/**
+ * @brief Time spent in, and transitions between, threshold states.
+ *
+ */
+struct ThresholdStats {
+    uint32_t entries;               /**< Count of times the threshold became active */
+    uint32_t transitions;           /**< Count of state changes of any kind */
+    uint64_t activeMs;              /**< Time, in milliseconds, spent active */
+    uint64_t inactiveMs;            /**< Time, in milliseconds, spent inactive */
+    uint64_t lastTransitionMs;      /**< Time, in milliseconds, of the last state change */
+};
+
+/**
+ * @brief Source of the current time, in milliseconds, for updates that don't give one.
+ *
+ */
+using ThresholdClock = uint64_t (*)();
+
+/**
+ * @brief Receiver of transitions for logging, only called for thresholds with a name.
+ *
+ */
+using ThresholdLogger = void (*)(const char* name, ThresholdTransition transition, float value);
+
+/**
+ * @brief Hysteresis state machine for one analog threshold.
+ *
+ * A threshold becomes active when the value reaches the limit, stays active while the value moves back
+ * inside the limit, and only becomes inactive once the value is past the hysteresis band.  Several
+ * thresholds on the same value, checked in priority order, make up bands such as charging temperature
+ * ranges.
+ *
+ * The library has no system dependencies.  The application provides the clock, such as System.millis(),
+ * and optionally a logger once at startup.
+ */
+class Threshold {
+public:
+    Threshold(const ThresholdConfig& config);
+
+    /**
+     * @brief Set the clock used by updates that don't give a time
+     *
+     * @param clock Function returning the current time, in milliseconds
+     */
+    static void setClock(ThresholdClock clock);
+
+    /**
+     * @brief Set the function that logs transitions
+     *
+     * @param logger Function receiving transitions, or nullptr for none
+     */
+    static void setLogger(ThresholdLogger logger);
+
+    /**
+     * @brief Change the limit and hysteresis, keeping the current state
+     *
+     * @param limit Value at which the threshold becomes active
+     * @param hysteresis Distance back inside the limit where the threshold becomes inactive
+     */
+    void setLimit(float limit, float hysteresis);
+
+    /**
+     * @brief Evaluate a new value
+     *
+     * @param value Value to evaluate
+     * @param now Time of the value, in milliseconds
+     * @return ThresholdTransition Change in whether the threshold is active
+     */
+    ThresholdTransition update(float value, uint64_t now);
+
+    /**
+     * @brief Evaluate a new value at the current time of the clock
+     *
+     * @param value Value to evaluate
+     * @return ThresholdTransition Change in whether the threshold is active
+     */
+    ThresholdTransition update(float value) {
+        return update(value, (clock_) ? clock_() : 0);
+    }
+
+    /**
+     * @brief Indicate if the threshold is active
+     *
+     * @return true Value reached the limit and has not been past the hysteresis band since
+     * @return false Threshold is inactive
+     */
+    bool isActive() const;
+
+    /**
+     * @brief Get the state of the threshold
+     *
+     * @return ThresholdState Current state
+     */
+    ThresholdState getState() const;
+
+    /**
+     * @brief Resume from a saved state without counting a transition
+     *
+     * @param state State to resume from
+     */
+    void restore(ThresholdState state);
+
+    /**
+     * @brief Return to the unknown state and clear statistics
+     *
+     */
+    void reset();
+
+    /**
+     * @brief Get statistics, including time in the current state up to now
+     *
+     * @param stats Returned statistics
+     * @param now Current time, in milliseconds
+     */
+    void getStats(ThresholdStats& stats, uint64_t now) const;
+
+private:
+    bool isOutside(float value) const;
+    bool isPastHysteresis(float value) const;
+    void setState(ThresholdState state, uint64_t now);
+    void log(ThresholdTransition transition, float value) const;
+
+    static ThresholdClock clock_;
+    static ThresholdLogger logger_;
+
+    ThresholdConfig config_;
+    ThresholdState state_;
+    unsigned int candidateCount_;
+    ThresholdStats stats_;
+    bool timed_;
+};
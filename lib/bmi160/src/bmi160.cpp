@@ -24,6 +24,17 @@ using namespace particle;
 
 namespace {
 
+// Convert three little endian 16-bit samples to the given full scale range
+template <typename T>
+void decodeAxes(const uint8_t* buffer, float range, float fullRange, T& data) {
+    auto x = littleEndianToNative<int16_t>(*(reinterpret_cast<const int16_t*>(&buffer[0])));
+    data.x = (float)x * range / fullRange;
+    auto y = littleEndianToNative<int16_t>(*(reinterpret_cast<const int16_t*>(&buffer[2])));
+    data.y = (float)y * range / fullRange;
+    auto z = littleEndianToNative<int16_t>(*(reinterpret_cast<const int16_t*>(&buffer[4])));
+    data.z = (float)z * range / fullRange;
+}
+
 } // anonymous namespace
 
 
@@ -36,7 +47,14 @@ Bmi160::Bmi160()
           gyroPmu_(PMU_STATUS_GYRO_SUSPEND),
           rangeAccel_(BMI160_ACCEL_RANGE_DEFAULT),
           rateAccel_(BMI160_ACCEL_RATE_DEFAULT),
+          rangeGyro_(BMI160_GYRO_RANGE_DEFAULT),
+          rateGyro_(BMI160_GYRO_RATE_DEFAULT),
+          fifoGyro_(false),
           latchShadow_(0),
+          shadowValid_(false),
+          shadowDirty_(0),
+          updateDepth_(0),
+          updateDiscarded_(false),
           motionSyncQueue_(nullptr) {
 
 }
@@ -61,6 +79,10 @@ int Bmi160::initialize() {
     const std::lock_guard<RecursiveMutex> lock(mutex_);
     CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
 
+    // Start from the reset contents of the configuration registers
+    CHECK(loadShadow());
+    UpdateGuard update(*this);
+
     uint8_t reg = 0;
 
     // Disable INT2 and enable INT1.  Latch interrupt for 160 ms
@@ -97,7 +119,7 @@ int Bmi160::initialize() {
         ));
     CHECK(writeRegister(Bmi160Register::INT_MAP_2_ADDR, 0x00));
 
-    return SYSTEM_ERROR_NONE;
+    return update.apply();
 }
 
 int Bmi160::cleanup() {
@@ -119,7 +141,7 @@ int Bmi160::begin(const TwoWire* interface, uint8_t address, pin_t interruptPin,
     CHECK_FALSE(initialized_, SYSTEM_ERROR_NONE);
     CHECK_TRUE(interface, SYSTEM_ERROR_INVALID_ARGUMENT);
 
-    if (os_queue_create(&motionSyncQueue_, sizeof(Bmi160EventType), eventDepth, nullptr)) {
+    if (os_queue_create(&motionSyncQueue_, sizeof(Bmi160EventItem), eventDepth, nullptr)) {
         motionSyncQueue_ = nullptr;
         LOG(ERROR, "os_queue_create() failed");
         return SYSTEM_ERROR_INTERNAL;
@@ -150,7 +172,7 @@ int Bmi160::begin(const SPIClass& interface, pin_t selectPin, pin_t interruptPin
     const std::lock_guard<RecursiveMutex> lock(mutex_);
     CHECK_FALSE(initialized_, SYSTEM_ERROR_NONE);
 
-    if (os_queue_create(&motionSyncQueue_, sizeof(Bmi160EventType), eventDepth, nullptr)) {
+    if (os_queue_create(&motionSyncQueue_, sizeof(Bmi160EventItem), eventDepth, nullptr)) {
         motionSyncQueue_ = nullptr;
         LOG(ERROR, "os_queue_create() failed");
         return SYSTEM_ERROR_INTERNAL;
@@ -182,6 +204,10 @@ int Bmi160::end() {
     address_ = INVALID_I2C_ADDRESS;
     rangeAccel_ = BMI160_ACCEL_RANGE_DEFAULT;
     rateAccel_ = BMI160_ACCEL_RATE_DEFAULT;
+    rangeGyro_ = BMI160_GYRO_RANGE_DEFAULT;
+    rateGyro_ = BMI160_GYRO_RATE_DEFAULT;
+    fifoGyro_ = false;
+    shadowValid_ = false;
 
     initialized_ = true;
 
@@ -196,8 +222,12 @@ int Bmi160::reset() {
     }
     CHECK(writeRegister(Bmi160Register::CMD_ADDR, Bmi160Command::CMD_SOFT_RESET));
     delay(BMI160_SOFT_RESET_CMD_TIME);
+    shadowValid_ = false;
     accelPmu_ = PMU_STATUS_ACC_SUSPEND;
     gyroPmu_ = PMU_STATUS_GYRO_SUSPEND;
+    rangeGyro_ = BMI160_GYRO_RANGE_DEFAULT;
+    rateGyro_ = BMI160_GYRO_RATE_DEFAULT;
+    fifoGyro_ = false;
 
     if (type_ == InterfaceType::BMI_SPI) {
         CHECK(setSpiMode());
@@ -215,12 +245,31 @@ int Bmi160::sleep() {
     return SYSTEM_ERROR_NONE;
 }
 
-int Bmi160::wakeup() {
+int Bmi160::wakeup(bool normal) {
     const std::lock_guard<RecursiveMutex> lock(mutex_);
     CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
-    CHECK(writeRegister(Bmi160Register::CMD_ADDR, Bmi160Command::CMD_ACC_PMU_MODE_LOW));
+    // Low power mode duty cycles the accelerometer, normal mode samples continuously
+    CHECK(writeRegister(Bmi160Register::CMD_ADDR, (normal) ? Bmi160Command::CMD_ACC_PMU_MODE_NORMAL : Bmi160Command::CMD_ACC_PMU_MODE_LOW));
     delay(BMI160_ACC_PMU_CMD_TIME);
-    accelPmu_ = PMU_STATUS_ACC_LOW;
+    accelPmu_ = (normal) ? PMU_STATUS_ACC_NORMAL : PMU_STATUS_ACC_LOW;
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::sleepGyro() {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+    // Mark the gyroscope suspended first so that the command is followed by the longer idle time if needed
+    gyroPmu_ = PMU_STATUS_GYRO_SUSPEND;
+    CHECK(writeRegister(Bmi160Register::CMD_ADDR, Bmi160Command::CMD_GYR_PMU_MODE_SUSPEND));
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::wakeupGyro() {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+    CHECK(writeRegister(Bmi160Register::CMD_ADDR, Bmi160Command::CMD_GYR_PMU_MODE_NORMAL));
+    delay(BMI160_GYRO_PMU_CMD_TIME);
+    gyroPmu_ = PMU_STATUS_GYRO_NORMAL;
     return SYSTEM_ERROR_NONE;
 }
 
@@ -229,31 +278,46 @@ void Bmi160::bmi160Handler() {
 }
 
 int Bmi160::syncEvent(Bmi160EventType event) {
+    // Timestamp as early as possible since this is called from the interrupt handler
+    Bmi160EventItem item = {
+        .type = event,
+        .timestamp = (uint32_t)micros(),
+    };
+
     if (motionSyncQueue_) {
-        CHECK_FALSE(os_queue_put(motionSyncQueue_, &event, 0, nullptr), SYSTEM_ERROR_BUSY);
+        CHECK_FALSE(os_queue_put(motionSyncQueue_, &item, 0, nullptr), SYSTEM_ERROR_BUSY);
     }
 
     return SYSTEM_ERROR_NONE;
 }
 
 int Bmi160::waitOnEvent(Bmi160EventType& event, system_tick_t timeout) {
-    Bmi160EventType eventReceive = Bmi160EventType::NONE;
-    auto ret = os_queue_take(motionSyncQueue_, &eventReceive, timeout, nullptr);
+    uint32_t timestamp = 0;
+    return waitOnEvent(event, timestamp, timeout);
+}
+
+int Bmi160::waitOnEvent(Bmi160EventType& event, uint32_t& timestamp, system_tick_t timeout) {
+    Bmi160EventItem itemReceive = {};
+    auto ret = os_queue_take(motionSyncQueue_, &itemReceive, timeout, nullptr);
     if (ret) {
         event = Bmi160EventType::NONE;
+        timestamp = (uint32_t)micros();
     }
     else {
-        event = eventReceive;
+        event = itemReceive.type;
+        timestamp = itemReceive.timestamp;
     }
 
     return SYSTEM_ERROR_NONE;
 }
 
 int Bmi160::setAccelRange(float& range, bool feedback) {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
     auto rangeEnum = Bmi160AccelRange::ACCEL_RANGE_16G;
     auto workRange = range;
 
-    // Assumed lock already acquired
     if (workRange <= ACCEL_RANGE_2G_F) {
         workRange = ACCEL_RANGE_2G_F;
         rangeEnum = Bmi160AccelRange::ACCEL_RANGE_2G;
@@ -292,7 +356,9 @@ float Bmi160::convertOdrToRate(uint8_t odr) {
 }
 
 int Bmi160::setAccelRate(float& rate, bool feedback) {
-    // Assumed lock already acquired
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
     auto workRate = rate;
 
     if (workRate <= 0.0) {
@@ -317,8 +383,152 @@ int Bmi160::setAccelRate(float& rate, bool feedback) {
     return SYSTEM_ERROR_NONE;
 }
 
+int Bmi160::setAccelNoMotionThreshold(float& threshold, bool feedback) {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    CHECK_FALSE(rangeAccel_ == 0, SYSTEM_ERROR_INVALID_STATE);
+
+    auto workThreshold = threshold;
+    float lsbThreshold = (float)rangeAccel_ / INTMO_2_SLO_NO_MOT_TH_LOWEST_RES;
+    float minThreshold = (float)rangeAccel_ / INTMO_2_SLO_NO_MOT_TH_RES;
+    uint8_t reg = 0;
+
+    if (workThreshold <= minThreshold) {
+        workThreshold = minThreshold;
+    }
+    else if (workThreshold >= (float)rangeAccel_) {
+        workThreshold = lsbThreshold * (float)INTMO_2_SLO_NO_MOT_TH_MAX;
+        reg = INTMO_2_SLO_NO_MOT_TH_MAX;
+    }
+    else {
+        auto regThreshold = ceilf(workThreshold / lsbThreshold);
+        reg = (uint8_t)regThreshold;
+        workThreshold = lsbThreshold * reg;
+    }
+
+    // IN_MOTION[2] int_slo_no_mot_th<7:0>
+    CHECK(writeRegister(Bmi160Register::INT_MOTION_2_ADDR, reg));
+
+    if (feedback) {
+        threshold = workThreshold;
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::setAccelNoMotionDuration(float& duration, bool feedback) {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    uint8_t code = 0;
+    float workDuration = 0.0f;
+
+    if (duration <= INTMO_0_NO_MOT_DUR_SHORT_MAX) {
+        auto count = std::max<int>((int)ceilf(duration / INTMO_0_NO_MOT_DUR_SHORT_STEP), 1);
+        code = (uint8_t)(count - 1);
+        workDuration = INTMO_0_NO_MOT_DUR_SHORT_STEP * count;
+    }
+    else if (duration <= INTMO_0_NO_MOT_DUR_MEDIUM_MAX) {
+        auto count = (unsigned)ceilf(duration / INTMO_0_NO_MOT_DUR_MEDIUM_STEP);
+        code = INTMO_0_NO_MOT_DUR_MEDIUM_SEL | (uint8_t)(count - INTMO_0_NO_MOT_DUR_MEDIUM_OFFSET);
+        workDuration = INTMO_0_NO_MOT_DUR_MEDIUM_STEP * count;
+    }
+    else {
+        auto count = std::min<unsigned>((unsigned)ceilf(duration / INTMO_0_NO_MOT_DUR_LONG_STEP),
+            INTMO_0_NO_MOT_DUR_LONG_MAX_COUNT + INTMO_0_NO_MOT_DUR_LONG_OFFSET);
+        code = INTMO_0_NO_MOT_DUR_LONG_SEL | (uint8_t)(count - INTMO_0_NO_MOT_DUR_LONG_OFFSET);
+        workDuration = INTMO_0_NO_MOT_DUR_LONG_STEP * count;
+    }
+
+    // IN_MOTION[0] int_slo_no_mot_dur<5:0>
+    uint8_t reg = 0;
+    CHECK(readRegister(Bmi160Register::INT_MOTION_0_ADDR, &reg));
+    reg &= ~INTMO_0_SLO_NO_DUR_MASK;
+    reg |= INTMO_0_SLO_NO_DUR_MASK & (code << INTMO_0_SLO_NO_DUR_SHIFT);
+    CHECK(writeRegister(Bmi160Register::INT_MOTION_0_ADDR, reg));
+
+    // IN_MOTION[3] int_no_mot_sel, the duration above is only valid for no-motion rather than slow-motion
+    CHECK(readRegister(Bmi160Register::INT_MOTION_3_ADDR, &reg));
+    reg |= INTMO_3_NO_MOT_SEL_MASK;
+    CHECK(writeRegister(Bmi160Register::INT_MOTION_3_ADDR, reg));
+
+    if (feedback) {
+        duration = workDuration;
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::setGyroRange(float& range, bool feedback) {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    auto rangeEnum = Bmi160GyroRange::GYRO_RANGE_2000DPS;
+    auto workRange = range;
+
+    if (workRange <= GYRO_RANGE_125DPS_F) {
+        workRange = GYRO_RANGE_125DPS_F;
+        rangeEnum = Bmi160GyroRange::GYRO_RANGE_125DPS;
+    }
+    else if (workRange <= GYRO_RANGE_250DPS_F) {
+        workRange = GYRO_RANGE_250DPS_F;
+        rangeEnum = Bmi160GyroRange::GYRO_RANGE_250DPS;
+    }
+    else if (workRange <= GYRO_RANGE_500DPS_F) {
+        workRange = GYRO_RANGE_500DPS_F;
+        rangeEnum = Bmi160GyroRange::GYRO_RANGE_500DPS;
+    }
+    else if (workRange <= GYRO_RANGE_1000DPS_F) {
+        workRange = GYRO_RANGE_1000DPS_F;
+        rangeEnum = Bmi160GyroRange::GYRO_RANGE_1000DPS;
+    }
+    else { // less than, equal, or greater than 2000
+        workRange = GYRO_RANGE_2000DPS_F;
+        rangeEnum = Bmi160GyroRange::GYRO_RANGE_2000DPS;
+    }
+
+    CHECK(writeRegister(Bmi160Register::GYR_RANGE_ADDR, rangeEnum));
+    rangeGyro_ = (int)workRange;
+
+    if (feedback) {
+        range = workRange;
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::setGyroRate(float& rate, bool feedback) {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    auto workRate = rate;
+
+    if (workRate <= GYRO_RATE_MIN) {
+        workRate = GYRO_RATE_MIN;
+    }
+    else if (workRate >= GYRO_RATE_MAX) {
+        workRate = GYRO_RATE_MAX;
+    }
+
+    // Same output data rate encoding as the accelerometer
+    auto odr = convertRateToOdr(workRate);
+    uint8_t reg = odr | (GYRO_CONF_BWP_NORMAL << GYR_CONF_BWP_SHIFT);
+
+    CHECK(writeRegister(Bmi160Register::GYR_CONF_ADDR, reg));
+    rateGyro_ = convertOdrToRate(odr);
+
+    if (feedback) {
+        rate = rateGyro_;
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
 int Bmi160::setAccelMotionThreshold(float& threshold, bool feedback) {
-    // Assumed lock already acquired
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
     CHECK_FALSE(rangeAccel_ == 0, SYSTEM_ERROR_INVALID_STATE);
 
     auto workThreshold = threshold;
@@ -351,7 +561,9 @@ int Bmi160::setAccelMotionThreshold(float& threshold, bool feedback) {
 
 
 int Bmi160::setAccelMotionDuration(unsigned& duration, bool feedback) {
-    // Assumed lock already acquired
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
     auto workDuration = duration;
 
     if (workDuration < INTMO_0_ANYM_DUR_MIN) {
@@ -375,8 +587,23 @@ int Bmi160::setAccelMotionDuration(unsigned& duration, bool feedback) {
     return SYSTEM_ERROR_NONE;
 }
 
+int Bmi160::setAccelMotionMode(Bmi160AccelMotionMode mode) {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    // Any-motion detection does not rely on the skip nor proof parameters.
+    uint8_t reg = 0;
+    CHECK(readRegister(Bmi160Register::INT_MOTION_3_ADDR, &reg));
+    reg &= ~INTMO_3_SIG_MOT_SEL_MASK;
+    reg |= (mode == Bmi160AccelMotionMode::ACCEL_MOTION_MODE_SIGNIFICANT) ? INTMO_3_SIG_MOT_SEL_MASK : 0x0;
+    CHECK(writeRegister(Bmi160Register::INT_MOTION_3_ADDR, reg));
+
+    return SYSTEM_ERROR_NONE;
+}
+
 int Bmi160::setAccelMotionSkip(Bmi160AccelSignificantMotionSkip skip) {
-    // Assumed lock already acquired
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
 
     auto skipValue = static_cast<uint8_t>(skip);
 
@@ -391,7 +618,8 @@ int Bmi160::setAccelMotionSkip(Bmi160AccelSignificantMotionSkip skip) {
 }
 
 int Bmi160::setAccelMotionProof(Bmi160AccelSignificantMotionProof proof) {
-    // Assumed lock already acquired
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
 
     auto proofValue = static_cast<uint8_t>(proof);
 
@@ -406,7 +634,9 @@ int Bmi160::setAccelMotionProof(Bmi160AccelSignificantMotionProof proof) {
 }
 
 int Bmi160::setAccelHighGThreshold(float& threshold, bool feedback) {
-    // Assumed lock already acquired
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
     CHECK_FALSE(rangeAccel_ == 0, SYSTEM_ERROR_INVALID_STATE);
 
     auto workThreshold = threshold;
@@ -438,7 +668,9 @@ int Bmi160::setAccelHighGThreshold(float& threshold, bool feedback) {
 }
 
 int Bmi160::setAccelHighGDuration(float& duration, bool feedback) {
-    // Assumed lock already acquired
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
     auto workDuration = duration;
 
     if (workDuration < INTLH_3_HIGH_DUR_MIN) {
@@ -460,7 +692,9 @@ int Bmi160::setAccelHighGDuration(float& duration, bool feedback) {
 }
 
 int Bmi160::setAccelHighGHysteresis(float& hysteresis, bool feedback) {
-    // Assumed lock already acquired
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
     CHECK_FALSE(rangeAccel_ == 0, SYSTEM_ERROR_INVALID_STATE);
 
     auto workHysteresis = hysteresis;
@@ -491,6 +725,7 @@ int Bmi160::setAccelHighGHysteresis(float& hysteresis, bool feedback) {
 int Bmi160::initAccelerometer(Bmi160AccelerometerConfig& config, bool feedback) {
     const std::lock_guard<RecursiveMutex> lock(mutex_);
     CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+    UpdateGuard update(*this);
 
     // Setting maximum range
     CHECK(setAccelRange(config.range, feedback));
@@ -498,7 +733,7 @@ int Bmi160::initAccelerometer(Bmi160AccelerometerConfig& config, bool feedback)
     // Setting for sample rate
     CHECK(setAccelRate(config.rate, feedback));
 
-    return SYSTEM_ERROR_NONE;
+    return update.apply();
 }
 
 int Bmi160::getAccelerometer(Bmi160Accelerometer& data) {
@@ -517,6 +752,45 @@ int Bmi160::getAccelerometer(Bmi160Accelerometer& data) {
     return SYSTEM_ERROR_NONE;
 }
 
+int Bmi160::initNoMotion(Bmi160AccelNoMotionConfig& config, bool feedback) {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+    UpdateGuard update(*this);
+
+    // Setting no-motion threshold
+    CHECK(setAccelNoMotionThreshold(config.threshold, feedback));
+
+    // Setting no-motion duration
+    CHECK(setAccelNoMotionDuration(config.duration, feedback));
+
+    return update.apply();
+}
+
+int Bmi160::initGyroscope(Bmi160GyroscopeConfig& config, bool feedback) {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+    UpdateGuard update(*this);
+
+    // Setting maximum range
+    CHECK(setGyroRange(config.range, feedback));
+
+    // Setting for sample rate
+    CHECK(setGyroRate(config.rate, feedback));
+
+    return update.apply();
+}
+
+int Bmi160::getGyroscope(Bmi160Gyroscope& data) {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    uint8_t buffer[6];
+    CHECK(readRegister(Bmi160Register::GYRO_DATA_START_ADDR, buffer, arraySize(buffer)));
+    decodeAxes(buffer, (float)rangeGyro_, GYRO_FULL_RANGE, data);
+
+    return SYSTEM_ERROR_NONE;
+}
+
 int Bmi160::getAccelerometerPmu(Bmi160PowerState& pmu) {
     const std::lock_guard<RecursiveMutex> lock(mutex_);
     CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
@@ -578,6 +852,7 @@ int Bmi160::stopMotionDetect() {
 int Bmi160::initMotion(Bmi160AccelMotionConfig& config, bool feedback) {
     const std::lock_guard<RecursiveMutex> lock(mutex_);
     CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+    UpdateGuard update(*this);
 
     // Setting motion threshold
     CHECK(setAccelMotionThreshold(config.motionThreshold, feedback));
@@ -591,19 +866,16 @@ int Bmi160::initMotion(Bmi160AccelMotionConfig& config, bool feedback) {
     // Setting motion proof for significant motion
     CHECK(setAccelMotionProof(config.motionProof));
 
-    // Any-motion detection does not rely on the skip nor proof parameters.
-    uint8_t reg = 0;
-    CHECK(readRegister(Bmi160Register::INT_MOTION_3_ADDR, &reg));
-    reg &= ~INTMO_3_SIG_MOT_SEL_MASK;
-    reg |= (config.mode == Bmi160AccelMotionMode::ACCEL_MOTION_MODE_SIGNIFICANT) ? INTMO_3_SIG_MOT_SEL_MASK : 0x0;
-    CHECK(writeRegister(Bmi160Register::INT_MOTION_3_ADDR, reg));
+    // Setting any or significant motion detection
+    CHECK(setAccelMotionMode(config.mode));
 
-    return SYSTEM_ERROR_NONE;
+    return update.apply();
 }
 
 int Bmi160::initHighG(Bmi160AccelHighGConfig& config, bool feedback) {
     const std::lock_guard<RecursiveMutex> lock(mutex_);
     CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+    UpdateGuard update(*this);
 
     // Setting high G threshold
     CHECK(setAccelHighGThreshold(config.threshold, feedback));
@@ -614,7 +886,7 @@ int Bmi160::initHighG(Bmi160AccelHighGConfig& config, bool feedback) {
     // Setting high G hysteresis
     CHECK(setAccelHighGHysteresis(config.hysteresis, feedback));
 
-    return SYSTEM_ERROR_NONE;
+    return update.apply();
 }
 
 int Bmi160::startHighGDetect() {
@@ -645,6 +917,175 @@ int Bmi160::stopHighGDetect() {
     return SYSTEM_ERROR_NONE;
 }
 
+int Bmi160::startNoMotionDetect() {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    uint8_t reg = 0;
+
+    // INT_EN_2_ADDR[2:0] int_nomo_xyz_en
+    CHECK(readRegister(Bmi160Register::INT_EN_2_ADDR, &reg));
+    reg |= INT_EN_2_NOMO_Z_MASK | INT_EN_2_NOMO_Y_MASK | INT_EN_2_NOMO_X_MASK;
+    CHECK(writeRegister(Bmi160Register::INT_EN_2_ADDR, reg));
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::stopNoMotionDetect() {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    uint8_t reg = 0;
+
+    // INT_EN_2_ADDR[2:0] int_nomo_xyz_en
+    CHECK(readRegister(Bmi160Register::INT_EN_2_ADDR, &reg));
+    reg &= ~(INT_EN_2_NOMO_Z_MASK | INT_EN_2_NOMO_Y_MASK | INT_EN_2_NOMO_X_MASK);
+    CHECK(writeRegister(Bmi160Register::INT_EN_2_ADDR, reg));
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::startOrientationDetect() {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    uint8_t reg = 0;
+
+    // INT_EN_0_ADDR[6] int_orient_en, reset defaults of INT_ORIENT report upside down as well
+    CHECK(readRegister(Bmi160Register::INT_EN_0_ADDR, &reg));
+    reg |= INT_EN_0_ORIENT_MASK;
+    CHECK(writeRegister(Bmi160Register::INT_EN_0_ADDR, reg));
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::stopOrientationDetect() {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    uint8_t reg = 0;
+
+    // INT_EN_0_ADDR[6] int_orient_en
+    CHECK(readRegister(Bmi160Register::INT_EN_0_ADDR, &reg));
+    reg &= ~INT_EN_0_ORIENT_MASK;
+    CHECK(writeRegister(Bmi160Register::INT_EN_0_ADDR, reg));
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::startFlatDetect() {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    uint8_t reg = 0;
+
+    // INT_EN_0_ADDR[7] int_flat_en
+    CHECK(readRegister(Bmi160Register::INT_EN_0_ADDR, &reg));
+    reg |= INT_EN_0_FLAT_MASK;
+    CHECK(writeRegister(Bmi160Register::INT_EN_0_ADDR, reg));
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::stopFlatDetect() {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    uint8_t reg = 0;
+
+    // INT_EN_0_ADDR[7] int_flat_en
+    CHECK(readRegister(Bmi160Register::INT_EN_0_ADDR, &reg));
+    reg &= ~INT_EN_0_FLAT_MASK;
+    CHECK(writeRegister(Bmi160Register::INT_EN_0_ADDR, reg));
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::startFifo(bool gyro) {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    // Start from an empty FIFO and only store accelerometer, and optionally gyroscope, frames without headers.
+    // Headerless frames need both sensors running at the same output data rate.
+    CHECK(flushFifo());
+    CHECK(writeRegister(Bmi160Register::FIFO_CONFIG_1_ADDR, FIFO_CONFIG_1_ACC_EN_MASK | ((gyro) ? FIFO_CONFIG_1_GYR_EN_MASK : 0)));
+    fifoGyro_ = gyro;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::stopFifo() {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    CHECK(writeRegister(Bmi160Register::FIFO_CONFIG_1_ADDR, 0x00));
+    fifoGyro_ = false;
+    CHECK(flushFifo());
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::flushFifo() {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    return writeRegister(Bmi160Register::CMD_ADDR, Bmi160Command::CMD_FIFO_FLUSH);
+}
+
+int Bmi160::getFifoLength(size_t& length) {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+
+    uint8_t buffer[2];
+    CHECK(readRegister(Bmi160Register::FIFO_LENGTH_0_ADDR, buffer, arraySize(buffer)));
+    length = (size_t)(buffer[0] & FIFO_LENGTH_0_MASK) | ((size_t)(buffer[1] & FIFO_LENGTH_1_MASK) << FIFO_LENGTH_1_SHIFT);
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::readFifo(Bmi160Accelerometer* data, size_t count, size_t& read) {
+    return readFifo(data, nullptr, count, read);
+}
+
+int Bmi160::readFifo(Bmi160Accelerometer* accel, Bmi160Gyroscope* gyro, size_t count, size_t& read) {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
+    CHECK_TRUE(accel, SYSTEM_ERROR_INVALID_ARGUMENT);
+    CHECK_FALSE(gyro && !fifoGyro_, SYSTEM_ERROR_INVALID_STATE);
+
+    // Headerless frames hold the gyroscope sample ahead of the accelerometer sample
+    auto frameSize = (fifoGyro_) ? BMI160_FIFO_GYRO_ACCEL_FRAME_SIZE : BMI160_FIFO_ACCEL_FRAME_SIZE;
+    auto accelOffset = (fifoGyro_) ? BMI160_FIFO_GYRO_ACCEL_FRAME_SIZE - BMI160_FIFO_ACCEL_FRAME_SIZE : 0;
+
+    read = 0;
+    size_t length = 0;
+    CHECK(getFifoLength(length));
+    auto frames = std::min<size_t>(length / frameSize, count);
+
+    // Successive reads of the FIFO data register continue from where the previous read stopped so the
+    // frames can be read in smaller pieces.  I2C transfers are limited by the size of the wire buffer.
+    uint8_t buffer[BMI160_FIFO_READ_CHUNK_FRAMES * BMI160_FIFO_GYRO_ACCEL_FRAME_SIZE];
+    size_t chunkFrames = BMI160_FIFO_READ_CHUNK_FRAMES;
+    if (type_ == InterfaceType::BMI_I2C) {
+        chunkFrames = std::min<size_t>(chunkFrames, I2C_BUFFER_LENGTH / frameSize);
+    }
+
+    while (read < frames) {
+        auto chunk = std::min<size_t>(frames - read, chunkFrames);
+        CHECK(readRegister(Bmi160Register::FIFO_DATA_ADDR, buffer, chunk * frameSize));
+        for (size_t i = 0; i < chunk; i++) {
+            auto frame = &buffer[i * frameSize];
+            if (gyro) {
+                decodeAxes(frame, (float)rangeGyro_, GYRO_FULL_RANGE, gyro[read]);
+            }
+            decodeAxes(frame + accelOffset, (float)rangeAccel_, ACCEL_FULL_RANGE, accel[read]);
+            read++;
+        }
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
 int Bmi160::getStatus(uint32_t& val, bool clear) {
     const std::lock_guard<RecursiveMutex> lock(mutex_);
     CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
@@ -652,9 +1093,11 @@ int Bmi160::getStatus(uint32_t& val, bool clear) {
 
     // Perform clear of latched interrupts by changing latch interval (as opposed to disabling and re-enabling interrupts)
     if (clear && ((latchShadow_ & INT_LATCH_MODE_MASK) == IRQ_LATCH_LATCHED)) {
-        CHECK(writeRegister(Bmi160Register::INT_LATCH_ADDR, IRQ_LATCH_312_5_US));
+        // Bypass the shadow copy so that both writes reach the device even during an update
+        uint8_t latch = IRQ_LATCH_312_5_US;
+        CHECK(writeRegisters(Bmi160Register::INT_LATCH_ADDR, &latch, 1));
         delayMicroseconds(BMI160_INT_LATCH_CLEAR_TIME);
-        CHECK(writeRegister(Bmi160Register::INT_LATCH_ADDR, latchShadow_));
+        CHECK(writeRegisters(Bmi160Register::INT_LATCH_ADDR, &latchShadow_, 1));
     }
 
     return SYSTEM_ERROR_NONE;
@@ -668,6 +1111,30 @@ bool Bmi160::isHighGDetect(uint32_t val) {
     return (val & (BMI_INTR_BIT_HIGH_G)) ? true : false;
 }
 
+bool Bmi160::isNoMotionDetect(uint32_t val) {
+    return (val & (BMI_INTR_BIT_NO_MOTION)) ? true : false;
+}
+
+bool Bmi160::isOrientationDetect(uint32_t val) {
+    return (val & (BMI_INTR_BIT_ORIENTATION)) ? true : false;
+}
+
+bool Bmi160::isFlatDetect(uint32_t val) {
+    return (val & (BMI_INTR_BIT_FLAT)) ? true : false;
+}
+
+Bmi160Orientation Bmi160::getOrientation(uint32_t val) {
+    return static_cast<Bmi160Orientation>((val & INT_STATUS_3_ORIENT_MASK) >> INT_STATUS_3_ORIENT_SHIFT);
+}
+
+bool Bmi160::isFaceDown(uint32_t val) {
+    return (val & (BMI_INTR_BIT_ORIENT_2)) ? true : false;
+}
+
+bool Bmi160::isFlat(uint32_t val) {
+    return (val & (BMI_INTR_BIT_ORIENT_FLAT)) ? true : false;
+}
+
 int Bmi160::getChipId(uint8_t& val) {
     const std::lock_guard<RecursiveMutex> lock(mutex_);
     CHECK_TRUE(initialized_, SYSTEM_ERROR_INVALID_STATE);
@@ -681,33 +1148,169 @@ float Bmi160::convertValue(float val, float toRange, float fromRange) {
     return val * toRange / fromRange;
 }
 
+bool Bmi160::isShadowed(uint8_t reg, int length) const {
+    return (reg >= SHADOW_FIRST_ADDR) && ((size_t)(reg - SHADOW_FIRST_ADDR + length) <= SHADOW_SIZE);
+}
+
+bool Bmi160::isIdleTimeRequired() const {
+    // The interface only needs long idle times between writes while no sensor is in normal mode
+    return (accelPmu_ != PMU_STATUS_ACC_NORMAL) && (gyroPmu_ != PMU_STATUS_GYRO_NORMAL);
+}
+
+int Bmi160::loadShadow() {
+    shadowValid_ = false;
+    shadowDirty_ = 0;
+    CHECK(readRegister(SHADOW_FIRST_ADDR, shadow_, SHADOW_SIZE));
+    shadowValid_ = true;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::beginUpdate() {
+    mutex_.lock();
+    if (!initialized_ || !shadowValid_) {
+        mutex_.unlock();
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    updateDepth_++;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::applyUpdate() {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(updateDepth_, SYSTEM_ERROR_INVALID_STATE);
+
+    int ret = SYSTEM_ERROR_NONE;
+    if (--updateDepth_ == 0) {
+        if (updateDiscarded_) {
+            updateDiscarded_ = false;
+            loadShadow();
+            ret = SYSTEM_ERROR_INVALID_STATE;
+        }
+        else {
+            ret = flushShadow();
+        }
+    }
+    // Balance the lock taken in beginUpdate()
+    mutex_.unlock();
+
+    return ret;
+}
+
+int Bmi160::discardUpdate() {
+    const std::lock_guard<RecursiveMutex> lock(mutex_);
+    CHECK_TRUE(updateDepth_, SYSTEM_ERROR_INVALID_STATE);
+
+    // Nothing gathered has been sent so reading the registers back drops the pending writes
+    updateDiscarded_ = true;
+    if (--updateDepth_ == 0) {
+        updateDiscarded_ = false;
+        loadShadow();
+    }
+    // Balance the lock taken in beginUpdate()
+    mutex_.unlock();
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::flushShadow() {
+    // Interrupts are enabled last so that they are never armed with stale settings
+    const uint64_t enableMask = 0x7ULL << (Bmi160Register::INT_EN_0_ADDR - SHADOW_FIRST_ADDR);
+    CHECK(flushShadow(~enableMask));
+    CHECK(flushShadow(enableMask));
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::flushShadow(uint64_t mask) {
+    auto dirty = shadowDirty_ & mask;
+    size_t index = 0;
+    while (index < SHADOW_SIZE) {
+        if (!(dirty & (1ULL << index))) {
+            index++;
+            continue;
+        }
+
+        // Find the run of consecutive dirty registers
+        auto first = index;
+        uint64_t run = 0;
+        while ((index < SHADOW_SIZE) && (dirty & (1ULL << index))) {
+            run |= 1ULL << index;
+            index++;
+        }
+
+        // Bursts rely on address auto-increment, which needs the short idle time of normal mode
+        if (isIdleTimeRequired()) {
+            for (auto i = first; i < index; i++) {
+                CHECK(writeRegisters(SHADOW_FIRST_ADDR + i, &shadow_[i], 1));
+                shadowDirty_ &= ~(1ULL << i);
+            }
+        }
+        else {
+            CHECK(writeRegisters(SHADOW_FIRST_ADDR + first, &shadow_[first], index - first));
+            shadowDirty_ &= ~run;
+        }
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
 int Bmi160::writeRegister(uint8_t reg, uint8_t val) {
+    if (!shadowValid_ || !isShadowed(reg)) {
+        return writeRegisters(reg, &val, 1);
+    }
+
+    auto index = reg - SHADOW_FIRST_ADDR;
+    auto mask = 1ULL << index;
+
+    // Defer the write while an update is open, otherwise skip writes that wouldn't change anything
+    if (updateDepth_) {
+        if (shadow_[index] != val) {
+            shadow_[index] = val;
+            shadowDirty_ |= mask;
+        }
+        return SYSTEM_ERROR_NONE;
+    }
+    if ((shadow_[index] == val) && !(shadowDirty_ & mask)) {
+        return SYSTEM_ERROR_NONE;
+    }
+
+    CHECK(writeRegisters(reg, &val, 1));
+    shadow_[index] = val;
+    shadowDirty_ &= ~mask;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int Bmi160::writeRegisters(uint8_t reg, const uint8_t* val, size_t length) {
     if (type_ == InterfaceType::BMI_I2C) {
-        uint8_t buf[2];
-        buf[0] = reg;
-        buf[1] = val;
-        wire_->beginTransmission(address_);
-        wire_->write(buf, sizeof(buf));
-        auto ret = wire_->endTransmission();
-        if ((accelPmu_ == PMU_STATUS_ACC_LOW) ||
-            (accelPmu_ == PMU_STATUS_ACC_SUSPEND) ||
-            (gyroPmu_ == PMU_STATUS_GYRO_SUSPEND) ||
-            (gyroPmu_ == PMU_STATUS_GYRO_FAST_START_UP)) {
-            delayMicroseconds(BMI160_I2C_IDLE_TIME);
+        while (length > 0) {
+            // One byte of each transmission is taken by the register address
+            auto chunk = std::min<size_t>(length, I2C_BUFFER_LENGTH - 1);
+            wire_->beginTransmission(address_);
+            wire_->write(reg);
+            wire_->write(val, chunk);
+            CHECK_TRUE(wire_->endTransmission() == 0, SYSTEM_ERROR_INTERNAL);
+            reg += chunk;
+            val += chunk;
+            length -= chunk;
+            if (isIdleTimeRequired()) {
+                delayMicroseconds(BMI160_I2C_IDLE_TIME);
+            }
         }
-        return ret;
+        return SYSTEM_ERROR_NONE;
     }
     else if (type_ == InterfaceType::BMI_SPI) {
         spi_->beginTransaction(spiSettings_);
         digitalWrite(csPin_, LOW);
         spi_->transfer(reg & 0x7f);
-        spi_->transfer(val);
+        for (size_t i = 0; i < length; i++) {
+            spi_->transfer(val[i]);
+        }
         digitalWrite(csPin_, HIGH);
         spi_->endTransaction();
-        if ((accelPmu_ == PMU_STATUS_ACC_LOW) ||
-            (accelPmu_ == PMU_STATUS_ACC_SUSPEND) ||
-            (gyroPmu_ == PMU_STATUS_GYRO_SUSPEND) ||
-            (gyroPmu_ == PMU_STATUS_GYRO_FAST_START_UP)) {
+        if (isIdleTimeRequired()) {
             delayMicroseconds(BMI160_SPI_IDLE_TIME);
         }
         return SYSTEM_ERROR_NONE;
@@ -717,6 +1320,12 @@ int Bmi160::writeRegister(uint8_t reg, uint8_t val) {
 }
 
 int Bmi160::readRegister(uint8_t reg, uint8_t* val, int length) {
+    // Configuration registers only change through this driver so they don't need a bus access
+    if (shadowValid_ && isShadowed(reg, length)) {
+        memcpy(val, &shadow_[reg - SHADOW_FIRST_ADDR], length);
+        return SYSTEM_ERROR_NONE;
+    }
+
     auto regAddress = reg;
 
     if (type_ == InterfaceType::BMI_I2C) {
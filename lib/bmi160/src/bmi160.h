@@ -26,6 +26,12 @@ struct Bmi160Accelerometer {
     float z;
 };
 
+struct Bmi160Gyroscope {
+    float x;    // degrees per second
+    float y;
+    float z;
+};
+
 enum class Bmi160AccelSignificantMotionSkip {
     SIG_MOTION_SKIP_1_5_S           = 0,
     SIG_MOTION_SKIP_3_0_S           = 1,
@@ -59,11 +65,28 @@ struct Bmi160AccelHighGConfig {
     float hysteresis;
 };
 
+struct Bmi160AccelNoMotionConfig {
+    float threshold;    // g [up to range]
+    float duration;     // seconds [1.28s -> 430.08s]
+};
+
+enum class Bmi160Orientation {
+    ORIENTATION_PORTRAIT_UPRIGHT    = 0,
+    ORIENTATION_PORTRAIT_UPSIDE_DOWN = 1,
+    ORIENTATION_LANDSCAPE_LEFT      = 2,
+    ORIENTATION_LANDSCAPE_RIGHT     = 3,
+};
+
 struct Bmi160AccelerometerConfig {
     float rate;
     float range;
 };
 
+struct Bmi160GyroscopeConfig {
+    float rate;     // Hz [25Hz -> 3200Hz]
+    float range;    // degrees per second [125, 250, 500, 1000, 2000]
+};
+
 enum class Bmi160InterruptSource {
     INTR_NONE,
     INTR_STEP,
@@ -153,9 +176,12 @@ public:
     int end();
     int reset();
     int sleep();
-    int wakeup();
+    int wakeup(bool normal = false);
+    int sleepGyro();
+    int wakeupGyro();
     int syncEvent(Bmi160EventType event);
     int waitOnEvent(Bmi160EventType& event, system_tick_t timeout);
+    int waitOnEvent(Bmi160EventType& event, uint32_t& timestamp, system_tick_t timeout);
 
     int getChipId(uint8_t& val);
 
@@ -164,23 +190,99 @@ public:
     int getAccelerometerPmu(Bmi160PowerState& pmu);
     int initMotion(Bmi160AccelMotionConfig& config, bool feedback = false);
     int initHighG(Bmi160AccelHighGConfig& config, bool feedback = false);
+    int setAccelRange(float& range, bool feedback = false);
+    int setAccelRate(float& rate, bool feedback = false);
+    int setAccelMotionMode(Bmi160AccelMotionMode mode);
+    int setAccelMotionThreshold(float& threshold, bool feedback = false);
+    int setAccelMotionDuration(unsigned& duration, bool feedback = false);
+    int setAccelMotionSkip(Bmi160AccelSignificantMotionSkip skip);
+    int setAccelMotionProof(Bmi160AccelSignificantMotionProof proof);
+    int setAccelHighGThreshold(float& threshold, bool feedback = false);
+    int setAccelHighGDuration(float& duration, bool feedback = false);
+    int setAccelHighGHysteresis(float& hysteresis, bool feedback = false);
+    int initNoMotion(Bmi160AccelNoMotionConfig& config, bool feedback = false);
+    int setAccelNoMotionThreshold(float& threshold, bool feedback = false);
+    int setAccelNoMotionDuration(float& duration, bool feedback = false);
+    int initGyroscope(Bmi160GyroscopeConfig& config, bool feedback = false);
+    int getGyroscope(Bmi160Gyroscope& data);
+    int setGyroRange(float& range, bool feedback = false);
+    int setGyroRate(float& rate, bool feedback = false);
     int startMotionDetect();
     int stopMotionDetect();
     int startHighGDetect();
     int stopHighGDetect();
+    int startNoMotionDetect();
+    int stopNoMotionDetect();
+    int startOrientationDetect();
+    int stopOrientationDetect();
+    int startFlatDetect();
+    int stopFlatDetect();
+    int startFifo(bool gyro = false);
+    int stopFifo();
+    int flushFifo();
+    int getFifoLength(size_t& length);
+    int readFifo(Bmi160Accelerometer* data, size_t count, size_t& read);
+    int readFifo(Bmi160Accelerometer* accel, Bmi160Gyroscope* gyro, size_t count, size_t& read);
+
+    int beginUpdate();
+    int applyUpdate();
+    int discardUpdate();
 
     int getStatus(uint32_t& val, bool clear = false);
     bool isMotionDetect(uint32_t val);
     bool isHighGDetect(uint32_t val);
+    bool isNoMotionDetect(uint32_t val);
+    bool isOrientationDetect(uint32_t val);
+    bool isFlatDetect(uint32_t val);
+    Bmi160Orientation getOrientation(uint32_t val);
+    bool isFaceDown(uint32_t val);
+    bool isFlat(uint32_t val);
 
     static Bmi160& getInstance();
 
+    /**
+     * @brief Scoped register update, writes made through the driver are gathered and sent in
+     * bursts when the update is applied.  An update that goes out of scope without being applied,
+     * such as on an early error return, is discarded.
+     *
+     */
+    class UpdateGuard {
+    public:
+        explicit UpdateGuard(Bmi160& sensor)
+            : sensor_(sensor),
+              open_(sensor.beginUpdate() == SYSTEM_ERROR_NONE) {
+        }
+
+        ~UpdateGuard() {
+            if (open_) {
+                sensor_.discardUpdate();
+            }
+        }
+
+        int apply() {
+            if (!open_) {
+                return SYSTEM_ERROR_NONE;
+            }
+            open_ = false;
+            return sensor_.applyUpdate();
+        }
+
+    private:
+        Bmi160& sensor_;
+        bool open_;
+    };
+
 private:
     enum class InterfaceType {
         BMI_I2C,
         BMI_SPI
     };
 
+    struct Bmi160EventItem {
+        Bmi160EventType type;
+        uint32_t timestamp;     // Microseconds when the event was raised
+    };
+
     Bmi160();
     ~Bmi160();
 
@@ -192,19 +294,21 @@ private:
     float convertValue(float val, float toRange, float fromRange);
     uint8_t convertRateToOdr(float rate);
     float convertOdrToRate(uint8_t odr);
-    int setAccelRange(float& range, bool feedback = false);
-    int setAccelRate(float& rate, bool feedback = false);
-    int setAccelMotionThreshold(float& threshold, bool feedback = false);
-    int setAccelMotionDuration(unsigned& duration, bool feedback = false);
-    int setAccelMotionSkip(Bmi160AccelSignificantMotionSkip skip);
-    int setAccelMotionProof(Bmi160AccelSignificantMotionProof proof);
-    int setAccelHighGThreshold(float& threshold, bool feedback = false);
-    int setAccelHighGDuration(float& duration, bool feedback = false);
-    int setAccelHighGHysteresis(float& hysteresis, bool feedback = false);
+
+    bool isShadowed(uint8_t reg, int length = 1) const;
+    bool isIdleTimeRequired() const;
+    int loadShadow();
+    int flushShadow();
+    int flushShadow(uint64_t mask);
 
     int writeRegister(uint8_t reg, uint8_t val);
+    int writeRegisters(uint8_t reg, const uint8_t* val, size_t length);
     int readRegister(uint8_t reg, uint8_t* val, int length = 1);
 
+    // Configuration registers, ACC_CONF through INT_MOTION_3, that are cached by the driver
+    static constexpr uint8_t SHADOW_FIRST_ADDR = 0x40;
+    static constexpr size_t SHADOW_SIZE = 0x23;
+
     InterfaceType type_;
     TwoWire* wire_;
     uint8_t address_;
@@ -217,7 +321,15 @@ private:
     Bmi160PmuGyro gyroPmu_;
     int rangeAccel_;
     float rateAccel_;
+    int rangeGyro_;
+    float rateGyro_;
+    bool fifoGyro_;
     uint8_t latchShadow_;
+    uint8_t shadow_[SHADOW_SIZE];
+    bool shadowValid_;
+    uint64_t shadowDirty_;          // Bit per shadow register written but not yet sent
+    unsigned updateDepth_;
+    bool updateDiscarded_;          // A nested update was discarded so the outermost one is too
     os_queue_t motionSyncQueue_;
     static RecursiveMutex mutex_;
 }; // class Bmi160
@@ -22,9 +22,12 @@ namespace {
 
 // General constants and defaults
 const float ACCEL_FULL_RANGE = 32768.0;
+const float GYRO_FULL_RANGE = 32768.0;
 const uint8_t INVALID_I2C_ADDRESS = 0x7F;
 const int BMI160_ACCEL_RANGE_DEFAULT = 2; // g
 const float BMI160_ACCEL_RATE_DEFAULT = 100.0; // Hertz
+const int BMI160_GYRO_RANGE_DEFAULT = 2000; // degrees per second
+const float BMI160_GYRO_RATE_DEFAULT = 100.0; // Hertz
 const unsigned int BMI160_I2C_IDLE_TIME = 400; // microseconds, idle time between I2C write accesses
 const unsigned int BMI160_SPI_IDLE_TIME = 470; // microseconds, idle time between SPI write accesses
 const unsigned long BMI160_SPI_SELECT_TIME = 10; // milliseconds, time to wait for I2C to SPI selection
@@ -47,8 +50,16 @@ enum Bmi160Register: uint8_t {
     INT_STATUS_1_ADDR       = 0x1d,
     INT_STATUS_2_ADDR       = 0x1e,
     INT_STATUS_3_ADDR       = 0x1f,
+    FIFO_LENGTH_0_ADDR      = 0x22,
+    FIFO_LENGTH_1_ADDR      = 0x23,
+    FIFO_DATA_ADDR          = 0x24,
     ACC_CONF_ADDR           = 0x40,
     ACC_RANGE_ADDR          = 0x41,
+    GYR_CONF_ADDR           = 0x42,
+    GYR_RANGE_ADDR          = 0x43,
+    FIFO_DOWNS_ADDR         = 0x45,
+    FIFO_CONFIG_0_ADDR      = 0x46,
+    FIFO_CONFIG_1_ADDR      = 0x47,
     INT_EN_0_ADDR           = 0x50,
     INT_EN_1_ADDR           = 0x51,
     INT_EN_2_ADDR           = 0x52,
@@ -122,6 +133,77 @@ const float ACCEL_RANGE_16G_F = 16.0f;
 #define ACC_RANGE_VAL_MASK              (0xf << (ACC_RANGE_VAL_SHIFT))
 
 
+// GYR_CONF and GYR_RANGE registers
+#define GYR_CONF_BWP_SHIFT              (4)
+#define GYR_CONF_BWP_MASK               (0x3 << (GYR_CONF_BWP_SHIFT))
+
+const int GYRO_CONF_BWP_NORMAL = 2;
+
+#define GYR_CONF_ODR_SHIFT              (0)
+#define GYR_CONF_ODR_MASK               (0xf << (GYR_CONF_ODR_SHIFT))
+
+// Gyroscope ODR codes follow the accelerometer encoding but only cover 25Hz to 3200Hz
+const float GYRO_RATE_MIN = 25.0f;
+const float GYRO_RATE_MAX = 3200.0f;
+
+enum Bmi160GyroRange: uint8_t {
+    GYRO_RANGE_2000DPS      = 0x0,
+    GYRO_RANGE_1000DPS      = 0x1,
+    GYRO_RANGE_500DPS       = 0x2,
+    GYRO_RANGE_250DPS       = 0x3,
+    GYRO_RANGE_125DPS       = 0x4,
+};
+
+const float GYRO_RANGE_125DPS_F = 125.0f;
+const float GYRO_RANGE_250DPS_F = 250.0f;
+const float GYRO_RANGE_500DPS_F = 500.0f;
+const float GYRO_RANGE_1000DPS_F = 1000.0f;
+const float GYRO_RANGE_2000DPS_F = 2000.0f;
+
+#define GYR_RANGE_VAL_SHIFT             (0)
+#define GYR_RANGE_VAL_MASK              (0x7 << (GYR_RANGE_VAL_SHIFT))
+
+
+// FIFO_LENGTH_0 and FIFO_LENGTH_1 registers
+#define FIFO_LENGTH_0_MASK              (0xff)
+
+#define FIFO_LENGTH_1_SHIFT             (8)
+#define FIFO_LENGTH_1_MASK              (0x7)
+
+const size_t BMI160_FIFO_SIZE = 1024; // bytes
+const size_t BMI160_FIFO_ACCEL_FRAME_SIZE = 6; // bytes, headerless accelerometer only frame
+const size_t BMI160_FIFO_GYRO_ACCEL_FRAME_SIZE = 12; // bytes, headerless gyroscope then accelerometer frame
+const size_t BMI160_FIFO_READ_CHUNK_FRAMES = 16; // frames read per bus transaction
+
+
+// FIFO_CONFIG_1 register
+#define FIFO_CONFIG_1_GYR_EN_SHIFT      (7)
+#define FIFO_CONFIG_1_GYR_EN_MASK       (0x1 << (FIFO_CONFIG_1_GYR_EN_SHIFT))
+
+#define FIFO_CONFIG_1_ACC_EN_SHIFT      (6)
+#define FIFO_CONFIG_1_ACC_EN_MASK       (0x1 << (FIFO_CONFIG_1_ACC_EN_SHIFT))
+
+#define FIFO_CONFIG_1_MAG_EN_SHIFT      (5)
+#define FIFO_CONFIG_1_MAG_EN_MASK       (0x1 << (FIFO_CONFIG_1_MAG_EN_SHIFT))
+
+#define FIFO_CONFIG_1_HEADER_EN_SHIFT   (4)
+#define FIFO_CONFIG_1_HEADER_EN_MASK    (0x1 << (FIFO_CONFIG_1_HEADER_EN_SHIFT))
+
+#define FIFO_CONFIG_1_TAG_INT1_SHIFT    (3)
+#define FIFO_CONFIG_1_TAG_INT1_MASK     (0x1 << (FIFO_CONFIG_1_TAG_INT1_SHIFT))
+
+#define FIFO_CONFIG_1_TAG_INT2_SHIFT    (2)
+#define FIFO_CONFIG_1_TAG_INT2_MASK     (0x1 << (FIFO_CONFIG_1_TAG_INT2_SHIFT))
+
+#define FIFO_CONFIG_1_TIME_EN_SHIFT     (1)
+#define FIFO_CONFIG_1_TIME_EN_MASK      (0x1 << (FIFO_CONFIG_1_TIME_EN_SHIFT))
+
+
+// INT_STATUS_3 register, as bits 24 through 31 of the combined status word
+#define INT_STATUS_3_ORIENT_SHIFT       (24 + 4)
+#define INT_STATUS_3_ORIENT_MASK        (0x3 << (INT_STATUS_3_ORIENT_SHIFT))
+
+
 // INT_EN_0 through INT_EN_2 registers
 #define INT_EN_0_FLAT_SHIFT             (7)
 #define INT_EN_0_FLAT_MASK              (0x1 << (INT_EN_0_FLAT_SHIFT))
@@ -365,6 +447,25 @@ const uint8_t INTMO_1_ANYM_TH_MAX = INTMO_1_ANYM_TH_MASK;
 const float INTMO_1_ANYM_TH_LOWEST_RES = 512.0f;
 const float INTMO_1_ANYM_TH_RES = 1024.0f;
 
+#define INTMO_2_SLO_NO_MOT_TH_MASK      (0xff)
+
+// No-motion threshold uses the same scale as the any-motion threshold
+const uint8_t INTMO_2_SLO_NO_MOT_TH_MAX = INTMO_2_SLO_NO_MOT_TH_MASK;
+const float INTMO_2_SLO_NO_MOT_TH_LOWEST_RES = 512.0f;
+const float INTMO_2_SLO_NO_MOT_TH_RES = 1024.0f;
+
+// No-motion duration, int_slo_no_mot_dur<5:0>, is encoded in three ranges of increasing step
+const float INTMO_0_NO_MOT_DUR_SHORT_STEP = 1.28f;      // seconds, (dur<3:0> + 1) * step
+const float INTMO_0_NO_MOT_DUR_SHORT_MAX = 20.48f;
+const float INTMO_0_NO_MOT_DUR_MEDIUM_STEP = 5.12f;     // seconds, (dur<3:0> + 5) * step
+const unsigned INTMO_0_NO_MOT_DUR_MEDIUM_OFFSET = 5;
+const float INTMO_0_NO_MOT_DUR_MEDIUM_MAX = 102.4f;
+const uint8_t INTMO_0_NO_MOT_DUR_MEDIUM_SEL = 0x10;
+const float INTMO_0_NO_MOT_DUR_LONG_STEP = 10.24f;      // seconds, (dur<4:0> + 11) * step
+const unsigned INTMO_0_NO_MOT_DUR_LONG_OFFSET = 11;
+const uint8_t INTMO_0_NO_MOT_DUR_LONG_SEL = 0x20;
+const unsigned INTMO_0_NO_MOT_DUR_LONG_MAX_COUNT = 31;
+
 #define INTMO_3_SIG_MOT_PROOF_SHIFT     (4)
 #define INTMO_3_SIG_MOT_PROOF_MASK      (0x3 << (INTMO_3_SIG_MOT_PROOF_SHIFT))
 
@@ -383,6 +484,10 @@ enum Bmi160Command: uint8_t {
     CMD_ACC_PMU_MODE_SUSPEND    = 0x10,
     CMD_ACC_PMU_MODE_NORMAL     = 0x11,
     CMD_ACC_PMU_MODE_LOW        = 0x12,
+    CMD_GYR_PMU_MODE_SUSPEND    = 0x14,
+    CMD_GYR_PMU_MODE_NORMAL     = 0x15,
+    CMD_GYR_PMU_MODE_FAST_START = 0x17,
+    CMD_FIFO_FLUSH              = 0xb0,
     CMD_INT_RESET               = 0xb1,
     CMD_SOFT_RESET              = 0xb6,
 };
@@ -61,6 +61,16 @@ Bmi160AccelMotionConfig configMotion = {
     .motionProof        = Bmi160AccelSignificantMotionProof::SIG_MOTION_PROOF_0_25_S,   // seconds [0.25s, 0.5s, 1s, 2s]
 };
 
+Bmi160GyroscopeConfig configGyro = {
+    .rate               = 100.0,    // Hz [25Hz -> 3200Hz]
+    .range              = 500.0,    // degrees per second [125, 250, 500, 1000, 2000]
+};
+
+Bmi160AccelNoMotionConfig configNoMotion = {
+    .threshold          = 0.05,     // g [up to range]
+    .duration           = 5.12,     // seconds [1.28s -> 430s]
+};
+
 Bmi160AccelHighGConfig configHighG = {
     .threshold          = 4.0,      // g [up to range]
     .duration           = 0.0025,      // seconds
@@ -109,6 +119,7 @@ void setup() {
     BMI160.initAccelerometer(config);
     BMI160.initMotion(configMotion);
     BMI160.initHighG(configHighG);
+    BMI160.initNoMotion(configNoMotion);
     BMI160.wakeup();
 }
 
@@ -134,6 +145,69 @@ void loop() {
             case '4':   ret = BMI160.stopMotionDetect(); break;
             case '5':   ret = BMI160.startHighGDetect(); break;
             case '6':   ret = BMI160.stopHighGDetect(); break;
+            case '7':   ret = BMI160.startFifo(); break;
+            case '8':   ret = BMI160.stopFifo(); break;
+            case '9': {
+                Bmi160Accelerometer frames[16];
+                Bmi160Gyroscope rates[16];
+                size_t length = 0;
+                size_t read = 0;
+                BMI160.getFifoLength(length);
+                ret = BMI160.readFifo(frames, rates, arraySize(frames), read);
+                if (ret == SYSTEM_ERROR_INVALID_STATE) {
+                    // No gyroscope frames in the FIFO
+                    ret = BMI160.readFifo(frames, nullptr, arraySize(frames), read);
+                    for (auto& rate : rates) {
+                        rate = {0};
+                    }
+                }
+                Serial1.printlnf("FIFO length %u, read %u frames", length, read);
+                for (size_t i = 0; i < read; i++) {
+                    Serial1.printlnf("%2.3f,%2.3f,%2.3f,%3.2f,%3.2f,%3.2f", frames[i].x, frames[i].y, frames[i].z,
+                        rates[i].x, rates[i].y, rates[i].z);
+                }
+                break;
+            }
+            case 'a': {
+                // Time a full motion and high G reconfiguration gathered into one update
+                auto start = micros();
+                BMI160.beginUpdate();
+                BMI160.initMotion(configMotion);
+                BMI160.initHighG(configHighG);
+                BMI160.startMotionDetect();
+                ret = BMI160.applyUpdate();
+                Serial1.printlnf("update took %lu us", micros() - start);
+                break;
+            }
+            case 'b': {
+                // Gyroscope frames in the FIFO need the accelerometer in normal mode at the same rate
+                BMI160.wakeup(true);
+                BMI160.initGyroscope(configGyro);
+                BMI160.wakeupGyro();
+                ret = BMI160.startFifo(true);
+                Bmi160Gyroscope gyro = {0};
+                BMI160.getGyroscope(gyro);
+                Serial1.printlnf("gyro %3.2f,%3.2f,%3.2f", gyro.x, gyro.y, gyro.z);
+                break;
+            }
+            case 'c': {
+                BMI160.stopFifo();
+                BMI160.sleepGyro();
+                ret = BMI160.wakeup();
+                break;
+            }
+            case 'd':   ret = BMI160.startNoMotionDetect(); break;
+            case 'e':   ret = BMI160.stopNoMotionDetect(); break;
+            case 'f': {
+                BMI160.startFlatDetect();
+                ret = BMI160.startOrientationDetect();
+                break;
+            }
+            case 'g': {
+                BMI160.stopFlatDetect();
+                ret = BMI160.stopOrientationDetect();
+                break;
+            }
 
         }
         if (ret) {
@@ -159,8 +233,9 @@ void loop() {
     }
     // Serial1.printf("%2.3f,%2.3f,%2.3f,%u,%u,%u,%08lx\r\n",
     //     accel.x, accel.y, accel.z, (intr) ? 1 : 0, BMI160.isMotionDetect(val), BMI160.isHighGDetect(val), val);
-    Serial1.printf("%2.3f,%2.3f,%2.3f,%u,%u,%u\r\n",
-        accel.x, accel.y, accel.z, (intr) ? 1 : 0, BMI160.isMotionDetect(val), BMI160.isHighGDetect(val));
+    Serial1.printf("%2.3f,%2.3f,%2.3f,%u,%u,%u,%u,%u,%u\r\n",
+        accel.x, accel.y, accel.z, (intr) ? 1 : 0, BMI160.isMotionDetect(val), BMI160.isHighGDetect(val),
+        BMI160.isNoMotionDetect(val), (unsigned)BMI160.getOrientation(val), BMI160.isFlat(val));
 
     // Keep from going to sleep by moving timeout ahead
     if (intr) {
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "battery_estimator.h"
+#include <cmath>
+
+namespace {
+
+constexpr float MillisecondsPerHour = 3600.0f * 1000.0f;
+
+} // anonymous namespace
+
+BatteryEstimator::BatteryEstimator() {
+    reset();
+}
+
+void BatteryEstimator::reset() {
+    charge_ = 0.0f;
+    variance_ = 0.0f;
+    rate_ = 0.0f;
+    rateCharge_ = 0.0f;
+    rateMs_ = 0;
+    lastMs_ = 0;
+    valid_ = false;
+    rateValid_ = false;
+}
+
+float BatteryEstimator::capacityFactor(float temperature) {
+    if (std::isnan(temperature) || (temperature >= BatteryEstimatorNominalTemperature)) {
+        return 1.0f;
+    }
+
+    auto factor = 1.0f - BatteryEstimatorCapacityTempCoeff * (BatteryEstimatorNominalTemperature - temperature);
+    return (factor < BatteryEstimatorCapacityMinFactor) ? BatteryEstimatorCapacityMinFactor : factor;
+}
+
+void BatteryEstimator::update(float gauge, float dischargeMah, float capacityMah, float temperature, bool charging, uint64_t nowMs) {
+    // The model says nothing about charge going in so follow the gauge and restart the rate
+    if (!valid_ || charging) {
+        charge_ = gauge;
+        variance_ = BatteryEstimatorGaugeVariance;
+        rateCharge_ = gauge;
+        rateMs_ = nowMs;
+        lastMs_ = nowMs;
+        rate_ = 0.0f;
+        rateValid_ = false;
+        valid_ = true;
+        return;
+    }
+
+    // Predict from the modeled load, which draws a larger share of the battery when cold
+    auto usableMah = capacityMah * capacityFactor(temperature);
+    auto step = (usableMah > 0.0f) ? (100.0f * dischargeMah / usableMah) : 0.0f;
+    charge_ -= step;
+    auto modelError = BatteryEstimatorModelError * step;
+    variance_ += modelError * modelError + BatteryEstimatorDriftVariance * (float)(nowMs - lastMs_) / MillisecondsPerHour;
+    lastMs_ = nowMs;
+
+    // Correct towards the gauge, weighted by the relative uncertainty of each
+    auto gain = variance_ / (variance_ + BatteryEstimatorGaugeVariance);
+    charge_ += gain * (gauge - charge_);
+    variance_ *= (1.0f - gain);
+
+    if (charge_ < 0.0f) {
+        charge_ = 0.0f;
+    }
+    else if (charge_ > 100.0f) {
+        charge_ = 100.0f;
+    }
+
+    // Measure the rate over long spans so that gauge steps don't dominate it
+    auto elapsed = nowMs - rateMs_;
+    if (elapsed >= BatteryEstimatorRateIntervalMs) {
+        auto hours = (float)elapsed / MillisecondsPerHour;
+        auto rate = (rateCharge_ - charge_) / hours;
+        if (!rateValid_) {
+            rate_ = rate;
+            rateValid_ = true;
+        }
+        else {
+            auto alpha = hours / (BatteryEstimatorRateTime + hours);
+            rate_ += alpha * (rate - rate_);
+        }
+        rateCharge_ = charge_;
+        rateMs_ = nowMs;
+    }
+}
+
+bool BatteryEstimator::isValid() const {
+    return valid_;
+}
+
+float BatteryEstimator::getCharge() const {
+    return charge_;
+}
+
+float BatteryEstimator::getRate() const {
+    return (rateValid_ && (rate_ > 0.0f)) ? rate_ : 0.0f;
+}
+
+float BatteryEstimator::project(float hours) const {
+    return charge_ - getRate() * hours;
+}
+
+float BatteryEstimator::getTimeTo(float percent) const {
+    auto rate = getRate();
+    if (rate <= 0.0f) {
+        return -1.0f;
+    }
+
+    return (charge_ > percent) ? ((charge_ - percent) / rate) : 0.0f;
+}
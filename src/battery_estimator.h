@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Variance, in %^2, of a single fuel gauge reading
+constexpr float BatteryEstimatorGaugeVariance = 4.0f;
+
+// Error of the energy model, as a fraction of the charge it predicts
+constexpr float BatteryEstimatorModelError = 0.25f;
+
+// Growth of the estimate variance, in %^2 per hour, for load the model doesn't capture
+constexpr float BatteryEstimatorDriftVariance = 1.0f;
+
+// Interval, in milliseconds, over which the discharge rate is measured
+constexpr uint64_t BatteryEstimatorRateIntervalMs = 15 * 60 * 1000;
+
+// Time constant, in hours, of the discharge rate average
+constexpr float BatteryEstimatorRateTime = 2.0f;
+
+// Temperature, in degrees Celsius, below which usable capacity is reduced
+constexpr float BatteryEstimatorNominalTemperature = 25.0f;
+
+// Fraction of usable capacity lost per degree Celsius below the nominal temperature
+constexpr float BatteryEstimatorCapacityTempCoeff = 0.008f;
+
+// Smallest fraction of usable capacity at low temperatures
+constexpr float BatteryEstimatorCapacityMinFactor = 0.5f;
+
+/**
+ * @brief Battery state of charge estimate combining the fuel gauge and the energy model.
+ *
+ * The energy model predicts the charge drawn between readings, scaled for the capacity lost at low
+ * temperature, and each fuel gauge reading corrects the prediction in proportion to how uncertain
+ * the two are.  Readings taken while charging replace the estimate as the model only covers the
+ * load.
+ */
+class BatteryEstimator {
+public:
+    BatteryEstimator();
+
+    /**
+     * @brief Discard the estimate
+     *
+     */
+    void reset();
+
+    /**
+     * @brief Add a fuel gauge reading and the load modeled since the previous one
+     *
+     * @param gauge Fuel gauge state of charge, in percent
+     * @param dischargeMah Charge drawn since the previous update according to the energy model, in mAh
+     * @param capacityMah Nominal battery capacity, in mAh
+     * @param temperature Battery temperature, in degrees Celsius, or NAN if unknown
+     * @param charging Battery is being charged
+     * @param nowMs Present time, in milliseconds
+     */
+    void update(float gauge, float dischargeMah, float capacityMah, float temperature, bool charging, uint64_t nowMs);
+
+    /**
+     * @brief Indicate if an estimate is available
+     *
+     * @return true Estimate is available
+     * @return false No readings yet
+     */
+    bool isValid() const;
+
+    /**
+     * @brief Get the estimated state of charge
+     *
+     * @return float State of charge, in percent
+     */
+    float getCharge() const;
+
+    /**
+     * @brief Get the averaged discharge rate
+     *
+     * @return float Rate, in percent per hour, or 0 if not measured yet or charging
+     */
+    float getRate() const;
+
+    /**
+     * @brief Project the state of charge forward at the averaged discharge rate
+     *
+     * @param hours Time ahead, in hours
+     * @return float Projected state of charge, in percent
+     */
+    float project(float hours) const;
+
+    /**
+     * @brief Project the time until the state of charge falls to a level
+     *
+     * @param percent Level, in percent
+     * @return float Time, in hours, or a negative value if the battery isn't discharging
+     */
+    float getTimeTo(float percent) const;
+
+    /**
+     * @brief Get the fraction of nominal capacity usable at a temperature
+     *
+     * @param temperature Battery temperature, in degrees Celsius, or NAN if unknown
+     * @return float Fraction of nominal capacity [0.0 -> 1.0]
+     */
+    static float capacityFactor(float temperature);
+
+private:
+    float charge_;
+    float variance_;
+    float rate_;
+    float rateCharge_;
+    uint64_t rateMs_;
+    uint64_t lastMs_;
+    bool valid_;
+    bool rateValid_;
+};
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "energy_ledger.h"
+
+namespace {
+
+constexpr float MillisecondsPerHour = 3600.0f * 1000.0f;
+
+} // anonymous namespace
+
+EnergyLedger::EnergyLedger()
+    : lastMs_(0),
+      on_(0),
+      lastValid_(false) {
+
+    clear(current_, 0);
+    clear(last_, 0);
+    clear(totals_, 0);
+}
+
+void EnergyLedger::clear(EnergyCycle& cycle, uint64_t startMs) {
+    cycle.startMs = startMs;
+    cycle.durationMs = 0;
+    for (auto& onMs : cycle.onMs) {
+        onMs = 0;
+    }
+}
+
+void EnergyLedger::start(uint64_t nowMs, uint32_t on) {
+    clear(current_, nowMs);
+    clear(totals_, nowMs);
+    lastValid_ = false;
+    lastMs_ = nowMs;
+    on_ = on;
+}
+
+void EnergyLedger::set(EnergyComponent component, bool on, uint64_t nowMs) {
+    // Close out the time spent in the previous state before changing it
+    update(nowMs);
+
+    auto bit = 1UL << (size_t)component;
+    if (on) {
+        on_ |= bit;
+    }
+    else {
+        on_ &= ~bit;
+    }
+}
+
+bool EnergyLedger::isOn(EnergyComponent component) const {
+    return (on_ & (1UL << (size_t)component)) ? true : false;
+}
+
+void EnergyLedger::update(uint64_t nowMs) {
+    if (nowMs <= lastMs_) {
+        return;
+    }
+
+    auto elapsed = nowMs - lastMs_;
+    current_.durationMs += elapsed;
+    totals_.durationMs += elapsed;
+    for (size_t i = 0; i < EnergyComponentCount; i++) {
+        if (on_ & (1UL << i)) {
+            current_.onMs[i] += elapsed;
+            totals_.onMs[i] += elapsed;
+        }
+    }
+    lastMs_ = nowMs;
+}
+
+void EnergyLedger::beginCycle(uint64_t nowMs) {
+    update(nowMs);
+    last_ = current_;
+    lastValid_ = true;
+    clear(current_, nowMs);
+}
+
+bool EnergyLedger::getLastCycle(EnergyCycle& cycle) const {
+    if (!lastValid_) {
+        return false;
+    }
+    cycle = last_;
+
+    return true;
+}
+
+void EnergyLedger::getCurrentCycle(EnergyCycle& cycle) const {
+    cycle = current_;
+}
+
+void EnergyLedger::getTotals(EnergyCycle& cycle) const {
+    cycle = totals_;
+}
+
+float EnergyLedger::charge(const EnergyModel& model, const EnergyCycle& cycle) {
+    float mah = 0.0f;
+    for (size_t i = 0; i < EnergyComponentCount; i++) {
+        mah += model.current[i] * (float)cycle.onMs[i] / MillisecondsPerHour;
+    }
+
+    return mah;
+}
+
+float EnergyLedger::projectLife(const EnergyModel& model, const EnergyCycle& cycle, float capacityMah) {
+    auto mah = charge(model, cycle);
+    if (!cycle.durationMs || (mah <= 0.0f)) {
+        return 0.0f;
+    }
+
+    // Average current over the period sets the rate the battery is drained
+    auto averageMa = mah * MillisecondsPerHour / (float)cycle.durationMs;
+
+    return capacityMah / averageMa;
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Power consuming components tracked by the energy ledger.
+ *
+ */
+enum class EnergyComponent {
+    RUN,                            /**< MCU running, outside of sleep */
+    MODEM,                          /**< Cellular modem powered */
+    GNSS,                           /**< GNSS receiver powered */
+    WIFI,                           /**< Wi-Fi scanner powered */
+    SLEEP,                          /**< System in ultra low power sleep */
+    MODEM_IDLE,                     /**< Cellular modem registered and idle while the system sleeps */
+    COUNT,
+};
+
+constexpr size_t EnergyComponentCount = (size_t)EnergyComponent::COUNT;
+
+/**
+ * @brief Current drawn by each component while it is on.
+ *
+ */
+struct EnergyModel {
+    float current[EnergyComponentCount];    /**< Current, in mA, indexed by EnergyComponent */
+};
+
+// Default current model, in mA, and battery capacity, in mAh, of the Tracker One
+constexpr double EnergyDefaultRunMa = 8.0;
+constexpr double EnergyDefaultModemMa = 60.0;
+constexpr double EnergyDefaultGnssMa = 25.0;
+constexpr double EnergyDefaultWifiMa = 80.0;
+constexpr double EnergyDefaultSleepMa = 0.13;
+constexpr double EnergyDefaultModemIdleMa = 2.5;
+constexpr double EnergyDefaultBatteryMah = 2000.0;
+
+// Default current model in EnergyComponent order
+constexpr EnergyModel EnergyDefaultModel = {{
+    (float)EnergyDefaultRunMa,
+    (float)EnergyDefaultModemMa,
+    (float)EnergyDefaultGnssMa,
+    (float)EnergyDefaultWifiMa,
+    (float)EnergyDefaultSleepMa,
+    (float)EnergyDefaultModemIdleMa,
+}};
+
+/**
+ * @brief Time spent with each component on over a period.
+ *
+ */
+struct EnergyCycle {
+    uint64_t startMs;                       /**< Start of the period, in milliseconds */
+    uint64_t durationMs;                    /**< Length of the period, in milliseconds */
+    uint64_t onMs[EnergyComponentCount];    /**< Time, in milliseconds, each component was on */
+};
+
+/**
+ * @brief Integrates the time spent in each power state, per wake cycle and in total.
+ *
+ * Charge is derived from the on times and the current model when asked for so that a change of
+ * model applies to everything accounted so far.  The class has no dependencies on the system and
+ * duty cycles are projected on the host in test/energy_ledger_test.cpp.
+ */
+class EnergyLedger {
+public:
+    EnergyLedger();
+
+    /**
+     * @brief Start accounting with only the given components on
+     *
+     * @param nowMs Present time, in milliseconds
+     * @param on Bitmap of components, by EnergyComponent index, that are on
+     */
+    void start(uint64_t nowMs, uint32_t on);
+
+    /**
+     * @brief Turn a component on or off
+     *
+     * @param component Component to change
+     * @param on Component is on
+     * @param nowMs Present time, in milliseconds
+     */
+    void set(EnergyComponent component, bool on, uint64_t nowMs);
+
+    /**
+     * @brief Indicate if a component is on
+     *
+     * @param component Component to check
+     * @return true Component is on
+     * @return false Component is off
+     */
+    bool isOn(EnergyComponent component) const;
+
+    /**
+     * @brief Account for time elapsed up to now
+     *
+     * @param nowMs Present time, in milliseconds
+     */
+    void update(uint64_t nowMs);
+
+    /**
+     * @brief Close the current cycle and start the next one
+     *
+     * @param nowMs Present time, in milliseconds
+     */
+    void beginCycle(uint64_t nowMs);
+
+    /**
+     * @brief Get the last completed cycle
+     *
+     * @param cycle Returned cycle
+     * @return true A cycle has completed
+     * @return false No cycle has completed yet
+     */
+    bool getLastCycle(EnergyCycle& cycle) const;
+
+    /**
+     * @brief Get the cycle in progress, up to the last update
+     *
+     * @param cycle Returned cycle
+     */
+    void getCurrentCycle(EnergyCycle& cycle) const;
+
+    /**
+     * @brief Get the totals since accounting started, up to the last update
+     *
+     * @param cycle Returned totals
+     */
+    void getTotals(EnergyCycle& cycle) const;
+
+    /**
+     * @brief Calculate the charge drawn over a period
+     *
+     * @param model Current model
+     * @param cycle Period to evaluate
+     * @return float Charge, in mAh
+     */
+    static float charge(const EnergyModel& model, const EnergyCycle& cycle);
+
+    /**
+     * @brief Project battery life if every following period draws like the given one
+     *
+     * @param model Current model
+     * @param cycle Representative period
+     * @param capacityMah Usable battery capacity, in mAh
+     * @return float Projected life, in hours, or 0 if the period is empty
+     */
+    static float projectLife(const EnergyModel& model, const EnergyCycle& cycle, float capacityMah);
+
+private:
+    static void clear(EnergyCycle& cycle, uint64_t startMs);
+
+    EnergyCycle current_;
+    EnergyCycle last_;
+    EnergyCycle totals_;
+    uint64_t lastMs_;
+    uint32_t on_;
+    bool lastValid_;
+};
@@ -43,16 +43,23 @@ void setup()
 {
     Tracker::instance().init();
     Tracker::instance().location.regLocGenCallback(locationGenerationCallback);
-
-    SystemPowerConfiguration conf;
-    conf.powerSourceMaxCurrent(500);
-    System.setPowerConfiguration(conf);
-
-    Particle.connect();
 }
 
 void loop()
 {
+    // Configure power and connect only once the fuel gauge quickstart has read the battery
+    // unloaded and with charging off
+    static bool connectStarted = false;
+    if (!connectStarted && !Tracker::instance().isBatteryQuickStartPending())
+    {
+        SystemPowerConfiguration conf;
+        conf.powerSourceMaxCurrent(500);
+        System.setPowerConfiguration(conf);
+
+        Particle.connect();
+        connectStarted = true;
+    }
+
     Tracker::instance().loop();
 
 }
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "motion_capture.h"
+#include <cmath>
+
+using namespace particle;
+
+namespace {
+
+int16_t toMilliG(float value) {
+    auto milli = roundf(value * 1000.0f);
+    if (milli > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (milli < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)milli;
+}
+
+// Write one signed value as a zigzag encoded varint, returns bytes written or 0 when out of space
+size_t writeVarint(int32_t value, uint8_t* buffer, size_t size) {
+    auto zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    size_t length = 0;
+    do {
+        if (length >= size) {
+            return 0;
+        }
+        uint8_t byte = zigzag & 0x7f;
+        zigzag >>= 7;
+        buffer[length++] = (zigzag) ? (byte | 0x80) : byte;
+    } while (zigzag);
+
+    return length;
+}
+
+} // anonymous namespace
+
+MotionCapture::MotionCapture() {
+    setRate(MotionCaptureMaxRate);
+}
+
+void MotionCapture::setRate(float rate) {
+    stride_ = 1;
+    if (rate > MotionCaptureMaxRate) {
+        stride_ = (size_t)ceilf(rate / MotionCaptureMaxRate);
+    }
+    rate_ = rate / stride_;
+
+    preCount_ = (size_t)roundf(rate_ * MotionCapturePreTime);
+    if (preCount_ < 1) {
+        preCount_ = 1;
+    }
+    if (preCount_ > PRE_SAMPLES) {
+        preCount_ = PRE_SAMPLES;
+    }
+    auto postCount = (size_t)roundf(rate_ * MotionCapturePostTime);
+    if (postCount < 1) {
+        postCount = 1;
+    }
+    if (postCount > POST_SAMPLES) {
+        postCount = POST_SAMPLES;
+    }
+    captureCount_ = preCount_ + postCount;
+
+    reset();
+}
+
+void MotionCapture::reset() {
+    ringHead_ = 0;
+    ringCount_ = 0;
+    sum_[0] = sum_[1] = sum_[2] = 0;
+    summed_ = 0;
+    window_.time = 0;
+    window_.rate = 0.0f;
+    window_.preSamples = 0;
+    window_.count = 0;
+    state_ = State::IDLE;
+}
+
+void MotionCapture::addSample(const Bmi160Accelerometer& sample) {
+    if (state_ == State::READY) {
+        return;
+    }
+
+    // Average fast samples down to the stored rate
+    sum_[0] += toMilliG(sample.x);
+    sum_[1] += toMilliG(sample.y);
+    sum_[2] += toMilliG(sample.z);
+    if (++summed_ < stride_) {
+        return;
+    }
+
+    MotionCaptureSample value = {
+        .x = (int16_t)(sum_[0] / (int32_t)stride_),
+        .y = (int16_t)(sum_[1] / (int32_t)stride_),
+        .z = (int16_t)(sum_[2] / (int32_t)stride_),
+    };
+    sum_[0] = sum_[1] = sum_[2] = 0;
+    summed_ = 0;
+
+    store(value);
+}
+
+void MotionCapture::store(const MotionCaptureSample& value) {
+    // Samples after a trigger go straight into the frozen window
+    if (state_ == State::CAPTURING) {
+        window_.samples[window_.count++] = value;
+        if (window_.count >= captureCount_) {
+            state_ = State::READY;
+        }
+        return;
+    }
+
+    ring_[ringHead_] = value;
+    ringHead_ = (ringHead_ + 1) % preCount_;
+    if (ringCount_ < preCount_) {
+        ringCount_++;
+    }
+}
+
+bool MotionCapture::trigger(time_t time) {
+    if (state_ != State::IDLE) {
+        return false;
+    }
+
+    // Unroll the ring so that the window is ordered oldest sample first
+    auto tail = (ringHead_ + preCount_ - ringCount_) % preCount_;
+    for (size_t i = 0; i < ringCount_; i++) {
+        window_.samples[i] = ring_[(tail + i) % preCount_];
+    }
+    window_.time = time;
+    window_.rate = rate_;
+    window_.preSamples = ringCount_;
+    window_.count = ringCount_;
+    ringCount_ = 0;
+    ringHead_ = 0;
+    state_ = State::CAPTURING;
+
+    return true;
+}
+
+bool MotionCapture::isCapturing() const {
+    return (state_ == State::CAPTURING);
+}
+
+const MotionCaptureWindow* MotionCapture::getWindow() const {
+    return (state_ == State::READY) ? &window_ : nullptr;
+}
+
+void MotionCapture::release() {
+    if (state_ == State::READY) {
+        state_ = State::IDLE;
+    }
+}
+
+size_t MotionCapture::encode(const MotionCaptureSample* samples, size_t count, uint8_t* buffer, size_t size) {
+    MotionCaptureSample last = {0};
+    size_t length = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const int32_t deltas[] = {
+            (int32_t)samples[i].x - last.x,
+            (int32_t)samples[i].y - last.y,
+            (int32_t)samples[i].z - last.z,
+        };
+        for (auto delta : deltas) {
+            auto written = writeVarint(delta, buffer + length, size - length);
+            if (!written) {
+                return 0;
+            }
+            length += written;
+        }
+        last = samples[i];
+    }
+
+    return length;
+}
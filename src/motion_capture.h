@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Particle.h"
+#include "bmi160.h"
+
+/**
+ * @brief Single captured accelerometer sample.
+ *
+ */
+struct MotionCaptureSample {
+    int16_t x;                      /**< X axis acceleration, in milli-g */
+    int16_t y;                      /**< Y axis acceleration, in milli-g */
+    int16_t z;                      /**< Z axis acceleration, in milli-g */
+};
+
+/**
+ * @brief Time, in seconds, captured before and after a trigger.
+ *
+ */
+constexpr float MotionCapturePreTime = 1.0;
+constexpr float MotionCapturePostTime = 2.0;
+
+/**
+ * @brief Highest rate, in Hz, that is stored.  Faster samples are averaged down to this rate or below.
+ *
+ */
+constexpr float MotionCaptureMaxRate = 100.0;
+
+/**
+ * @brief Count of samples that can be stored before and after a trigger.
+ *
+ */
+constexpr size_t MotionCapturePreSamples = (size_t)(MotionCapturePreTime * MotionCaptureMaxRate);
+constexpr size_t MotionCapturePostSamples = (size_t)(MotionCapturePostTime * MotionCaptureMaxRate);
+
+/**
+ * @brief Frozen acceleration waveform around a trigger.
+ *
+ */
+struct MotionCaptureWindow {
+    time_t time;                  /**< Epoch time, in seconds, of the trigger or 0 if unknown */
+    float rate;                     /**< Sample rate, in Hz, of the stored samples */
+    size_t preSamples;              /**< Count of samples before the trigger */
+    size_t count;                   /**< Count of valid samples */
+    MotionCaptureSample samples[MotionCapturePreSamples + MotionCapturePostSamples]; /**< Captured samples, oldest first */
+};
+
+/**
+ * @brief Pre-trigger ring buffer of accelerometer samples with a single frozen capture window.
+ *
+ * The producer calls addSample() and trigger() from the motion service thread.  A completed window
+ * is handed to a single consumer with getWindow() and returned with release().
+ */
+class MotionCapture {
+public:
+    static constexpr size_t PRE_SAMPLES = MotionCapturePreSamples;
+    static constexpr size_t POST_SAMPLES = MotionCapturePostSamples;
+    static constexpr size_t CAPTURE_SAMPLES = PRE_SAMPLES + POST_SAMPLES;
+
+    MotionCapture();
+
+    /**
+     * @brief Discard buffered samples and any capture in progress or waiting to be consumed
+     *
+     */
+    void reset();
+
+    /**
+     * @brief Set the accelerometer rate and size the windows to it
+     *
+     * Discards buffered samples and any capture in progress.  Rates above MotionCaptureMaxRate are
+     * averaged down by a whole factor so that the windows keep their length in time.
+     *
+     * @param rate Sample rate, in Hz, of the accelerometer data
+     */
+    void setRate(float rate);
+
+    /**
+     * @brief Add one accelerometer sample
+     *
+     * @param sample Acceleration, in g
+     */
+    void addSample(const particle::Bmi160Accelerometer& sample);
+
+    /**
+     * @brief Freeze the buffered samples and start collecting samples after the trigger
+     *
+     * @param time Epoch time, in seconds, of the trigger
+     * @return true Capture started
+     * @return false A capture is already in progress or waiting to be consumed
+     */
+    bool trigger(time_t time);
+
+    /**
+     * @brief Indicate if samples after a trigger are still being collected
+     *
+     * @return true Capture in progress
+     * @return false No capture in progress
+     */
+    bool isCapturing() const;
+
+    /**
+     * @brief Get a completed capture window
+     *
+     * @return const MotionCaptureWindow* Completed window or nullptr if none is available
+     */
+    const MotionCaptureWindow* getWindow() const;
+
+    /**
+     * @brief Return the completed capture window so that another capture can be triggered
+     *
+     */
+    void release();
+
+    /**
+     * @brief Compress samples using per axis deltas encoded as zigzag varints
+     *
+     * The first sample is encoded as a delta from zero so that every encoded block stands alone.
+     *
+     * @param samples Samples to encode
+     * @param count Count of samples to encode
+     * @param buffer Destination buffer
+     * @param size Size of destination buffer, in bytes
+     * @return size_t Count of bytes written, or 0 if the buffer is too small
+     */
+    static size_t encode(const MotionCaptureSample* samples, size_t count, uint8_t* buffer, size_t size);
+
+private:
+    enum class State {
+        IDLE,
+        CAPTURING,
+        READY,
+    };
+
+    void store(const MotionCaptureSample& value);
+
+    MotionCaptureSample ring_[PRE_SAMPLES];
+    size_t ringHead_;
+    size_t ringCount_;
+    float rate_;                    // Rate, in Hz, of the stored samples
+    size_t stride_;                 // Accelerometer samples averaged into each stored sample
+    size_t preCount_;               // Samples stored before a trigger at this rate
+    size_t captureCount_;           // Samples stored in total at this rate
+    int32_t sum_[3];                // Sums, in milli-g, of the samples averaged so far
+    size_t summed_;
+    MotionCaptureWindow window_;
+    volatile State state_;
+};
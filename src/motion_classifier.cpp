@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "motion_classifier.h"
+#include <cmath>
+
+namespace {
+
+const MotionClassifierConfig motionClassifierDefaultConfig = {
+    .rate                   = 100.0,    // Hz, must match accelerometer rate
+    .stationaryRms          = 0.015,    // g
+    .idleMaxRms             = 0.1,      // g
+    .idleMinFrequency       = 8.0,      // Hz
+    .tonalRatio             = 0.5,      // [0.0 -> 1.0]
+    .handlingRms            = 0.3,      // g
+    .handlingMaxFrequency   = 4.0,      // Hz
+    .debounce               = 2,        // windows
+};
+
+// Frequencies, in Hz, evaluated with the Goertzel algorithm over the window.  Bins at or above
+// the Nyquist frequency of the sample rate are skipped.
+const float motionClassifierBins[MotionClassifier::FREQUENCY_BINS] = {1.5625, 3.125, 4.6875, 6.25, 9.375, 12.5, 18.75, 25.0};
+
+// Time constant, in seconds, of the gravity estimate
+constexpr float MotionClassifierGravityTime = 0.5;
+
+// Deviations smaller than this, in g, do not count as zero crossings
+constexpr float MotionClassifierCrossingDeadband = 0.005;
+
+} // anonymous namespace
+
+MotionClassifier::MotionClassifier()
+    : config_(motionClassifierDefaultConfig),
+      windowSize_(0),
+      bins_(0),
+      gravityAlpha_(0.0f),
+      activity_(MotionActivity::UNKNOWN) {
+
+    configure(motionClassifierDefaultConfig);
+}
+
+void MotionClassifier::configure(const MotionClassifierConfig& config) {
+    config_ = config;
+    updateRate();
+    reset();
+}
+
+void MotionClassifier::setRate(float rate) {
+    config_.rate = rate;
+    updateRate();
+    restart();
+}
+
+void MotionClassifier::updateRate() {
+    windowSize_ = (size_t)roundf(WINDOW_TIME * config_.rate);
+    if (windowSize_ < 1) {
+        windowSize_ = 1;
+    }
+    gravityAlpha_ = 1.0f / (MotionClassifierGravityTime * config_.rate);
+    if (gravityAlpha_ > 1.0f) {
+        gravityAlpha_ = 1.0f;
+    }
+
+    bins_ = 0;
+    for (size_t i = 0; i < FREQUENCY_BINS; i++) {
+        if (motionClassifierBins[i] >= config_.rate / 2.0f) {
+            break;
+        }
+        coefficients_[i] = 2.0f * cosf(2.0f * (float)M_PI * motionClassifierBins[i] / config_.rate);
+        bins_++;
+    }
+}
+
+bool MotionClassifier::addSample(float x, float y, float z) {
+    auto magnitude = sqrtf(x * x + y * y + z * z);
+
+    // Track gravity, and slow orientation changes, so that only the dynamic part of the
+    // acceleration is analyzed regardless of how the device is mounted.
+    if (samples_ == 0 && gravity_ == 0.0f) {
+        gravity_ = magnitude;
+    }
+    gravity_ += gravityAlpha_ * (magnitude - gravity_);
+    auto value = magnitude - gravity_;
+
+    sumSquares_ += value * value;
+
+    if (fabsf(value) > MotionClassifierCrossingDeadband) {
+        auto sign = (value > 0.0f) ? 1.0f : -1.0f;
+        if (lastSign_ != 0.0f && sign != lastSign_) {
+            crossings_++;
+        }
+        lastSign_ = sign;
+    }
+
+    for (size_t i = 0; i < bins_; i++) {
+        auto s = value + coefficients_[i] * goertzel_[i][0] - goertzel_[i][1];
+        goertzel_[i][1] = goertzel_[i][0];
+        goertzel_[i][0] = s;
+    }
+
+    if (++samples_ < windowSize_) {
+        return false;
+    }
+
+    auto previous = activity_;
+    evaluateWindow();
+
+    return (activity_ != previous);
+}
+
+void MotionClassifier::evaluateWindow() {
+    float total = 0.0f;
+    float peak = 0.0f;
+    size_t peakIndex = 0;
+
+    for (size_t i = 0; i < bins_; i++) {
+        auto s1 = goertzel_[i][0];
+        auto s2 = goertzel_[i][1];
+        auto power = s1 * s1 + s2 * s2 - coefficients_[i] * s1 * s2;
+        total += power;
+        if (power > peak) {
+            peak = power;
+            peakIndex = i;
+        }
+    }
+
+    features_.rms = sqrtf(sumSquares_ / windowSize_);
+    features_.zeroCrossingRate = (float)crossings_ * config_.rate / windowSize_;
+    features_.dominantFrequency = (bins_) ? motionClassifierBins[peakIndex] : 0.0f;
+    features_.dominantRatio = (total > 0.0f) ? (peak / total) : 0.0f;
+
+    // Only report a new activity once it has been seen for several windows in a row
+    auto current = classify(features_);
+    if (current == candidate_) {
+        candidateCount_++;
+    }
+    else {
+        candidate_ = current;
+        candidateCount_ = 1;
+    }
+
+    if (candidateCount_ >= config_.debounce) {
+        activity_ = candidate_;
+    }
+
+    // Keep the gravity estimate and crossing state so that windows are continuous
+    sumSquares_ = 0.0f;
+    crossings_ = 0;
+    samples_ = 0;
+    for (auto& state : goertzel_) {
+        state[0] = 0.0f;
+        state[1] = 0.0f;
+    }
+}
+
+MotionActivity MotionClassifier::classify(const MotionFeatures& features) const {
+    if (features.rms < config_.stationaryRms) {
+        return MotionActivity::STATIONARY;
+    }
+
+    if (features.rms >= config_.handlingRms && features.dominantFrequency <= config_.handlingMaxFrequency) {
+        return MotionActivity::HANDLING;
+    }
+
+    // A running engine produces a steady vibration concentrated around the firing frequency
+    if (features.rms < config_.idleMaxRms &&
+        features.dominantFrequency >= config_.idleMinFrequency &&
+        features.dominantRatio >= config_.tonalRatio) {
+        return MotionActivity::IDLING;
+    }
+
+    return MotionActivity::DRIVING;
+}
+
+MotionActivity MotionClassifier::getActivity() const {
+    return activity_;
+}
+
+void MotionClassifier::getFeatures(MotionFeatures& features) const {
+    features = features_;
+}
+
+bool MotionClassifier::isQuiescent() const {
+    // No window since the last restart, or a pending change, means the activity is not settled
+    if ((candidateCount_ == 0) || (candidate_ != activity_)) {
+        return false;
+    }
+    return (activity_ == MotionActivity::STATIONARY) || (activity_ == MotionActivity::IDLING);
+}
+
+void MotionClassifier::restart() {
+    gravity_ = 0.0f;
+    sumSquares_ = 0.0f;
+    lastSign_ = 0.0f;
+    crossings_ = 0;
+    samples_ = 0;
+    for (auto& state : goertzel_) {
+        state[0] = 0.0f;
+        state[1] = 0.0f;
+    }
+    candidate_ = activity_;
+    candidateCount_ = 0;
+}
+
+void MotionClassifier::reset() {
+    activity_ = MotionActivity::UNKNOWN;
+    features_ = {};
+    restart();
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief Activity classes reported by the motion classifier.
+ *
+ */
+enum class MotionActivity {
+    UNKNOWN,                        /**< Not enough data collected to classify */
+    STATIONARY,                     /**< No appreciable vibration */
+    IDLING,                         /**< Low level, narrow band vibration such as a running engine */
+    DRIVING,                        /**< Broadband vibration from vehicle movement */
+    HANDLING,                       /**< Large, slow accelerations from the device being moved by hand */
+};
+
+/**
+ * @brief Features extracted from one window of accelerometer samples.
+ *
+ */
+struct MotionFeatures {
+    float rms;                      /**< RMS of acceleration magnitude with gravity removed, in g */
+    float zeroCrossingRate;         /**< Zero crossings of the gravity removed magnitude, per second */
+    float dominantFrequency;        /**< Frequency, in Hz, of the strongest spectral bin */
+    float dominantRatio;            /**< Share of spectral power in the strongest bin [0.0 -> 1.0] */
+};
+
+/**
+ * @brief Thresholds used to classify extracted features.
+ *
+ */
+struct MotionClassifierConfig {
+    float rate;                     /**< Sample rate, in Hz, of the accelerometer data */
+    float stationaryRms;            /**< RMS, in g, below which the device is stationary */
+    float idleMaxRms;               /**< RMS, in g, above which vibration is no longer considered idling */
+    float idleMinFrequency;         /**< Minimum dominant frequency, in Hz, of idling vibration */
+    float tonalRatio;               /**< Minimum dominant ratio for vibration to be considered narrow band */
+    float handlingRms;              /**< RMS, in g, above which slow movement is considered handling */
+    float handlingMaxFrequency;     /**< Maximum dominant frequency, in Hz, of handling movement */
+    unsigned int debounce;          /**< Count of consecutive windows agreeing before an activity change is reported */
+};
+
+/**
+ * @brief Streaming accelerometer feature extractor and activity classifier.
+ *
+ * Windows, spectral bins and filtering are defined in time and frequency and sized to the sample
+ * rate so that thresholds keep their meaning at any accelerometer rate.
+ */
+class MotionClassifier {
+public:
+    static constexpr float WINDOW_TIME = 1.28;      // Seconds of samples in each window
+    static constexpr size_t FREQUENCY_BINS = 8;
+
+    MotionClassifier();
+
+    /**
+     * @brief Set classifier thresholds and restart classification
+     *
+     * @param config Classifier thresholds
+     */
+    void configure(const MotionClassifierConfig& config);
+
+    /**
+     * @brief Change the sample rate of the accelerometer data and restart classification
+     *
+     * @param rate Sample rate, in Hz
+     */
+    void setRate(float rate);
+
+    /**
+     * @brief Add one accelerometer sample
+     *
+     * @param x Acceleration along the X axis, in g
+     * @param y Acceleration along the Y axis, in g
+     * @param z Acceleration along the Z axis, in g
+     * @return true The sample completed a window that changed the reported activity
+     * @return false No change in the reported activity
+     */
+    bool addSample(float x, float y, float z);
+
+    /**
+     * @brief Add one accelerometer sample
+     *
+     * @param sample Acceleration, in g, with x, y and z members such as Bmi160Accelerometer
+     * @return true The sample completed a window that changed the reported activity
+     * @return false No change in the reported activity
+     */
+    template <typename T>
+    bool addSample(const T& sample) {
+        return addSample(sample.x, sample.y, sample.z);
+    }
+
+    /**
+     * @brief Get the last reported activity
+     *
+     * @return MotionActivity Reported activity
+     */
+    MotionActivity getActivity() const;
+
+    /**
+     * @brief Get the features from the last completed window
+     *
+     * @param features Returned features
+     */
+    void getFeatures(MotionFeatures& features) const;
+
+    /**
+     * @brief Indicate if the reported activity doesn't need further sampling to detect a change
+     *
+     * A restart, such as on a motion interrupt, clears this until a window completes that agrees
+     * with the reported activity.  A window suggesting a different activity keeps sampling until
+     * the change is confirmed or rejected.
+     *
+     * @return true Reported activity is stationary or idling and confirmed by the latest window
+     * @return false Reported activity is unknown, involves movement, or may be changing
+     */
+    bool isQuiescent() const;
+
+    /**
+     * @brief Discard the current window while keeping the reported activity
+     *
+     */
+    void restart();
+
+    /**
+     * @brief Discard the current window and the reported activity
+     *
+     */
+    void reset();
+
+private:
+    void updateRate();
+    void evaluateWindow();
+    MotionActivity classify(const MotionFeatures& features) const;
+
+    MotionClassifierConfig config_;
+    size_t windowSize_;                 // Samples in each window at the configured rate
+    size_t bins_;                       // Bins below the Nyquist frequency at the configured rate
+    float gravityAlpha_;
+    float coefficients_[FREQUENCY_BINS];
+    float goertzel_[FREQUENCY_BINS][2];
+    float gravity_;
+    float sumSquares_;
+    float lastSign_;
+    size_t crossings_;
+    size_t samples_;
+    MotionFeatures features_;
+    MotionActivity activity_;
+    MotionActivity candidate_;
+    unsigned int candidateCount_;
+};
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "motion_event_ring.h"
+
+MotionEventRing::MotionEventRing()
+    : slots_(nullptr),
+      size_(0),
+      head_(0),
+      tail_(0) {
+
+}
+
+MotionEventRing::~MotionEventRing() {
+    delete[] slots_;
+}
+
+int MotionEventRing::init(size_t depth) {
+    CHECK_FALSE(slots_, SYSTEM_ERROR_INVALID_STATE);
+    CHECK_TRUE(depth, SYSTEM_ERROR_INVALID_ARGUMENT);
+
+    slots_ = new (std::nothrow) Slot[depth + 1];
+    CHECK_TRUE(slots_, SYSTEM_ERROR_NO_MEMORY);
+    for (size_t i = 0; i < depth + 1; i++) {
+        slots_[i].merged.store(0, std::memory_order_relaxed);
+    }
+    size_ = depth + 1;
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+
+    return SYSTEM_ERROR_NONE;
+}
+
+size_t MotionEventRing::next(size_t index) const {
+    return (index + 1 < size_) ? (index + 1) : 0;
+}
+
+MotionEventRingResult MotionEventRing::put(const MotionEvent& event) {
+    if (!slots_) {
+        return MotionEventRingResult::OVERFLOW;
+    }
+
+    auto head = head_.load(std::memory_order_relaxed);
+    auto tail = tail_.load(std::memory_order_acquire);
+
+    // Try to merge with the newest slot.  The consumer marks a slot as taken by swapping its
+    // merged word to zero so the compare-exchange only succeeds while the slot is still unread.
+    // The count and last timestamp change together so the consumer never sees one without the
+    // other.  Events too far apart, or too many, to fit in the word go into a new slot.
+    if (head != tail) {
+        auto& last = slots_[(head == 0) ? (size_ - 1) : (head - 1)];
+        auto offset = event.timestamp - last.timestamp;
+        if ((last.source == event.source) && (last.activity == event.activity) && (offset <= UINT16_MAX)) {
+            auto merged = last.merged.load(std::memory_order_acquire);
+            while ((merged & UINT16_MAX) && ((merged & UINT16_MAX) < UINT16_MAX)) {
+                auto update = ((uint32_t)offset << 16) | ((merged & UINT16_MAX) + 1);
+                if (last.merged.compare_exchange_weak(merged, update, std::memory_order_acq_rel)) {
+                    return MotionEventRingResult::COALESCED;
+                }
+            }
+        }
+    }
+
+    auto following = next(head);
+    if (following == tail) {
+        return MotionEventRingResult::OVERFLOW;
+    }
+
+    auto& slot = slots_[head];
+    slot.source = event.source;
+    slot.activity = event.activity;
+    slot.timestamp = event.timestamp;
+    slot.interruptMicros = event.interruptMicros;
+    slot.postMicros = event.postMicros;
+    slot.merged.store(1, std::memory_order_relaxed);
+    head_.store(following, std::memory_order_release);
+
+    return MotionEventRingResult::ADDED;
+}
+
+bool MotionEventRing::take(MotionEvent& event) {
+    if (!slots_) {
+        return false;
+    }
+
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    auto& slot = slots_[tail];
+    event.source = slot.source;
+    event.activity = slot.activity;
+    event.timestamp = slot.timestamp;
+    event.interruptMicros = slot.interruptMicros;
+    event.postMicros = slot.postMicros;
+    // Claim the slot first so that no further events are merged into it
+    auto merged = slot.merged.exchange(0, std::memory_order_acq_rel);
+    event.count = merged & UINT16_MAX;
+    event.lastTimestamp = slot.timestamp + (merged >> 16);
+    tail_.store(next(tail), std::memory_order_release);
+
+    return true;
+}
+
+size_t MotionEventRing::drain(MotionEvent* events, size_t count) {
+    size_t taken = 0;
+    while ((taken < count) && take(events[taken])) {
+        taken++;
+    }
+
+    return taken;
+}
+
+size_t MotionEventRing::capacity() const {
+    return (size_) ? (size_ - 1) : 0;
+}
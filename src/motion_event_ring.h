@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Particle.h"
+#include <atomic>
+
+#include "motion_classifier.h"
+
+/**
+ * @brief Type of source for the given event.
+ *
+ */
+enum class MotionSource {
+    MOTION_NONE,                    /**< No movement, periodic timeout */
+    MOTION_MOVEMENT,                /**< Movement detected */
+    MOTION_HIGH_G,                  /**< High-G movement detected */
+    MOTION_ORIENTATION,             /**< Orientation change detected */
+    MOTION_ACTIVITY,                /**< Classified activity changed */
+    MOTION_STOPPED,                 /**< Movement stopped */
+};
+
+/**
+ * @brief Event reporting structure.
+ *
+ */
+struct MotionEvent {
+    MotionSource source;            /**< Type of source generating this event */
+    system_tick_t timestamp;        /**< Timestamp, in milliseconds, of the event */
+    MotionActivity activity;        /**< New activity for MOTION_ACTIVITY events */
+    system_tick_t lastTimestamp;    /**< Timestamp, in milliseconds, of the last event merged into this one */
+    uint32_t count;                 /**< Count of events merged into this one */
+    uint32_t interruptMicros;       /**< Timestamp, in microseconds, of the IMU interrupt or wakeup that raised the event */
+    uint32_t postMicros;            /**< Timestamp, in microseconds, when the event was added to the ring */
+};
+
+/**
+ * @brief Result of adding an event to the ring.
+ *
+ */
+enum class MotionEventRingResult {
+    ADDED,                          /**< Event was added to a new slot */
+    COALESCED,                      /**< Event was merged with the newest unread event */
+    OVERFLOW,                       /**< Ring was full and the event was dropped */
+};
+
+/**
+ * @brief Lock-free single producer, single consumer ring of motion events.
+ *
+ * Repeated events of the same kind are merged into the newest unread slot, when possible, so that
+ * bursts of interrupts take a single slot.  Only one thread may call put() and only one thread may
+ * call take() or drain().
+ */
+class MotionEventRing {
+public:
+    MotionEventRing();
+    ~MotionEventRing();
+
+    /**
+     * @brief Allocate the ring
+     *
+     * @param depth Count of events the ring can hold
+     * @retval SYSTEM_ERROR_NONE
+     * @retval SYSTEM_ERROR_INVALID_STATE
+     * @retval SYSTEM_ERROR_NO_MEMORY
+     */
+    int init(size_t depth);
+
+    /**
+     * @brief Add an event, merging it with the newest unread event if they match
+     *
+     * @param event Event to add, the count and last timestamp fields are ignored
+     * @return MotionEventRingResult Outcome of the operation
+     */
+    MotionEventRingResult put(const MotionEvent& event);
+
+    /**
+     * @brief Take the oldest event
+     *
+     * @param event Returned event
+     * @return true Event was returned
+     * @return false Ring is empty
+     */
+    bool take(MotionEvent& event);
+
+    /**
+     * @brief Take all available events, up to the given count
+     *
+     * @param events Returned events, oldest first
+     * @param count Maximum count of events to return
+     * @return size_t Count of events returned
+     */
+    size_t drain(MotionEvent* events, size_t count);
+
+    /**
+     * @brief Get the count of events the ring can hold
+     *
+     * @return size_t Ring capacity
+     */
+    size_t capacity() const;
+
+private:
+    struct Slot {
+        MotionSource source;
+        MotionActivity activity;
+        system_tick_t timestamp;
+        uint32_t interruptMicros;
+        uint32_t postMicros;
+        // Count of merged events in the low half and the offset, in milliseconds, of the last
+        // merged event from the timestamp in the high half.  Kept in one word so that a merge and
+        // the consumer taking the slot can't interleave.  Zero once taken by the consumer.
+        std::atomic<uint32_t> merged;
+    };
+
+    size_t next(size_t index) const;
+
+    Slot* slots_;
+    size_t size_;                       // One slot more than the capacity to tell full from empty
+    std::atomic<size_t> head_;          // Written by the producer only
+    std::atomic<size_t> tail_;          // Written by the consumer only
+};
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "motion_fusion.h"
+#include <cmath>
+
+using namespace particle;
+
+namespace {
+
+// Proportional and integral gains of the accelerometer correction
+constexpr float MotionFusionKp = 1.0;
+constexpr float MotionFusionKi = 0.02;
+
+constexpr float MotionFusionDegToRad = (float)M_PI / 180.0f;
+constexpr float MotionFusionRadToDeg = 180.0f / (float)M_PI;
+
+} // anonymous namespace
+
+MotionFusion::MotionFusion() {
+    reset();
+}
+
+void MotionFusion::initialize(const Bmi160Accelerometer& accel) {
+    // Start level with gravity so that the filter doesn't need to converge from an arbitrary attitude
+    auto roll = atan2f(accel.y, accel.z);
+    auto pitch = atan2f(-accel.x, sqrtf(accel.y * accel.y + accel.z * accel.z));
+    auto cr = cosf(roll * 0.5f);
+    auto sr = sinf(roll * 0.5f);
+    auto cp = cosf(pitch * 0.5f);
+    auto sp = sinf(pitch * 0.5f);
+
+    q_[0] = cr * cp;
+    q_[1] = sr * cp;
+    q_[2] = cr * sp;
+    q_[3] = -sr * sp;
+    valid_ = true;
+}
+
+void MotionFusion::update(const Bmi160Accelerometer& accel, const Bmi160Gyroscope& gyro, float period) {
+    auto norm = sqrtf(accel.x * accel.x + accel.y * accel.y + accel.z * accel.z);
+    if (!valid_) {
+        if (norm > 0.0f) {
+            initialize(accel);
+        }
+        return;
+    }
+
+    auto gx = gyro.x * MotionFusionDegToRad;
+    auto gy = gyro.y * MotionFusionDegToRad;
+    auto gz = gyro.z * MotionFusionDegToRad;
+    auto& q = q_;
+
+    // Correct the rates with the error between measured and estimated gravity
+    if (norm > 0.0f) {
+        auto ax = accel.x / norm;
+        auto ay = accel.y / norm;
+        auto az = accel.z / norm;
+
+        auto vx = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+        auto vy = 2.0f * (q[0] * q[1] + q[2] * q[3]);
+        auto vz = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+
+        auto ex = ay * vz - az * vy;
+        auto ey = az * vx - ax * vz;
+        auto ez = ax * vy - ay * vx;
+
+        integral_[0] += MotionFusionKi * ex * period;
+        integral_[1] += MotionFusionKi * ey * period;
+        integral_[2] += MotionFusionKi * ez * period;
+
+        gx += MotionFusionKp * ex + integral_[0];
+        gy += MotionFusionKp * ey + integral_[1];
+        gz += MotionFusionKp * ez + integral_[2];
+    }
+
+    // Integrate the quaternion rate of change
+    gx *= 0.5f * period;
+    gy *= 0.5f * period;
+    gz *= 0.5f * period;
+    auto qa = q[0];
+    auto qb = q[1];
+    auto qc = q[2];
+    q[0] += -qb * gx - qc * gy - q[3] * gz;
+    q[1] += qa * gx + qc * gz - q[3] * gy;
+    q[2] += qa * gy - qb * gz + q[3] * gx;
+    q[3] += qa * gz + qb * gy - qc * gx;
+
+    auto qnorm = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (auto& value : q_) {
+        value /= qnorm;
+    }
+}
+
+void MotionFusion::getOrientation(MotionOrientation& orientation) const {
+    auto& q = q_;
+
+    orientation.roll = atan2f(q[0] * q[1] + q[2] * q[3], 0.5f - q[1] * q[1] - q[2] * q[2]) * MotionFusionRadToDeg;
+    auto sinp = 2.0f * (q[0] * q[2] - q[1] * q[3]);
+    sinp = (sinp > 1.0f) ? 1.0f : ((sinp < -1.0f) ? -1.0f : sinp);
+    orientation.pitch = asinf(sinp) * MotionFusionRadToDeg;
+    auto heading = atan2f(q[1] * q[2] + q[0] * q[3], 0.5f - q[2] * q[2] - q[3] * q[3]) * MotionFusionRadToDeg;
+    orientation.heading = (heading < 0.0f) ? (heading + 360.0f) : heading;
+
+    // The Z axis component of the rotated vertical gives the cosine of the tilt
+    auto cosTilt = 1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2]);
+    cosTilt = (cosTilt > 1.0f) ? 1.0f : ((cosTilt < -1.0f) ? -1.0f : cosTilt);
+    orientation.tilt = acosf(cosTilt) * MotionFusionRadToDeg;
+}
+
+bool MotionFusion::isValid() const {
+    return valid_;
+}
+
+void MotionFusion::reset() {
+    q_[0] = 1.0f;
+    q_[1] = 0.0f;
+    q_[2] = 0.0f;
+    q_[3] = 0.0f;
+    integral_[0] = 0.0f;
+    integral_[1] = 0.0f;
+    integral_[2] = 0.0f;
+    valid_ = false;
+}
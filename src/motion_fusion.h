@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Particle.h"
+#include "bmi160.h"
+
+/**
+ * @brief Orientation of the device estimated from accelerometer and gyroscope samples.
+ *
+ * Heading is relative to the orientation when fusion started since there is no magnetometer, and
+ * slowly drifts with the gyroscope bias.
+ */
+struct MotionOrientation {
+    float roll;                     /**< Rotation about the X axis, in degrees [-180.0 -> 180.0] */
+    float pitch;                    /**< Rotation about the Y axis, in degrees [-90.0 -> 90.0] */
+    float heading;                  /**< Rotation about the vertical axis, in degrees [0.0 -> 360.0) */
+    float tilt;                     /**< Angle between the device Z axis and vertical, in degrees [0.0 -> 180.0] */
+};
+
+/**
+ * @brief Mahony complementary filter fusing accelerometer and gyroscope samples into an orientation.
+ *
+ * The accelerometer slowly corrects the integrated gyroscope rates so that roll, pitch and tilt don't
+ * drift.  Each update is a few dozen floating point operations.
+ */
+class MotionFusion {
+public:
+    MotionFusion();
+
+    /**
+     * @brief Add one pair of samples
+     *
+     * @param accel Acceleration, in g
+     * @param gyro Angular rate, in degrees per second
+     * @param period Time, in seconds, since the previous sample
+     */
+    void update(const particle::Bmi160Accelerometer& accel, const particle::Bmi160Gyroscope& gyro, float period);
+
+    /**
+     * @brief Get the current orientation estimate
+     *
+     * @param orientation Returned orientation
+     */
+    void getOrientation(MotionOrientation& orientation) const;
+
+    /**
+     * @brief Indicate if at least one sample has been added since the last reset
+     *
+     * @return true Orientation is valid
+     * @return false No samples yet
+     */
+    bool isValid() const;
+
+    /**
+     * @brief Discard the orientation estimate
+     *
+     */
+    void reset();
+
+private:
+    void initialize(const particle::Bmi160Accelerometer& accel);
+
+    float q_[4];                    // Orientation quaternion, scalar first
+    float integral_[3];             // Integral of the accelerometer error, in radians per second
+    bool valid_;
+};
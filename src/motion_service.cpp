@@ -18,19 +18,19 @@
 #include "tracker_config.h"
 #include "motion_service.h"
 #include "bmi160.h"
+#include "bmi160regs.h"
 
 using namespace spark;
 using namespace particle;
 
 namespace {
 
-// TODO: This should probably be a constant expression
-Bmi160AccelerometerConfig bmi160AccelConfig = {
+const Bmi160AccelerometerConfig bmi160AccelConfig = {
     .rate               = 100.0,    // Hz [0.78Hz -> 1600Hz]
     .range              = 16.0,     // g [2g, 4g, 8g, 16g]
 };
 
-Bmi160AccelMotionConfig bmi160MotionConfigs[] = {
+const Bmi160AccelMotionConfig bmi160MotionConfigs[] = {
     // Low sensitivity motion detection settings
     {
     .mode               = Bmi160AccelMotionMode::ACCEL_MOTION_MODE_SIGNIFICANT,
@@ -59,18 +59,33 @@ Bmi160AccelMotionConfig bmi160MotionConfigs[] = {
     },
 };
 
-Bmi160AccelHighGConfig bmi160HighGConfig = {
+const Bmi160AccelHighGConfig bmi160HighGConfig = {
     .threshold          = 4.0,          // g [up to range]
     .duration           = 0.0025,       // seconds
     .hysteresis         = 16.0 / 16.0,  // g [up to range]
 };
 
+const Bmi160AccelNoMotionConfig bmi160NoMotionConfig = {
+    .threshold          = 0.05,         // g [up to range]
+    .duration           = 10.24,        // seconds [1.28s -> 430s]
+};
+
 enum MotionAwakeFlags : uint32_t {
     MOTION_AWAKE_NONE       = 0,            // Nothing is awake
     MOTION_AWAKE_HIGH_G     = (1UL << 1),   // High G is awake
     MOTION_AWAKE_SIGANY     = (1UL << 2),   // Significant/any motion is awake
+    MOTION_AWAKE_FUSION     = (1UL << 3),   // Orientation estimation is awake
+    MOTION_AWAKE_POSTURE    = (1UL << 4),   // Orientation and flat detection is awake
 };
 
+// Samples read from the IMU FIFO at a time
+constexpr size_t MotionSampleChunk = 16;
+
+// Gyroscope range used for orientation estimation, in degrees per second, and the lowest
+// accelerometer rate the gyroscope can match
+constexpr float MotionFusionGyroRange = 500.0;
+constexpr float MotionFusionMinRate = 25.0;
+
 } // anonymous namespace
 
 MotionService *MotionService::_instance = nullptr;
@@ -78,11 +93,34 @@ MotionService *MotionService::_instance = nullptr;
 MotionService::MotionService()
     : thread_(nullptr),
       counters_({0}),
-      motionEventQueue_(nullptr),
+      eventWakeQueue_(nullptr),
       mode_(MotionDetectionMode::NONE),
       highGMode_(HighGDetectionMode::DISABLE),
       awakeFlags_(0),
-      eventDepth_(0) {
+      eventDepth_(0),
+      accelConfig_(bmi160AccelConfig),
+      customMotionConfig_(bmi160MotionConfigs[1]),
+      highGConfig_(bmi160HighGConfig),
+      appliedAccel_(bmi160AccelConfig),
+      appliedMotion_(bmi160MotionConfigs[1]),
+      appliedHighG_(bmi160HighGConfig),
+      appliedMotionValid_(false),
+      appliedHighGValid_(false),
+      classifierEnabled_(false),
+      sampling_(false),
+      captureEnabled_(false),
+      fifoRunning_(false),
+      fifoGyro_(false),
+      fusionEnabled_(false),
+      fusionRunning_(false),
+      orientation_({0}),
+      orientationValid_(false),
+      noMotionConfig_(bmi160NoMotionConfig),
+      stopDetectionEnabled_(false),
+      noMotionArmed_(false),
+      postureEnabled_(false),
+      posture_({}),
+      postureValid_(false) {
 
 }
 
@@ -101,14 +139,37 @@ int MotionService::start(size_t eventDepth) {
     // Clear all configuration to defaults
     BMI160.reset();
     awakeFlags_ = MOTION_AWAKE_NONE;
-    CHECK(BMI160.initAccelerometer(bmi160AccelConfig));
+    sampling_ = false;
+    fifoRunning_ = false;
+    fifoGyro_ = false;
+    fusionRunning_ = false;
+    noMotionArmed_ = false;
+    postureEnabled_ = false;
+    postureValid_ = false;
+    classifier_.reset();
+    capture_.reset();
+    auto accelConfig = accelConfig_;
+    CHECK(BMI160.initAccelerometer(accelConfig));
+    appliedAccel_ = accelConfig_;
+    appliedMotionValid_ = false;
+    appliedHighGValid_ = false;
+    classifier_.setRate(appliedAccel_.rate);
+    capture_.setRate(appliedAccel_.rate);
+
+    // Create the motion event ring if it hasn't been created yet
+    if (!eventRing_.capacity()) {
+        ret = eventRing_.init(eventDepth);
+        if (ret != SYSTEM_ERROR_NONE) {
+            LOG(ERROR, "eventRing_.init() failed");
+            return ret;
+        }
+    }
+    eventDepth_ = eventRing_.capacity();
 
-    // Create the motion event queue if it hasn't been created yet
-    eventDepth_ = eventDepth;
-    if (!motionEventQueue_ && os_queue_create(&motionEventQueue_, sizeof(MotionEvent), eventDepth, nullptr)) {
-        motionEventQueue_ = nullptr;
+    if (!eventWakeQueue_ && os_queue_create(&eventWakeQueue_, sizeof(uint8_t), 1, nullptr)) {
+        eventWakeQueue_ = nullptr;
         LOG(ERROR, "os_queue_create() failed");
-        return SYSTEM_ERROR_INTERNAL;
+        return SYSTEM_ERROR_NO_MEMORY;
     }
 
     // Start the main MotionService thread
@@ -140,46 +201,213 @@ int MotionService::join() {
     return SYSTEM_ERROR_NONE;
 }
 
-int MotionService::enableMotionDetection(MotionDetectionMode mode) {
-    // The motion service is simply configured from the outside using a handful of
-    // abstracted configuration modes: low, medium, and high.
+const Bmi160AccelMotionConfig* MotionService::getModeConfig(MotionDetectionMode mode) {
     switch (mode) {
-        case MotionDetectionMode::NONE: {
-            CHECK(BMI160.stopMotionDetect());
-            clearAwakeFlag(MOTION_AWAKE_SIGANY);
-            if (!isAnyAwake()) {
-                CHECK(BMI160.sleep());
-            }
-            mode_ = mode;
-            return SYSTEM_ERROR_NONE;
-        }
+        case MotionDetectionMode::LOW_SENSITIVITY:      return &bmi160MotionConfigs[0];
+        case MotionDetectionMode::MEDIUM_SENSITIVITY:   return &bmi160MotionConfigs[1];
+        case MotionDetectionMode::HIGH_SENSITIVITY:     return &bmi160MotionConfigs[2];
+        case MotionDetectionMode::CUSTOM_SENSITIVITY:   return &customMotionConfig_;
+        default:                                        return nullptr;
+    }
+}
 
-        case MotionDetectionMode::LOW_SENSITIVITY: {
-            BMI160.initMotion(bmi160MotionConfigs[0], false);
+int MotionService::applyAccelerometer(const Bmi160AccelerometerConfig& config) {
+    if (config.range != appliedAccel_.range) {
+        auto range = config.range;
+        CHECK(BMI160.setAccelRange(range));
+        appliedAccel_.range = config.range;
+        // Threshold registers are scaled by the range so force them to be written again
+        appliedMotion_.motionThreshold = -1.0;
+        appliedHighG_.threshold = -1.0;
+        appliedHighG_.hysteresis = -1.0;
+    }
 
-            break;
+    if (config.rate != appliedAccel_.rate) {
+        auto rate = config.rate;
+        CHECK(BMI160.setAccelRate(rate));
+        appliedAccel_.rate = config.rate;
+        classifier_.setRate(config.rate);
+        capture_.setRate(config.rate);
+        // Headerless FIFO frames need the gyroscope at the same rate
+        if (fusionRunning_ && (config.rate >= MotionFusionMinRate)) {
+            auto gyroRate = config.rate;
+            CHECK(BMI160.setGyroRate(gyroRate));
         }
+    }
 
-        case MotionDetectionMode::MEDIUM_SENSITIVITY: {
-            BMI160.initMotion(bmi160MotionConfigs[1], false);
-            break;
-        }
+    return SYSTEM_ERROR_NONE;
+}
 
-        case MotionDetectionMode::HIGH_SENSITIVITY: {
-            BMI160.initMotion(bmi160MotionConfigs[2], false);
-            break;
-        }
+int MotionService::applyMotion(const Bmi160AccelMotionConfig& config) {
+    // Write everything when the IMU contents are unknown, after a reset
+    bool all = !appliedMotionValid_;
 
-        default: {
-            return SYSTEM_ERROR_UNKNOWN;
+    if (all || (config.mode != appliedMotion_.mode)) {
+        CHECK(BMI160.setAccelMotionMode(config.mode));
+    }
+    if (all || (config.motionThreshold != appliedMotion_.motionThreshold)) {
+        auto threshold = config.motionThreshold;
+        CHECK(BMI160.setAccelMotionThreshold(threshold));
+    }
+    if (all || (config.motionDuration != appliedMotion_.motionDuration)) {
+        auto duration = config.motionDuration;
+        CHECK(BMI160.setAccelMotionDuration(duration));
+    }
+    if (all || (config.motionSkip != appliedMotion_.motionSkip)) {
+        CHECK(BMI160.setAccelMotionSkip(config.motionSkip));
+    }
+    if (all || (config.motionProof != appliedMotion_.motionProof)) {
+        CHECK(BMI160.setAccelMotionProof(config.motionProof));
+    }
+
+    appliedMotion_ = config;
+    appliedMotionValid_ = true;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int MotionService::applyHighG(const Bmi160AccelHighGConfig& config) {
+    bool all = !appliedHighGValid_;
+
+    if (all || (config.threshold != appliedHighG_.threshold)) {
+        auto threshold = config.threshold;
+        CHECK(BMI160.setAccelHighGThreshold(threshold));
+    }
+    if (all || (config.duration != appliedHighG_.duration)) {
+        auto duration = config.duration;
+        CHECK(BMI160.setAccelHighGDuration(duration));
+    }
+    if (all || (config.hysteresis != appliedHighG_.hysteresis)) {
+        auto hysteresis = config.hysteresis;
+        CHECK(BMI160.setAccelHighGHysteresis(hysteresis));
+    }
+
+    appliedHighG_ = config;
+    appliedHighGValid_ = true;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int MotionService::armNoMotion(bool arm) {
+    if (arm == noMotionArmed_) {
+        return SYSTEM_ERROR_NONE;
+    }
+
+    if (arm) {
+        // Settings are written on every arm, only changed registers reach the IMU
+        auto config = noMotionConfig_;
+        Bmi160::UpdateGuard update(BMI160);
+        CHECK(BMI160.initNoMotion(config));
+        CHECK(BMI160.startNoMotionDetect());
+        CHECK(update.apply());
+    }
+    else {
+        CHECK(BMI160.stopNoMotionDetect());
+    }
+    noMotionArmed_ = arm;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int MotionService::setAccelerometerConfig(const Bmi160AccelerometerConfig& config) {
+    // The classifier, capture and applied settings are in use by the service thread
+    const std::lock_guard<Mutex> lock(serviceLock_);
+    accelConfig_ = config;
+    if (!thread_) {
+        return SYSTEM_ERROR_NONE;
+    }
+
+    // A range change rewrites every threshold so send the registers together
+    Bmi160::UpdateGuard update(BMI160);
+    CHECK(applyAccelerometer(accelConfig_));
+    if (mode_ != MotionDetectionMode::NONE) {
+        CHECK(applyMotion(*getModeConfig(mode_)));
+    }
+    if (highGMode_ == HighGDetectionMode::ENABLE) {
+        CHECK(applyHighG(highGConfig_));
+    }
+    if (noMotionArmed_) {
+        auto config = noMotionConfig_;
+        CHECK(BMI160.initNoMotion(config));
+    }
+
+    CHECK(update.apply());
+
+    // Let the service thread stop or restart estimation if the rate no longer suits the gyroscope
+    if (fusionEnabled_) {
+        BMI160.syncEvent(Bmi160::Bmi160EventType::NONE);
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+void MotionService::getAccelerometerConfig(Bmi160AccelerometerConfig& config) {
+    config = accelConfig_;
+}
+
+int MotionService::setMotionConfig(const Bmi160AccelMotionConfig& config) {
+    const std::lock_guard<Mutex> lock(serviceLock_);
+    customMotionConfig_ = config;
+    if (thread_ && (mode_ == MotionDetectionMode::CUSTOM_SENSITIVITY)) {
+        Bmi160::UpdateGuard update(BMI160);
+        CHECK(applyMotion(customMotionConfig_));
+        CHECK(update.apply());
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+void MotionService::getMotionConfig(Bmi160AccelMotionConfig& config) {
+    config = customMotionConfig_;
+}
+
+int MotionService::setHighGConfig(const Bmi160AccelHighGConfig& config) {
+    const std::lock_guard<Mutex> lock(serviceLock_);
+    highGConfig_ = config;
+    if (thread_ && (highGMode_ == HighGDetectionMode::ENABLE)) {
+        Bmi160::UpdateGuard update(BMI160);
+        CHECK(applyHighG(highGConfig_));
+        CHECK(update.apply());
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+void MotionService::getHighGConfig(Bmi160AccelHighGConfig& config) {
+    config = highGConfig_;
+}
+
+int MotionService::enableMotionDetection(MotionDetectionMode mode) {
+    const std::lock_guard<Mutex> lock(serviceLock_);
+
+    // The motion service is simply configured from the outside using a handful of
+    // abstracted configuration modes: low, medium, high, and custom.
+    if (mode == MotionDetectionMode::NONE) {
+        CHECK(BMI160.stopMotionDetect());
+        CHECK(armNoMotion(false));
+        clearAwakeFlag(MOTION_AWAKE_SIGANY);
+        if (!isAnyAwake()) {
+            CHECK(BMI160.sleep());
         }
+        mode_ = mode;
+        return SYSTEM_ERROR_NONE;
+    }
+
+    auto config = getModeConfig(mode);
+    if (!config) {
+        return SYSTEM_ERROR_UNKNOWN;
     }
 
     if (!isAnyAwake()) {
         CHECK(BMI160.wakeup());
     }
     setAwakeFlag(MOTION_AWAKE_SIGANY);
+
+    // Thresholds and the interrupt enable are written together on the way out of sleep
+    Bmi160::UpdateGuard update(BMI160);
+    CHECK(applyMotion(*config));
     CHECK(BMI160.startMotionDetect());
+    CHECK(update.apply());
 
     mode_ = mode;
 
@@ -195,20 +423,30 @@ MotionDetectionMode MotionService::getMotionDetection() {
 }
 
 int MotionService::enableHighGDetection() {
+    const std::lock_guard<Mutex> lock(serviceLock_);
     if (!isAnyAwake()) {
         CHECK(BMI160.wakeup());
     }
     setAwakeFlag(MOTION_AWAKE_HIGH_G);
-    BMI160.initHighG(bmi160HighGConfig, false);
+    Bmi160::UpdateGuard update(BMI160);
+    CHECK(applyHighG(highGConfig_));
     CHECK(BMI160.startHighGDetect());
+    CHECK(update.apply());
     highGMode_ = HighGDetectionMode::ENABLE;
+    if (captureEnabled_ && thread_) {
+        BMI160.syncEvent(Bmi160::Bmi160EventType::NONE);
+    }
 
     return SYSTEM_ERROR_NONE;
 }
 
 int MotionService::disableHighGDetection() {
+    const std::lock_guard<Mutex> lock(serviceLock_);
     CHECK(BMI160.stopHighGDetect());
     highGMode_ = HighGDetectionMode::DISABLE;
+    if (captureEnabled_ && thread_) {
+        BMI160.syncEvent(Bmi160::Bmi160EventType::NONE);
+    }
     clearAwakeFlag(MOTION_AWAKE_HIGH_G);
     if (!isAnyAwake()) {
         CHECK(BMI160.sleep());
@@ -221,15 +459,353 @@ HighGDetectionMode MotionService::getHighGDetection() {
     return highGMode_;
 }
 
+int MotionService::enableClassifier(bool enable) {
+    classifierEnabled_ = enable;
+
+    // Let the service thread start or stop sampling as needed
+    if (thread_) {
+        BMI160.syncEvent(Bmi160::Bmi160EventType::NONE);
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+bool MotionService::isClassifierEnabled() {
+    return classifierEnabled_;
+}
+
+MotionActivity MotionService::getActivity() {
+    return classifier_.getActivity();
+}
+
+int MotionService::enableCapture(bool enable) {
+    captureEnabled_ = enable;
+
+    // Let the service thread start or stop the FIFO as needed
+    if (thread_) {
+        BMI160.syncEvent(Bmi160::Bmi160EventType::NONE);
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+bool MotionService::isCaptureEnabled() {
+    return captureEnabled_;
+}
+
+bool MotionService::isCapturing() {
+    return capture_.isCapturing();
+}
+
+const MotionCaptureWindow* MotionService::getCapture() {
+    return capture_.getWindow();
+}
+
+void MotionService::releaseCapture() {
+    capture_.release();
+}
+
+int MotionService::enableFusion(bool enable) {
+    fusionEnabled_ = enable;
+
+    // Let the service thread power the gyroscope up or down
+    if (thread_) {
+        BMI160.syncEvent(Bmi160::Bmi160EventType::NONE);
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+bool MotionService::isFusionEnabled() {
+    return fusionEnabled_;
+}
+
+int MotionService::getOrientation(MotionOrientation& orientation) {
+    const std::lock_guard<Mutex> lock(orientationLock_);
+    CHECK_TRUE(orientationValid_, SYSTEM_ERROR_INVALID_STATE);
+    orientation = orientation_;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int MotionService::setNoMotionConfig(const Bmi160AccelNoMotionConfig& config) {
+    const std::lock_guard<Mutex> lock(serviceLock_);
+    noMotionConfig_ = config;
+    if (thread_ && noMotionArmed_) {
+        auto workConfig = noMotionConfig_;
+        CHECK(BMI160.initNoMotion(workConfig));
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+void MotionService::getNoMotionConfig(Bmi160AccelNoMotionConfig& config) {
+    config = noMotionConfig_;
+}
+
+int MotionService::enableStopDetection(bool enable) {
+    // Arming is shared with the interrupt handling on the service thread
+    const std::lock_guard<Mutex> lock(serviceLock_);
+    stopDetectionEnabled_ = enable;
+    if (!enable) {
+        CHECK(armNoMotion(false));
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+bool MotionService::isStopDetectionEnabled() {
+    return stopDetectionEnabled_;
+}
+
+int MotionService::enablePostureDetection(bool enable) {
+    const std::lock_guard<Mutex> lock(serviceLock_);
+    if (enable == postureEnabled_) {
+        return SYSTEM_ERROR_NONE;
+    }
+
+    if (enable) {
+        if (!isAnyAwake()) {
+            CHECK(BMI160.wakeup());
+        }
+        setAwakeFlag(MOTION_AWAKE_POSTURE);
+        Bmi160::UpdateGuard update(BMI160);
+        CHECK(BMI160.startOrientationDetect());
+        CHECK(BMI160.startFlatDetect());
+        CHECK(update.apply());
+    }
+    else {
+        Bmi160::UpdateGuard update(BMI160);
+        CHECK(BMI160.stopOrientationDetect());
+        CHECK(BMI160.stopFlatDetect());
+        CHECK(update.apply());
+        clearAwakeFlag(MOTION_AWAKE_POSTURE);
+        if (!isAnyAwake()) {
+            CHECK(BMI160.sleep());
+        }
+        const std::lock_guard<Mutex> lock(orientationLock_);
+        postureValid_ = false;
+    }
+    postureEnabled_ = enable;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+bool MotionService::isPostureDetectionEnabled() {
+    return postureEnabled_;
+}
+
+int MotionService::getPosture(MotionPosture& posture) {
+    const std::lock_guard<Mutex> lock(orientationLock_);
+    CHECK_TRUE(postureValid_, SYSTEM_ERROR_INVALID_STATE);
+    posture = posture_;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int MotionService::startSampling() {
+    classifier_.restart();
+    sampling_ = true;
+
+    return updateFifo();
+}
+
+int MotionService::stopSampling() {
+    sampling_ = false;
+
+    return updateFifo();
+}
+
+int MotionService::updateFusion() {
+    bool needed = fusionEnabled_ && (appliedAccel_.rate >= MotionFusionMinRate);
+
+    if (needed && !fusionRunning_) {
+        // Both sensors sample continuously, at the same rate, so that their FIFO frames line up
+        Bmi160GyroscopeConfig gyroConfig = {
+            .rate = appliedAccel_.rate,
+            .range = MotionFusionGyroRange,
+        };
+        setAwakeFlag(MOTION_AWAKE_FUSION);
+        CHECK(BMI160.wakeup(true));
+        CHECK(BMI160.initGyroscope(gyroConfig));
+        CHECK(BMI160.wakeupGyro());
+        fusion_.reset();
+        fusionRunning_ = true;
+    }
+    else if (!needed && fusionRunning_) {
+        fusionRunning_ = false;
+        {
+            const std::lock_guard<Mutex> lock(orientationLock_);
+            orientationValid_ = false;
+        }
+        CHECK(BMI160.sleepGyro());
+        clearAwakeFlag(MOTION_AWAKE_FUSION);
+        // Return the accelerometer to low power for the remaining detectors, if any
+        if (isAnyAwake()) {
+            CHECK(BMI160.wakeup());
+        }
+        else {
+            CHECK(BMI160.sleep());
+        }
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+int MotionService::updateFifo() {
+    // The FIFO is left running while armed for capture so that it holds the samples leading up to an event
+    bool needed = sampling_ || capture_.isCapturing() || fusionRunning_ ||
+        (captureEnabled_ && (highGMode_ == HighGDetectionMode::ENABLE));
+
+    // Frames change size when gyroscope samples are added or removed so start over
+    if (fifoRunning_ && (fifoGyro_ != fusionRunning_)) {
+        fifoRunning_ = false;
+        CHECK(BMI160.stopFifo());
+    }
+
+    if (needed && !fifoRunning_) {
+        CHECK(BMI160.startFifo(fusionRunning_));
+        fifoRunning_ = true;
+        fifoGyro_ = fusionRunning_;
+    }
+    else if (!needed && fifoRunning_) {
+        fifoRunning_ = false;
+        CHECK(BMI160.stopFifo());
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+system_tick_t MotionService::getSamplePeriod() const {
+    // Read the FIFO by the time it is half full to leave room for a late read
+    auto frameSize = (fifoGyro_) ? BMI160_FIFO_GYRO_ACCEL_FRAME_SIZE : BMI160_FIFO_ACCEL_FRAME_SIZE;
+    auto period = (system_tick_t)(500.0f * (BMI160_FIFO_SIZE / frameSize) / appliedAccel_.rate);
+    return std::max<system_tick_t>(1, std::min(period, MOTION_SAMPLE_PERIOD));
+}
+
+bool MotionService::isFifoShort() const {
+    auto frameSize = (fifoGyro_) ? BMI160_FIFO_GYRO_ACCEL_FRAME_SIZE : BMI160_FIFO_ACCEL_FRAME_SIZE;
+    return captureEnabled_ && fifoRunning_ &&
+        ((float)(BMI160_FIFO_SIZE / frameSize) < appliedAccel_.rate * MotionCapturePreTime);
+}
+
+int MotionService::processSamples(uint32_t interruptMicros) {
+    Bmi160Accelerometer samples[MotionSampleChunk];
+    Bmi160Gyroscope rates[MotionSampleChunk];
+    auto period = 1.0f / appliedAccel_.rate;
+    size_t count = 0;
+
+    do {
+        CHECK(BMI160.readFifo(samples, (fifoGyro_) ? rates : nullptr, MotionSampleChunk, count));
+        for (size_t i = 0; i < count; i++) {
+            if (fifoGyro_) {
+                fusion_.update(samples[i], rates[i], period);
+            }
+            if (captureEnabled_ || capture_.isCapturing()) {
+                bool capturing = capture_.isCapturing();
+                capture_.addSample(samples[i]);
+                if (capturing && !capture_.isCapturing()) {
+                    counters_.captureEvents++;
+                }
+            }
+            if (sampling_ && classifier_.addSample(samples[i])) {
+                counters_.activityEvents++;
+                postEvent(MotionSource::MOTION_ACTIVITY, interruptMicros, classifier_.getActivity());
+            }
+        }
+    } while (count == MotionSampleChunk);
+
+    if (fifoGyro_ && fusion_.isValid()) {
+        const std::lock_guard<Mutex> lock(orientationLock_);
+        fusion_.getOrientation(orientation_);
+        orientationValid_ = true;
+    }
+
+    return SYSTEM_ERROR_NONE;
+}
+
+void MotionService::postEvent(MotionSource source, uint32_t interruptMicros, MotionActivity activity) {
+    MotionEvent event = {
+        .source = source,
+        .timestamp = (system_tick_t)millis(),
+        .activity = activity,
+    };
+    event.interruptMicros = interruptMicros;
+    event.postMicros = (uint32_t)micros();
+    recordLatency(counters_.postLatency, event.postMicros - interruptMicros);
+
+    switch (eventRing_.put(event)) {
+        case MotionEventRingResult::COALESCED: {
+            counters_.coalescedEvents++;
+            break;
+        }
+
+        case MotionEventRingResult::OVERFLOW: {
+            counters_.overflowEvents++;
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+
+    // Wake any waiter, a wakeup already queued covers this event too
+    uint8_t wake = 0;
+    os_queue_put(eventWakeQueue_, &wake, 0, nullptr);
+}
+
 int MotionService::waitOnEvent(MotionEvent& event, system_tick_t timeout) {
-    auto ret = os_queue_take(motionEventQueue_, &event, timeout, nullptr);
-    if (ret) {
-        event.source = MotionSource::MOTION_NONE;
+    CHECK_TRUE(eventWakeQueue_, SYSTEM_ERROR_INVALID_STATE);
+
+    // The event ring does not block so wait on the wakeup queue until an event is added or the
+    // timeout expires.  A wakeup may be left over from an event already taken so check again.
+    auto start = millis();
+    while (!eventRing_.take(event)) {
+        auto elapsed = millis() - start;
+        if (elapsed >= timeout) {
+            event = {};
+            event.source = MotionSource::MOTION_NONE;
+            return SYSTEM_ERROR_NONE;
+        }
+        uint8_t wake;
+        os_queue_take(eventWakeQueue_, &wake, timeout - elapsed, nullptr);
     }
+    recordLatency(counters_.queueLatency, (uint32_t)micros() - event.postMicros);
 
     return SYSTEM_ERROR_NONE;
 }
 
+size_t MotionService::drainEvents(MotionEvent* events, size_t count) {
+    auto taken = eventRing_.drain(events, count);
+    auto now = (uint32_t)micros();
+    for (size_t i = 0; i < taken; i++) {
+        recordLatency(counters_.queueLatency, now - events[i].postMicros);
+    }
+
+    return taken;
+}
+
+void MotionService::recordPublishLatency(system_tick_t eventMillis) {
+    // Publishes may take minutes and span sleep so this is timed in milliseconds
+    recordLatency(counters_.publishLatency, (uint32_t)(millis() - eventMillis));
+}
+
+void MotionService::recordLatency(MotionLatencyHistogram& histogram, uint32_t latency) {
+    size_t bucket = 0;
+    auto limit = latency >> MotionLatencyFirstShift;
+    while (limit && (bucket < MotionLatencyBuckets - 1)) {
+        limit >>= 1;
+        bucket++;
+    }
+
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    if (latency > histogram.max) {
+        histogram.max = latency;
+    }
+}
+
 void MotionService::getStatistics(MotionCounters& stats) {
     stats = counters_;
 }
@@ -243,7 +819,18 @@ void MotionService::thread(void* context) {
     bool exitLoop = false;
     while (!exitLoop) {
         Bmi160::Bmi160EventType event;
-        BMI160.waitOnEvent(event, MotionService::MOTION_TIMEOUT_DEFAULT);
+        uint32_t eventMicros = 0;
+        system_tick_t timeout = MotionService::MOTION_TIMEOUT_DEFAULT;
+        {
+            const std::lock_guard<Mutex> lock(self->serviceLock_);
+            if (self->sampling_ || self->capture_.isCapturing() || self->fusionRunning_ || self->isFifoShort()) {
+                timeout = self->getSamplePeriod();
+            }
+        }
+        BMI160.waitOnEvent(event, eventMicros, timeout);
+
+        // Configuration from the application waits until this event is handled
+        const std::lock_guard<Mutex> lock(self->serviceLock_);
         switch (event) {
 
             // This event may be a result of a timeout of the waitOnEvent() call if
@@ -260,18 +847,54 @@ void MotionService::thread(void* context) {
             // extra information to the queue consumer.
             case Bmi160::Bmi160EventType::SYNC: {
                 self->counters_.syncEvents++;
+                recordLatency(self->counters_.interruptLatency, (uint32_t)micros() - eventMicros);
                 uint32_t status = 0;
                 BMI160.getStatus(status, true);
 
                 if (BMI160.isHighGDetect(status)) {
                     self->counters_.highGEvents++;
-                    MotionEvent event = { .source = MotionSource::MOTION_HIGH_G };
-                    os_queue_put(self->motionEventQueue_, &event, 0, nullptr);
+                    if (self->captureEnabled_ && self->fifoRunning_) {
+                        // Move everything up to the interrupt into the pre-trigger buffer before freezing it
+                        self->processSamples(eventMicros);
+                        if (!self->capture_.trigger(Time.isValid() ? Time.now() : 0)) {
+                            self->counters_.captureDrops++;
+                        }
+                    }
+                    self->postEvent(MotionSource::MOTION_HIGH_G, eventMicros);
                 }
                 if (BMI160.isMotionDetect(status)) {
                     self->counters_.motionEvents++;
-                    MotionEvent event = { .source = MotionSource::MOTION_MOVEMENT };
-                    os_queue_put(self->motionEventQueue_, &event, 0, nullptr);
+                    // With classification enabled the interrupt only starts sampling and
+                    // the classifier decides whether the movement is worth reporting
+                    if (self->classifierEnabled_) {
+                        if (!self->sampling_) {
+                            self->startSampling();
+                        }
+                    }
+                    else {
+                        self->postEvent(MotionSource::MOTION_MOVEMENT, eventMicros);
+                    }
+                    // Watch for the end of this movement
+                    if (self->stopDetectionEnabled_) {
+                        self->armNoMotion(true);
+                    }
+                }
+                // A no-motion interrupt that follows a motion interrupt in the same status is stale
+                else if (self->noMotionArmed_ && BMI160.isNoMotionDetect(status)) {
+                    self->counters_.stopEvents++;
+                    self->armNoMotion(false);
+                    self->postEvent(MotionSource::MOTION_STOPPED, eventMicros);
+                }
+                if (self->postureEnabled_ && (BMI160.isOrientationDetect(status) || BMI160.isFlatDetect(status))) {
+                    self->counters_.postureEvents++;
+                    {
+                        const std::lock_guard<Mutex> lock(self->orientationLock_);
+                        self->posture_.facing = BMI160.getOrientation(status);
+                        self->posture_.faceDown = BMI160.isFaceDown(status);
+                        self->posture_.flat = BMI160.isFlat(status);
+                        self->postureValid_ = true;
+                    }
+                    self->postEvent(MotionSource::MOTION_ORIENTATION, eventMicros);
                 }
                 break;
             }
@@ -287,6 +910,32 @@ void MotionService::thread(void* context) {
                 break;
             }
         }
+
+        if (self->sampling_ || self->capture_.isCapturing() || self->fifoGyro_ || self->isFifoShort()) {
+            self->processSamples(eventMicros);
+        }
+
+        if (self->sampling_) {
+            // Nothing left to distinguish until the next motion interrupt
+            if (!self->classifierEnabled_ || (self->mode_ == MotionDetectionMode::NONE) || self->classifier_.isQuiescent()) {
+                self->stopSampling();
+            }
+        }
+
+        self->updateFusion();
+        self->updateFifo();
+    }
+
+    {
+        const std::lock_guard<Mutex> lock(self->serviceLock_);
+        self->sampling_ = false;
+        self->captureEnabled_ = false;
+        self->capture_.reset();
+        self->fusionEnabled_ = false;
+        self->stopDetectionEnabled_ = false;
+        self->armNoMotion(false);
+        self->updateFusion();
+        self->updateFifo();
     }
 
     os_thread_exit(nullptr);
@@ -17,37 +17,40 @@
 #pragma once
 
 #include "Particle.h"
+#include "motion_classifier.h"
+#include "motion_capture.h"
+#include "motion_event_ring.h"
+#include "motion_fusion.h"
 
 /**
- * @brief Type of source for the given event.
+ * @brief Sensitivity confuration for motion detection.
  *
  */
-enum class MotionSource {
-    MOTION_NONE,                    /**< No movement, periodic timeout */
-    MOTION_MOVEMENT,                /**< Movement detected */
-    MOTION_HIGH_G,                  /**< High-G movement detected */
-    MOTION_ORIENTATION,             /**< Orientation change detected */
+enum class MotionDetectionMode {
+    NONE,                           /**< No motion detection */
+    LOW_SENSITIVITY,                /**< Low sensitivity motion detection */
+    MEDIUM_SENSITIVITY,             /**< Medium sensitivity motion detection */
+    HIGH_SENSITIVITY,               /**< High sensitivity motion detection */
+    CUSTOM_SENSITIVITY,             /**< Motion detection using the settings given to setMotionConfig() */
 };
 
-
 /**
- * @brief Event reporting structure.
+ * @brief Count of buckets in a latency histogram.
  *
+ * Bucket 0 counts latencies under 64us and each following bucket doubles the limit.  The last bucket
+ * counts everything above about 17 seconds, or about 4.7 hours for histograms in milliseconds.
  */
-struct MotionEvent {
-    MotionSource source;            /**< Type of source generating this event */
-    system_tick_t timestamp;        /**< Timestamp, in milliseconds, of the event */
-};
+constexpr size_t MotionLatencyBuckets = 20;
+constexpr unsigned int MotionLatencyFirstShift = 6;
 
 /**
- * @brief Sensitivity confuration for motion detection.
+ * @brief Latency histogram, in microseconds, or in milliseconds for publish latency.
  *
  */
-enum class MotionDetectionMode {
-    NONE,                           /**< No motion detection */
-    LOW_SENSITIVITY,                /**< Low sensitivity motion detection */
-    MEDIUM_SENSITIVITY,             /**< Medium sensitivity motion detection */
-    HIGH_SENSITIVITY,               /**< High sensitivity motion detection */
+struct MotionLatencyHistogram {
+    uint32_t buckets[MotionLatencyBuckets];     /**< Count of samples in each power of two bucket */
+    uint32_t count;                             /**< Count of all samples */
+    uint32_t max;                               /**< Largest sample */
 };
 
 /**
@@ -61,6 +64,17 @@ struct MotionCounters {
     size_t motionEvents;            /**< Count of motion events from inertial motion units */
     size_t highGEvents;             /**< Count of high G events from inertial motion units */
     size_t breakEvents;             /**< Count of graceful thread exits */
+    size_t activityEvents;          /**< Count of classified activity changes */
+    size_t stopEvents;              /**< Count of no-motion events after movement from inertial motion units */
+    size_t postureEvents;           /**< Count of orientation and flat events from inertial motion units */
+    size_t captureEvents;           /**< Count of completed impact captures */
+    size_t captureDrops;            /**< Count of high G events not captured because a capture was pending */
+    size_t coalescedEvents;         /**< Count of events merged with an unread event of the same kind */
+    size_t overflowEvents;          /**< Count of events dropped because the event ring was full */
+    MotionLatencyHistogram interruptLatency;    /**< IMU interrupt to service thread wakeup */
+    MotionLatencyHistogram postLatency;         /**< IMU interrupt to event added to the ring */
+    MotionLatencyHistogram queueLatency;        /**< Event added to the ring to event taken by the consumer */
+    MotionLatencyHistogram publishLatency;      /**< Event added to the ring to acknowledged publish of the resulting trigger, in milliseconds */
 };
 
 /**
@@ -72,6 +86,15 @@ enum class HighGDetectionMode {
     ENABLE,                         /**< Enabled high G detection */
 };
 
+/**
+ * @brief Device posture reported by the orientation and flat detectors.
+ *
+ */
+struct MotionPosture {
+    particle::Bmi160Orientation facing;     /**< Orientation in the plane of the device */
+    bool faceDown;                          /**< Device is facing down */
+    bool flat;                              /**< Device is lying flat */
+};
 
 /**
  * @brief Motion service class to configure and service intertial motion unit events.
@@ -81,6 +104,7 @@ class MotionService {
 public:
     static constexpr system_tick_t MOTION_TIMEOUT_DEFAULT = 5*60*1000;
     static constexpr system_tick_t MOTION_EVENTS_DEFAULT = 10;
+    static constexpr system_tick_t MOTION_SAMPLE_PERIOD = 250;
 
     /**
      * @brief Return instance of the motion service
@@ -153,6 +177,58 @@ public:
      */
     MotionDetectionMode getMotionDetection();
 
+    /**
+     * @brief Set accelerometer sample rate and range
+     *
+     * Only settings that differ from those already in the IMU are written.  Motion and high G
+     * thresholds are written again when the range changes since they are scaled by the range.
+     *
+     * @param config Accelerometer settings
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int setAccelerometerConfig(const particle::Bmi160AccelerometerConfig& config);
+
+    /**
+     * @brief Get accelerometer sample rate and range
+     *
+     * @param config Returned accelerometer settings
+     */
+    void getAccelerometerConfig(particle::Bmi160AccelerometerConfig& config);
+
+    /**
+     * @brief Set motion detection settings used by CUSTOM_SENSITIVITY
+     *
+     * Settings are written to the IMU right away, and only where changed, if custom sensitivity is in use.
+     *
+     * @param config Motion detection settings
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int setMotionConfig(const particle::Bmi160AccelMotionConfig& config);
+
+    /**
+     * @brief Get motion detection settings used by CUSTOM_SENSITIVITY
+     *
+     * @param config Returned motion detection settings
+     */
+    void getMotionConfig(particle::Bmi160AccelMotionConfig& config);
+
+    /**
+     * @brief Set high G detection settings
+     *
+     * Settings are written to the IMU right away, and only where changed, if high G detection is enabled.
+     *
+     * @param config High G detection settings
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int setHighGConfig(const particle::Bmi160AccelHighGConfig& config);
+
+    /**
+     * @brief Get high G detection settings
+     *
+     * @param config Returned high G detection settings
+     */
+    void getHighGConfig(particle::Bmi160AccelHighGConfig& config);
+
     /**
      * @brief Enable high G detection mode
      *
@@ -174,6 +250,166 @@ public:
      */
     HighGDetectionMode getHighGDetection();
 
+    /**
+     * @brief Enable or disable activity classification
+     *
+     * When enabled, motion interrupts start sampling of the accelerometer and only changes of the
+     * classified activity are reported, as MOTION_ACTIVITY events, instead of MOTION_MOVEMENT events.
+     * Sampling stops once the device is classified as stationary or idling.
+     *
+     * @param enable Enable classification
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int enableClassifier(bool enable);
+
+    /**
+     * @brief Indicate if activity classification is enabled
+     *
+     * @return true Classification is enabled
+     * @return false Classification is disabled
+     */
+    bool isClassifierEnabled();
+
+    /**
+     * @brief Get the last classified activity
+     *
+     * @retval One of UNKNOWN, STATIONARY, IDLING, DRIVING, HANDLING
+     */
+    MotionActivity getActivity();
+
+    /**
+     * @brief Enable or disable capture of the acceleration waveform around high G events
+     *
+     * Capture requires high G detection to be enabled.  Samples before the event are taken from the
+     * IMU FIFO so the service thread does not need to wake while waiting for an event.
+     *
+     * @param enable Enable capture
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int enableCapture(bool enable);
+
+    /**
+     * @brief Indicate if high G capture is enabled
+     *
+     * @return true Capture is enabled
+     * @return false Capture is disabled
+     */
+    bool isCaptureEnabled();
+
+    /**
+     * @brief Indicate if samples after a high G event are still being collected
+     *
+     * @return true Capture in progress
+     * @return false No capture in progress
+     */
+    bool isCapturing();
+
+    /**
+     * @brief Get a completed high G capture
+     *
+     * The window remains valid, and no further captures are made, until releaseCapture() is called.
+     *
+     * @return const MotionCaptureWindow* Completed capture or nullptr if none is available
+     */
+    const MotionCaptureWindow* getCapture();
+
+    /**
+     * @brief Release a completed high G capture obtained from getCapture()
+     *
+     */
+    void releaseCapture();
+
+    /**
+     * @brief Enable or disable orientation estimation from the accelerometer and gyroscope
+     *
+     * While enabled the gyroscope and accelerometer run in normal mode, which draws about 1mA, and
+     * samples are read from the IMU FIFO by the service thread.  Estimation is suspended while the
+     * accelerometer rate is below the lowest gyroscope rate of 25Hz.
+     *
+     * @param enable Enable estimation
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int enableFusion(bool enable);
+
+    /**
+     * @brief Indicate if orientation estimation is enabled
+     *
+     * @return true Estimation is enabled
+     * @return false Estimation is disabled
+     */
+    bool isFusionEnabled();
+
+    /**
+     * @brief Get the latest orientation estimate
+     *
+     * @param orientation Returned orientation
+     * @retval SYSTEM_ERROR_NONE
+     * @retval SYSTEM_ERROR_INVALID_STATE No estimate is available
+     */
+    int getOrientation(MotionOrientation& orientation);
+
+    /**
+     * @brief Set no-motion detection settings used to detect the end of movement
+     *
+     * @param config No-motion detection settings
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int setNoMotionConfig(const particle::Bmi160AccelNoMotionConfig& config);
+
+    /**
+     * @brief Get no-motion detection settings used to detect the end of movement
+     *
+     * @param config Returned no-motion detection settings
+     */
+    void getNoMotionConfig(particle::Bmi160AccelNoMotionConfig& config);
+
+    /**
+     * @brief Enable or disable detection of the end of movement
+     *
+     * The no-motion interrupt is armed by a motion interrupt and disarmed once it fires so that a
+     * single MOTION_STOPPED event is reported after each movement and a parked device is not woken
+     * by it.  Motion detection must be enabled for movement to be detected.
+     *
+     * @param enable Enable detection
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int enableStopDetection(bool enable);
+
+    /**
+     * @brief Indicate if detection of the end of movement is enabled
+     *
+     * @return true Detection is enabled
+     * @return false Detection is disabled
+     */
+    bool isStopDetectionEnabled();
+
+    /**
+     * @brief Enable or disable orientation and flat detection
+     *
+     * Changes of posture are reported as MOTION_ORIENTATION events.
+     *
+     * @param enable Enable detection
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int enablePostureDetection(bool enable);
+
+    /**
+     * @brief Indicate if orientation and flat detection is enabled
+     *
+     * @return true Detection is enabled
+     * @return false Detection is disabled
+     */
+    bool isPostureDetectionEnabled();
+
+    /**
+     * @brief Get the posture reported by the last orientation or flat event
+     *
+     * @param posture Returned posture
+     * @retval SYSTEM_ERROR_NONE
+     * @retval SYSTEM_ERROR_INVALID_STATE No posture has been reported
+     */
+    int getPosture(MotionPosture& posture);
+
     /**
      * @brief Wait and take event items from queue
      *
@@ -183,6 +419,22 @@ public:
      */
     int waitOnEvent(MotionEvent& event, system_tick_t timeout);
 
+    /**
+     * @brief Take all available event items from queue without waiting
+     *
+     * @param events Returned events, oldest first
+     * @param count Maximum count of events to return
+     * @return size_t Count of events returned
+     */
+    size_t drainEvents(MotionEvent* events, size_t count);
+
+    /**
+     * @brief Record the time from a motion event to the acknowledged publish that it triggered
+     *
+     * @param eventMillis Timestamp, in milliseconds, of the triggering event
+     */
+    void recordPublishLatency(system_tick_t eventMillis);
+
     /**
      * @brief Get MotionService statistics
      *
@@ -231,11 +483,150 @@ private:
      */
     void clearAwakeFlag(uint32_t bits);
 
+    /**
+     * @brief Get motion detection settings for the given sensitivity
+     *
+     * @param mode One of LOW_SENSITIVITY, MEDIUM_SENSITIVITY, HIGH_SENSITIVITY, CUSTOM_SENSITIVITY
+     * @return const particle::Bmi160AccelMotionConfig* Settings or nullptr if the mode is not valid
+     */
+    const particle::Bmi160AccelMotionConfig* getModeConfig(MotionDetectionMode mode);
+
+    /**
+     * @brief Write accelerometer settings that differ from those in the IMU
+     *
+     * @param config Accelerometer settings
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int applyAccelerometer(const particle::Bmi160AccelerometerConfig& config);
+
+    /**
+     * @brief Write motion detection settings that differ from those in the IMU
+     *
+     * @param config Motion detection settings
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int applyMotion(const particle::Bmi160AccelMotionConfig& config);
+
+    /**
+     * @brief Write high G detection settings that differ from those in the IMU
+     *
+     * @param config High G detection settings
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int applyHighG(const particle::Bmi160AccelHighGConfig& config);
+
+    /**
+     * @brief Arm or disarm the no-motion interrupt that reports the end of movement
+     *
+     * Called from both the application and the service thread so serviceLock_ must be held.
+     *
+     * @param arm Arm the interrupt
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int armNoMotion(bool arm);
+
+    /**
+     * @brief Add an event to the queue and account for it in the statistics
+     *
+     * @param source Type of source generating the event
+     * @param interruptMicros Timestamp, in microseconds, of the interrupt or wakeup that raised the event
+     * @param activity New activity for MOTION_ACTIVITY events
+     */
+    void postEvent(MotionSource source, uint32_t interruptMicros, MotionActivity activity = MotionActivity::UNKNOWN);
+
+    /**
+     * @brief Add a sample to a latency histogram
+     *
+     * @param histogram Histogram to update
+     * @param micros Latency, in microseconds
+     */
+    static void recordLatency(MotionLatencyHistogram& histogram, uint32_t latency);
+
+    /**
+     * @brief Start collecting accelerometer samples for classification
+     *
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int startSampling();
+
+    /**
+     * @brief Stop collecting accelerometer samples for classification
+     *
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int stopSampling();
+
+    /**
+     * @brief Power the gyroscope up or down depending on whether orientation estimation needs it
+     *
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int updateFusion();
+
+    /**
+     * @brief Start or stop the IMU FIFO depending on whether sampling, capture, or fusion needs it
+     *
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int updateFifo();
+
+    /**
+     * @brief Get the period to read the IMU FIFO at so that it never overflows at the applied rate
+     *
+     * @return system_tick_t Period, in milliseconds
+     */
+    system_tick_t getSamplePeriod() const;
+
+    /**
+     * @brief Indicate if the IMU FIFO is too small to hold the capture pre-trigger window by itself
+     *
+     * @return true The FIFO must be read while armed for capture
+     * @return false The FIFO holds the pre-trigger window until a trigger
+     */
+    bool isFifoShort() const;
+
+    /**
+     * @brief Read available accelerometer samples and report classified activity changes
+     *
+     * @param interruptMicros Timestamp, in microseconds, of the interrupt or wakeup that prompted the read
+     * @retval SYSTEM_ERROR_NONE
+     */
+    int processSamples(uint32_t interruptMicros);
+
     os_thread_t thread_;
+    Mutex serviceLock_;                                     // Serializes configuration changes with the service thread
     MotionCounters counters_;
-    os_queue_t motionEventQueue_;
+    MotionEventRing eventRing_;
+    os_queue_t eventWakeQueue_;                             // Wakes waitOnEvent() when an event is added
     MotionDetectionMode mode_;
     HighGDetectionMode highGMode_;
     uint32_t awakeFlags_;
     size_t eventDepth_;
+    particle::Bmi160AccelerometerConfig accelConfig_;
+    particle::Bmi160AccelMotionConfig customMotionConfig_;
+    particle::Bmi160AccelHighGConfig highGConfig_;
+    particle::Bmi160AccelerometerConfig appliedAccel_;      // Settings last written to the IMU
+    particle::Bmi160AccelMotionConfig appliedMotion_;
+    particle::Bmi160AccelHighGConfig appliedHighG_;
+    bool appliedMotionValid_;
+    bool appliedHighGValid_;
+    MotionClassifier classifier_;
+    bool classifierEnabled_;
+    bool sampling_;
+    MotionCapture capture_;
+    bool captureEnabled_;
+    bool fifoRunning_;
+    bool fifoGyro_;
+    MotionFusion fusion_;
+    bool fusionEnabled_;
+    bool fusionRunning_;
+    Mutex orientationLock_;
+    MotionOrientation orientation_;
+    bool orientationValid_;
+    particle::Bmi160AccelNoMotionConfig noMotionConfig_;
+    bool stopDetectionEnabled_;
+    bool noMotionArmed_;
+    bool postureEnabled_;
+    MotionPosture posture_;
+    bool postureValid_;
 };
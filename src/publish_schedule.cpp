@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "publish_schedule.h"
+
+EvaluationResults PublishSchedule::evaluateIntervals(uint32_t now,
+    uint32_t lastPublishSec,
+    uint32_t monotonicPublishSec,
+    uint32_t intervalMinSec,
+    uint32_t intervalMaxSec,
+    uint32_t earlyWakeSec,
+    bool pendingTriggers) {
+
+    uint32_t interval = now - lastPublishSec;
+    uint32_t maxInterval = now - monotonicPublishSec;
+
+    bool networkNeeded = false;
+    uint32_t max = intervalMaxSec;
+    auto maxNetwork = max;
+    if  (maxNetwork > earlyWakeSec) {
+        maxNetwork -= earlyWakeSec;
+    }
+
+    if (intervalMaxSec) {
+        if (maxInterval >= maxNetwork) {
+            // max interval adjusted for early wake
+            networkNeeded = true;
+        }
+
+        if (maxInterval >= max) {
+            // max interval and past the max interval so have to publish
+            // timeout may be pre-empted when sleep enabled
+            return EvaluationResults {PublishReason::TIME, true, (maxInterval - max) < PublishScheduleLockTimeoutSec};
+        }
+    }
+
+    uint32_t min = intervalMinSec;
+    auto minNetwork = min;
+    if  (minNetwork > earlyWakeSec) {
+        minNetwork -= earlyWakeSec;
+    }
+
+    if (pendingTriggers) {
+        if (!intervalMinSec ||
+            (interval >= minNetwork)) {
+            // min interval adjusted for early wake
+            networkNeeded = true;
+        }
+
+        if (!intervalMinSec ||
+            (interval >= min)) {
+            // no min interval or past the min interval so can publish
+            // timeout may be pre-empted when sleep enabled
+            return EvaluationResults {PublishReason::TRIGGERS, true, (interval - min) < PublishScheduleLockTimeoutSec};
+        }
+    }
+
+    return EvaluationResults {PublishReason::NONE, networkNeeded, false};
+}
+
+DeferResult PublishSchedule::evaluateDeferral(uint32_t now,
+    uint32_t deferStartSec,
+    uint32_t deferMaxSec,
+    PublishReason reason,
+    bool firstPublish,
+    SignalQuality signal) {
+
+    // Only trigger publishes may wait.  Publishes past the max interval and immediate
+    // publishes go out regardless of signal, and take any held triggers with them.
+    if (reason != PublishReason::TRIGGERS) {
+        return (deferStartSec) ? DeferResult::MERGED : DeferResult::SEND;
+    }
+
+    // Only a signal known to be poor starts holding
+    if (!deferStartSec) {
+        return ((signal == SignalQuality::POOR) && deferMaxSec && !firstPublish) ? DeferResult::HOLD : DeferResult::SEND;
+    }
+
+    // and only a signal known to be good releases early, an unknown signal holds until expiry
+    if (signal == SignalQuality::GOOD) {
+        return DeferResult::IMPROVED;
+    }
+
+    return ((now - deferStartSec) < deferMaxSec) ? DeferResult::HOLD : DeferResult::EXPIRED;
+}
+
+uint32_t PublishSchedule::calculateEarlyWake(uint64_t lastWakeMs,
+    uint32_t firstLockSec,
+    uint32_t connectMs,
+    uint32_t connectingMaxSec,
+    uint32_t lastPublishSec,
+    uint32_t monotonicPublishSec) {
+
+    uint32_t newEarlyWakeSec = 0;
+    uint32_t lastWakeSec = (uint32_t)(lastWakeMs + 500) / 1000; // Round ms to s
+    if (lastWakeSec >= PublishScheduleMiscSleepWakeSec) {
+        lastWakeSec -= PublishScheduleMiscSleepWakeSec;
+    }
+    uint32_t wakeToLockDurationSec = 0;
+    int32_t publishVariance = 0;
+
+    if (firstLockSec == 0) {
+        wakeToLockDurationSec = connectingMaxSec;
+    }
+    else {
+        wakeToLockDurationSec = firstLockSec - lastWakeSec;
+    }
+
+    // A lock is no use without the network to publish it
+    uint32_t wakeToConnectDurationSec = (connectMs + 999) / 1000; // Round ms up to s
+    if (wakeToConnectDurationSec > wakeToLockDurationSec) {
+        wakeToLockDurationSec = wakeToConnectDurationSec;
+    }
+
+    publishVariance = (int32_t)lastPublishSec - (int32_t)monotonicPublishSec;
+
+    newEarlyWakeSec = wakeToLockDurationSec + publishVariance + 1;
+    if (newEarlyWakeSec > connectingMaxSec) {
+        newEarlyWakeSec = connectingMaxSec;
+    }
+
+    return newEarlyWakeSec;
+}
+
+uint32_t PublishSchedule::calculateWake(uint32_t lastPublishSec,
+    uint32_t intervalMinSec,
+    uint32_t intervalMaxSec,
+    uint32_t earlyWakeSec,
+    bool pendingTriggers) {
+
+    // Pending triggers go out after the min interval, otherwise the max interval is next
+    uint32_t wake = lastPublishSec + ((pendingTriggers) ? intervalMinSec : intervalMaxSec);
+
+    // Wake early enough to have the network and lock by then.  A wake time left in the past
+    // keeps the system awake.
+    if (wake > earlyWakeSec) {
+        wake -= earlyWakeSec;
+    }
+
+    return wake;
+}
+
+uint32_t PublishSchedule::advanceMonotonic(uint32_t now,
+    uint32_t monotonicPublishSec,
+    uint32_t intervalMaxSec,
+    bool restart) {
+
+    // Scheduled publishes keep to the max interval grid even when they go out late
+    return (restart) ? now : (monotonicPublishSec + intervalMaxSec);
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Time, in seconds, to wait past a publish interval for GNSS lock before publishing regardless
+constexpr uint32_t PublishScheduleLockTimeoutSec = 10;
+
+// Time, in seconds, spent by the system entering and exiting sleep
+constexpr uint32_t PublishScheduleMiscSleepWakeSec = 3;
+
+enum class PublishReason {
+    NONE,
+    TIME,
+    TRIGGERS,
+    IMMEDIATE,
+};
+
+struct EvaluationResults {
+    PublishReason reason;
+    bool networkNeeded;
+    bool lockWait;
+};
+
+enum class SignalQuality {
+    UNKNOWN,        // too few recent signal samples to tell
+    GOOD,
+    POOR,
+};
+
+enum class DeferResult {
+    SEND,           // publish now, it was never held
+    HOLD,           // hold the publish for better signal
+    IMPROVED,       // publish now, signal improved while held
+    EXPIRED,        // publish now, held for the longest allowed
+    MERGED,         // publish now, held triggers go out with a scheduled or immediate publish
+};
+
+/**
+ * @brief Location publish scheduling decisions.
+ *
+ * Every input is passed in, times as seconds of uptime, so that the tracker and the host
+ * simulation in test/publish_schedule_test.cpp make the same decisions.
+ */
+class PublishSchedule {
+public:
+    /**
+     * @brief Evaluate whether the min/max publish intervals call for a publish or the network
+     *
+     * @param now Present uptime, in seconds
+     * @param lastPublishSec Uptime of the last publish, in seconds
+     * @param monotonicPublishSec Uptime the max interval is counted from, in seconds
+     * @param intervalMinSec Minimum publish interval, in seconds, or 0 for none
+     * @param intervalMaxSec Maximum publish interval, in seconds, or 0 for none
+     * @param earlyWakeSec Time, in seconds, the network is needed ahead of a publish
+     * @param pendingTriggers Triggers are waiting to be published
+     * @return EvaluationResults Publish reason, and whether the network is needed and lock may be waited for
+     */
+    static EvaluationResults evaluateIntervals(uint32_t now,
+        uint32_t lastPublishSec,
+        uint32_t monotonicPublishSec,
+        uint32_t intervalMinSec,
+        uint32_t intervalMaxSec,
+        uint32_t earlyWakeSec,
+        bool pendingTriggers);
+
+    /**
+     * @brief Decide whether a publish that is ready to go should wait for better signal
+     *
+     * @param now Present uptime, in seconds
+     * @param deferStartSec Uptime the publish was first held, in seconds, or 0 if not held
+     * @param deferMaxSec Longest time, in seconds, to hold a publish, or 0 to never hold
+     * @param reason Reason for the publish
+     * @param firstPublish Publish is the first since boot
+     * @param signal Quality of the cellular signal
+     * @return DeferResult Whether to hold or send the publish
+     */
+    static DeferResult evaluateDeferral(uint32_t now,
+        uint32_t deferStartSec,
+        uint32_t deferMaxSec,
+        PublishReason reason,
+        bool firstPublish,
+        SignalQuality signal);
+
+    /**
+     * @brief Calculate how long before a publish the system must wake to have the network and lock in time
+     *
+     * The wake needs whichever of the GNSS lock and the cloud connection takes longer.
+     *
+     * @param lastWakeMs Uptime of the last wake, in milliseconds
+     * @param firstLockSec Uptime of the first GNSS lock since the wake, in seconds, or 0 if none
+     * @param connectMs Time, in milliseconds, measured from modem on to cloud connected
+     * @param connectingMaxSec Longest time, in seconds, allowed to connect
+     * @param lastPublishSec Uptime of the last publish, in seconds
+     * @param monotonicPublishSec Uptime the max interval is counted from, in seconds
+     * @return uint32_t Early wake, in seconds, bounded by the connecting time
+     */
+    static uint32_t calculateEarlyWake(uint64_t lastWakeMs,
+        uint32_t firstLockSec,
+        uint32_t connectMs,
+        uint32_t connectingMaxSec,
+        uint32_t lastPublishSec,
+        uint32_t monotonicPublishSec);
+
+    /**
+     * @brief Calculate when to wake for the next publish
+     *
+     * @param lastPublishSec Uptime of the last publish, in seconds
+     * @param intervalMinSec Minimum publish interval, in seconds, or 0 for none
+     * @param intervalMaxSec Maximum publish interval, in seconds, or 0 for none
+     * @param earlyWakeSec Time, in seconds, to wake ahead of the publish
+     * @param pendingTriggers Triggers are waiting to be published
+     * @return uint32_t Uptime to wake, in seconds
+     */
+    static uint32_t calculateWake(uint32_t lastPublishSec,
+        uint32_t intervalMinSec,
+        uint32_t intervalMaxSec,
+        uint32_t earlyWakeSec,
+        bool pendingTriggers);
+
+    /**
+     * @brief Calculate the uptime the max interval is counted from after a publish
+     *
+     * @param now Uptime of the publish, in seconds
+     * @param monotonicPublishSec Uptime the max interval was counted from, in seconds
+     * @param intervalMaxSec Maximum publish interval, in seconds
+     * @param restart Publish was not scheduled by the max interval and restarts it
+     * @return uint32_t Uptime the next max interval is counted from, in seconds
+     */
+    static uint32_t advanceMonotonic(uint32_t now,
+        uint32_t monotonicPublishSec,
+        uint32_t intervalMaxSec,
+        bool restart);
+};
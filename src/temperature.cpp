@@ -15,9 +15,15 @@
  */
 
 #include <atomic>
+#include <algorithm>
+#include <cmath>
 #include "thermistor.h"
+#include "threshold.h"
 #include "temperature.h"
+#include "temperature_log.h"
+#include "temperature_trend.h"
 #include "tracker_sleep.h"
+#include "tracker_location.h"
 
 
 // Configuration based on Panasonic ERTJ1VR104FM NTC thermistor
@@ -42,6 +48,12 @@ struct ConfigData {
   bool lowEnable;
   bool lowLatch;
   double hysteresis;
+  int32_t sampleInterval;
+  double filterTime;
+  bool logSeries;
+  double rateLimit;
+  double predictTime;
+  int32_t trendWindow;
 };
 
 
@@ -52,7 +64,13 @@ static ConfigData _temperatureConfig = {
     .lowThreshold = TemperatureLowDefault,
     .lowEnable = false,
     .lowLatch = true,
-    .hysteresis = TemperatureHysteresisDefault
+    .hysteresis = TemperatureHysteresisDefault,
+    .sampleInterval = TemperatureSampleIntervalDefault,
+    .filterTime = TemperatureFilterTimeDefault,
+    .logSeries = false,
+    .rateLimit = 0.0,
+    .predictTime = 0.0,
+    .trendWindow = TemperatureTrendWindowDefault
 };
 
 
@@ -64,17 +82,16 @@ static ConfigData _temperatureConfig = {
 //       "low": 25.0,
 //       "low_en": false
 //       "low_latch": true,
-//       "hyst": 5.0
+//       "hyst": 5.0,
+//       "sample_ms": 1000,
+//       "filter": 10.0,
+//       "series": false,
+//       "rate": 0.0,
+//       "predict": 0.0,
+//       "trend_win": 600
 //      }
 //  }
 
-enum class TempState {
-  UNKNOWN,        //< Initial state
-  NORMAL,         //< Value is not outside limit and isn't pending a pass through the hysteresis limit
-  OUTSIDE_LIMIT,  //< Value is outside of the given limit
-  INSIDE_LIMIT,   //< Value is inside of the give limit and is pending a pass through the hysteresis limit
-};
-
 enum class TempChargeState {
   UNKNOWN,                //< Initial state
   NORMAL,                 //< Value is not outside limit and isn't pending a pass through the hysteresis limit
@@ -88,13 +105,136 @@ static Thermistor _thermistor;
 static TemperatureCallback _eventCallback = nullptr;
 static unsigned int chargeEvalTick = 0;
 
-void onWake(TrackerSleepContext context) {
+// State of the filtered temperature stream
+static bool filterValid = false;
+static float filteredTemperature = 0.0f;
+static system_tick_t lastSampleMs = 0;
+
+// History of the filtered stream since the last acknowledged publish, and the part of it that is
+// waiting on an acknowledgement
+static TemperatureLog _log;
+static TemperatureLog _pendingLog;
+static bool _logPending = false;
+
+// Trend of the filtered stream, fed at a fraction of the window length so that the window always
+// spans the configured time
+static TemperatureTrend _trend;
+static uint64_t lastTrendMs = 0;
+static bool trendStarted = false;
+
+static void onWake(TrackerSleepContext context) {
   // Allow evaluation immediately after wake
   chargeEvalTick = 0;
+  // Temperature may have moved a long way while asleep so start the filter over
+  filterValid = false;
 }
 
 float get_temperature() {
-  return _thermistor.getTemperature();
+  return (filterValid) ? filteredTemperature : _thermistor.getTemperature();
+}
+
+// Take a burst of ADC readings and convert the median, which rejects single reading outliers
+static float sample_temperature() {
+  int32_t readings[TemperatureOversampleCount];
+
+  for (auto& reading : readings) {
+    reading = _thermistor.read();
+  }
+  auto median = readings + TemperatureOversampleCount / 2;
+  std::nth_element(readings, median, readings + TemperatureOversampleCount);
+
+  return _thermistor.convert(*median);
+}
+
+// Add a sample to the filtered stream when one is due, regardless of how often the loop runs.
+// Returns true when the filtered temperature was updated.
+static bool filter_temperature() {
+  auto now = millis();
+  auto elapsed = now - lastSampleMs;
+  if (filterValid && (elapsed < (system_tick_t)_temperatureConfig.sampleInterval)) {
+    return false;
+  }
+  lastSampleMs = now;
+
+  auto sample = sample_temperature();
+
+  // Pass sensor errors straight through, as before filtering, and start over on the next sample
+  if (sample == _thermistor.ThermistorError) {
+    filterValid = false;
+    filteredTemperature = sample;
+    return true;
+  }
+
+  // Only time spent sampling counts towards the history, not time asleep
+  auto dt = (filterValid) ? (elapsed / 1000.0f) : 0.0f;
+
+  if (!filterValid || (_temperatureConfig.filterTime <= 0.0)) {
+    filteredTemperature = sample;
+    filterValid = true;
+  }
+  else {
+    // First order low pass with a time constant independent of the sample interval
+    auto alpha = dt / ((float)_temperatureConfig.filterTime + dt);
+    filteredTemperature += alpha * (sample - filteredTemperature);
+  }
+
+  _log.add(filteredTemperature, dt,
+    filteredTemperature >= _temperatureConfig.highThreshold,
+    filteredTemperature <= _temperatureConfig.lowThreshold);
+
+  // Trend time keeps running through sleep so that samples on either side of it still line up
+  auto trendNow = System.millis();
+  uint64_t windowMs = (uint64_t)_temperatureConfig.trendWindow * 1000;
+  if (!trendStarted || (trendNow - lastTrendMs >= windowMs / TemperatureTrend::WINDOW_SIZE)) {
+    trendStarted = true;
+    lastTrendMs = trendNow;
+    _trend.add(trendNow, filteredTemperature, (uint32_t)windowMs);
+  }
+
+  return true;
+}
+
+static int temperature_log_pub_cb(CloudServiceStatus status, JSONValue *rsp_root, const char *req_event, const void *context) {
+  // Keep the summary and series of anything that wasn't delivered for the next publish
+  if (status != CloudServiceStatus::SUCCESS) {
+    _log.merge(_pendingLog);
+  }
+  _logPending = false;
+
+  return 0;
+}
+
+// Add the history since the last acknowledged publish to the location publish
+static void temperature_log_gen_cb(JSONWriter& writer, LocationPoint& point, const void* context) {
+  // A previous publish whose outcome will never be reported is folded back in rather than lost
+  if (_logPending) {
+    _log.merge(_pendingLog);
+  }
+
+  auto& summary = _log.getSummary();
+  if (summary.count) {
+    writer.name("temp_log").beginObject();
+    writer.name("min").value(summary.min, 1);
+    writer.name("max").value(summary.max, 1);
+    writer.name("mean").value(summary.sum / summary.count, 1);
+    writer.name("dur").value((unsigned int)summary.durationSec);
+    writer.name("above").value((unsigned int)summary.aboveSec);
+    writer.name("below").value((unsigned int)summary.belowSec);
+    if (_temperatureConfig.logSeries && _log.getSeriesSize()) {
+      writer.name("stride").value((unsigned int)_log.getSeriesStride());
+      writer.name("series").beginArray();
+      for (size_t i = 0; i < _log.getSeriesSize(); i++) {
+        writer.value(_log.getSeriesPoint(i), 1);
+      }
+      writer.endArray();
+    }
+    writer.endObject();
+  }
+
+  _pendingLog = _log;
+  _logPending = true;
+  _log.reset();
+  TrackerLocation::instance().regLocPubCallback(temperature_log_pub_cb);
 }
 
 int temperature_init(pin_t analogPin, TemperatureCallback eventCallback) {
@@ -111,6 +251,12 @@ int temperature_init(pin_t analogPin, TemperatureCallback eventCallback) {
         ConfigBool("low_en", &_temperatureConfig.lowEnable),
         ConfigBool("low_latch", &_temperatureConfig.lowLatch),
         ConfigFloat("hyst", &_temperatureConfig.hysteresis, 0.0, _thermistorConfig.maxTemperature - _thermistorConfig.minTemperature),
+        ConfigInt("sample_ms", &_temperatureConfig.sampleInterval, 10, 60000),
+        ConfigFloat("filter", &_temperatureConfig.filterTime, 0.0, 3600.0),
+        ConfigBool("series", &_temperatureConfig.logSeries),
+        ConfigFloat("rate", &_temperatureConfig.rateLimit, 0.0, 100.0),
+        ConfigFloat("predict", &_temperatureConfig.predictTime, 0.0, 1440.0),
+        ConfigInt("trend_win", &_temperatureConfig.trendWindow, 60, 86400),
       }
   );
 
@@ -118,105 +264,118 @@ int temperature_init(pin_t analogPin, TemperatureCallback eventCallback) {
 
   _eventCallback = eventCallback;
 
-  void onWake(TrackerSleepContext context);
+  TrackerSleep::instance().registerWake(onWake, "temperature");
+  TrackerLocation::instance().regLocGenCallback(temperature_log_gen_cb);
 
   return SYSTEM_ERROR_NONE;
 }
 
 // All state and variables related to high threshold evaluation
-static TempState highState = TempState::NORMAL;
+static Threshold highThreshold({"temp high", ThresholdDirection::ABOVE, TemperatureHighDefault, TemperatureHysteresisDefault, 1});
 static std::atomic<size_t> highEvents(0);
 static size_t highEventsLast = 0;
-static bool highLatch = false;
 
 size_t temperature_high_events() {
   auto eventsCapture = highEvents.load();
   auto eventsCount = eventsCapture - highEventsLast;
   highEventsLast = eventsCapture;
-  return (_temperatureConfig.highLatch) ? highLatch : eventsCount;
+  return (_temperatureConfig.highLatch) ? highThreshold.isActive() : eventsCount;
 }
 
 // All state and variables related to low threshold evaluation
-static TempState lowState = TempState::NORMAL;
+static Threshold lowThreshold({"temp low", ThresholdDirection::BELOW, TemperatureLowDefault, TemperatureHysteresisDefault, 1});
 static std::atomic<size_t> lowEvents(0);
 static size_t lowEventsLast = 0;
-static bool lowLatch = false;
 
 size_t temperature_low_events() {
   auto eventsCapture = lowEvents.load();
   auto eventsCount = eventsCapture - lowEventsLast;
   lowEventsLast = eventsCapture;
-  return (_temperatureConfig.lowLatch) ? lowLatch : eventsCount;
+  return (_temperatureConfig.lowLatch) ? lowThreshold.isActive() : eventsCount;
+}
+
+// All state and variables related to rate of change evaluation
+static std::atomic<size_t> rateEvents(0);
+static size_t rateEventsLast = 0;
+static bool rateArmed = true;
+
+size_t temperature_rate_events() {
+  auto eventsCapture = rateEvents.load();
+  auto eventsCount = eventsCapture - rateEventsLast;
+  rateEventsLast = eventsCapture;
+  return eventsCount;
+}
+
+// All state and variables related to threshold prediction
+static std::atomic<size_t> predictEvents(0);
+static size_t predictEventsLast = 0;
+static bool predictHighArmed = true;
+static bool predictLowArmed = true;
+
+size_t temperature_predict_events() {
+  auto eventsCapture = predictEvents.load();
+  auto eventsCount = eventsCapture - predictEventsLast;
+  predictEventsLast = eventsCapture;
+  return eventsCount;
+}
+
+// Evaluate whether the trend of the filtered temperature will reach a threshold within the lead time.
+// Only thresholds that are enabled and not already breached are considered, and each fires once per
+// approach.
+static void evaluate_predicted_threshold(bool enable, const Threshold& monitor, double threshold, bool& armed) {
+  if (!enable || monitor.isActive() || (_temperatureConfig.predictTime <= 0.0)) {
+    armed = true;
+    return;
+  }
+
+  auto minutes = _trend.getTimeTo(threshold);
+  bool predicted = (minutes >= 0.0f) && (minutes <= _temperatureConfig.predictTime);
+  if (predicted && armed) {
+    predictEvents++;
+    armed = false;
+  }
+  else if (!predicted) {
+    armed = true;
+  }
+}
+
+void evaluate_trend_temperature() {
+  if (!_trend.isValid()) {
+    return;
+  }
+
+  // Rate of change, in either direction, with hysteresis before rearming
+  if (_temperatureConfig.rateLimit > 0.0) {
+    auto rate = fabsf(_trend.getSlope());
+    if (rateArmed && (rate >= _temperatureConfig.rateLimit)) {
+      rateEvents++;
+      rateArmed = false;
+    }
+    else if (rate < _temperatureConfig.rateLimit * TemperatureRateRearmRatio) {
+      rateArmed = true;
+    }
+  }
+
+  evaluate_predicted_threshold(_temperatureConfig.highEnable, highThreshold, _temperatureConfig.highThreshold, predictHighArmed);
+  evaluate_predicted_threshold(_temperatureConfig.lowEnable, lowThreshold, _temperatureConfig.lowThreshold, predictLowArmed);
 }
 
 void evaluate_user_temperature(float temperature) {
+  auto now = System.millis();
+
   // Evaluate temperature against high threshold
   if (_temperatureConfig.highEnable) {
-    switch (highState) {
-      case TempState::UNKNOWN:
-        highState = TempState::NORMAL;
-        // Fall through
-      case TempState::NORMAL: {
-        if (temperature >= _temperatureConfig.highThreshold) {
-          highEvents++;
-          highLatch = true;
-          highState = TempState::OUTSIDE_LIMIT;
-        }
-        break;
-      }
-
-      case TempState::OUTSIDE_LIMIT: {
-        if (temperature < _temperatureConfig.highThreshold) {
-          highState = TempState::INSIDE_LIMIT;
-        }
-        break;
-      }
-
-      case TempState::INSIDE_LIMIT: {
-        if (temperature <= _temperatureConfig.highThreshold - _temperatureConfig.hysteresis) {
-          highLatch = false;
-          highState = TempState::NORMAL;
-        }
-        else if (temperature >= _temperatureConfig.highThreshold) {
-          highState = TempState::OUTSIDE_LIMIT;
-        }
-        break;
-      }
+    highThreshold.setLimit(_temperatureConfig.highThreshold, _temperatureConfig.hysteresis);
+    if (highThreshold.update(temperature, now) == ThresholdTransition::ENTERED) {
+      highEvents++;
     }
   }
 
   // Evaluate temperature against low threshold
   if (_temperatureConfig.lowEnable) {
-    switch (lowState) {
-      case TempState::UNKNOWN:
-        lowState = TempState::NORMAL;
-        // Fall through
-      case TempState::NORMAL: {
-        if (temperature <= _temperatureConfig.lowThreshold) {
-          lowEvents++;
-          lowLatch = true;
-          lowState = TempState::OUTSIDE_LIMIT;
-        }
-        break;
-      }
-
-      case TempState::OUTSIDE_LIMIT: {
-        if (temperature > _temperatureConfig.lowThreshold) {
-          lowState = TempState::INSIDE_LIMIT;
-        }
-        break;
-      }
-
-      case TempState::INSIDE_LIMIT: {
-        if (temperature >= _temperatureConfig.lowThreshold + _temperatureConfig.hysteresis) {
-          lowLatch = false;
-          lowState = TempState::NORMAL;
-        }
-        else if (temperature <= _temperatureConfig.lowThreshold) {
-          lowState = TempState::OUTSIDE_LIMIT;
-        }
-        break;
-      }
+    lowThreshold.setLimit(_temperatureConfig.lowThreshold, _temperatureConfig.hysteresis);
+    if (lowThreshold.update(temperature, now) == ThresholdTransition::ENTERED) {
+      lowEvents++;
     }
   }
 }
@@ -255,9 +414,15 @@ TempChargeState toChargeState(TempChargeState state) {
   return state;
 }
 
-void evaluate_charge_temperature(float temperature) {
-  static TempChargeState chargeTempState = TempChargeState::UNKNOWN;
+// State of the charge temperature evaluation
+static TempChargeState chargeTempState = TempChargeState::UNKNOWN;
+
+// Charging temperature bands, in order of precedence when more than one is active
+static Threshold chargeUnderThreshold({"charge under", ThresholdDirection::BELOW, ChargeTempLowLimit, ChargeTempHyst, 1});
+static Threshold chargeOverThreshold({"charge over", ThresholdDirection::ABOVE, ChargeTempHighLimit, ChargeTempHyst, 1});
+static Threshold chargeReducedThreshold({"charge reduced", ThresholdDirection::ABOVE, ChargeTempReducedALimit, ChargeTempHyst, 1});
 
+void evaluate_charge_temperature(float temperature) {
   unsigned int evalLoopInterval = TrackerSleep::instance().isSleepDisabled() ? ChargeTickAwakeEvalInterval : ChargeTickSleepEvalInterval;
   if (System.uptime() - chargeEvalTick < evalLoopInterval) {
     return;
@@ -265,14 +430,8 @@ void evaluate_charge_temperature(float temperature) {
 
   chargeEvalTick = System.uptime();
 
-  bool isTempHigh = (temperature >= ChargeTempHighLimit); // Inclusive
-  bool isTempBelowHighHyst = (temperature <= (ChargeTempHighLimit - ChargeTempHyst)); // Inclusive
-  bool isTempReducedA = (temperature >= ChargeTempReducedALimit); // Inclusive
-  bool isTempReducedAHyst = (temperature <= (ChargeTempReducedALimit - ChargeTempHyst)); // Inclusive
-  bool isTempLow = (temperature <= ChargeTempLowLimit); // Inclusive
-  bool isTempAboveLowHyst = (temperature >= (ChargeTempLowLimit + ChargeTempHyst)); // Inclusive
-
-  // The states are defined as follows:
+  // The bands are defined as follows, each becoming active at its limit and inactive past
+  // its hysteresis:
   //
   //    OVER_TEMPERATURE
   //  --------------------------------------------------------^ 54 degC  (ChargeTempHighLimit)
@@ -289,102 +448,57 @@ void evaluate_charge_temperature(float temperature) {
   //    UNDER_TEMPERATURE
   //
 
-  switch (chargeTempState) {
-    //
-    // Initial state at boot
-    //
-    case TempChargeState::UNKNOWN: {
-      if (isTempLow) {
-        chargeTempState = toChargeState(TempChargeState::UNDER_TEMPERATURE);
-      }
-      else if (isTempHigh) {
-        chargeTempState = toChargeState(TempChargeState::OVER_TEMPERATURE);
-      }
-      else if (isTempReducedA) {
-        chargeTempState = toChargeState(TempChargeState::OVER_CHARGE_REDUCTION);
-      }
-      else {
-        chargeTempState = toChargeState(TempChargeState::NORMAL);
-      }
-
-      break;
-    }
-
-    //
-    // No limits were breached
-    //
-    case TempChargeState::NORMAL: {
-      if (isTempLow) {
-        chargeTempState = toChargeState(TempChargeState::UNDER_TEMPERATURE);
-      }
-      else if (isTempHigh) {
-        chargeTempState = toChargeState(TempChargeState::OVER_TEMPERATURE);
-      }
-      else if (isTempReducedA) {
-        chargeTempState = toChargeState(TempChargeState::OVER_CHARGE_REDUCTION);
-      }
-
-      break;
-    }
-
-    //
-    // Under normal charging operation
-    //
-    case TempChargeState::UNDER_TEMPERATURE: {
-      if (isTempHigh) {
-        chargeTempState = toChargeState(TempChargeState::OVER_TEMPERATURE);
-      }
-      else if (isTempReducedA) {
-        chargeTempState = toChargeState(TempChargeState::OVER_CHARGE_REDUCTION);
-      }
-      else if (isTempAboveLowHyst) {
-        chargeTempState = toChargeState(TempChargeState::NORMAL);
-      }
+  auto now = System.millis();
+  chargeUnderThreshold.update(temperature, now);
+  chargeOverThreshold.update(temperature, now);
+  chargeReducedThreshold.update(temperature, now);
 
-      break;
-    }
+  auto state = TempChargeState::NORMAL;
+  if (chargeUnderThreshold.isActive()) {
+    state = TempChargeState::UNDER_TEMPERATURE;
+  }
+  else if (chargeOverThreshold.isActive()) {
+    state = TempChargeState::OVER_TEMPERATURE;
+  }
+  else if (chargeReducedThreshold.isActive()) {
+    state = TempChargeState::OVER_CHARGE_REDUCTION;
+  }
 
-    //
-    // Above normal charging operation
-    //
-    case TempChargeState::OVER_TEMPERATURE: {
-      if (isTempLow) {
-        chargeTempState = toChargeState(TempChargeState::UNDER_TEMPERATURE);
-      }
-      else if (isTempBelowHighHyst && isTempReducedA) {
-        chargeTempState = toChargeState(TempChargeState::OVER_CHARGE_REDUCTION);
-      }
-      else if (isTempReducedAHyst) {
-        chargeTempState = toChargeState(TempChargeState::NORMAL);
-      }
+  // Always report the first evaluation after boot
+  if (state != chargeTempState) {
+    chargeTempState = toChargeState(state);
+  }
+}
 
-      break;
-    }
+void temperature_save(tracker_retained_temperature_t& state) {
+  state.high_state = (uint8_t)highThreshold.getState();
+  state.low_state = (uint8_t)lowThreshold.getState();
+  state.charge_state = (uint8_t)chargeTempState;
+  state.high_latch = highThreshold.isActive();
+  state.low_latch = lowThreshold.isActive();
+}
 
-    //
-    // Above normal charging operation
-    //
-    case TempChargeState::OVER_CHARGE_REDUCTION: {
-      if (isTempHigh) {
-        chargeTempState = toChargeState(TempChargeState::OVER_TEMPERATURE);
-      }
-      else if (isTempLow) {
-        chargeTempState = toChargeState(TempChargeState::UNDER_TEMPERATURE);
-      }
-      else if (isTempReducedAHyst) {
-        chargeTempState = toChargeState(TempChargeState::NORMAL);
-      }
+void temperature_restore(const tracker_retained_temperature_t& state) {
+  // Latches follow from the threshold states
+  highThreshold.restore((ThresholdState)state.high_state);
+  lowThreshold.restore((ThresholdState)state.low_state);
 
-      break;
-    }
-  }
+  chargeTempState = (TempChargeState)state.charge_state;
+  chargeUnderThreshold.restore((chargeTempState == TempChargeState::UNDER_TEMPERATURE) ? ThresholdState::OUTSIDE_LIMIT : ThresholdState::NORMAL);
+  chargeOverThreshold.restore((chargeTempState == TempChargeState::OVER_TEMPERATURE) ? ThresholdState::OUTSIDE_LIMIT : ThresholdState::NORMAL);
+  chargeReducedThreshold.restore(((chargeTempState == TempChargeState::OVER_TEMPERATURE) || (chargeTempState == TempChargeState::OVER_CHARGE_REDUCTION)) ?
+    ThresholdState::OUTSIDE_LIMIT : ThresholdState::NORMAL);
 }
 
 int temperature_tick() {
-  float temperature = get_temperature();
+  // Threshold state machines only see the filtered stream
+  if (!filter_temperature()) {
+    return SYSTEM_ERROR_NONE;
+  }
 
-  evaluate_user_temperature(temperature);
-  evaluate_charge_temperature(temperature);
+  evaluate_user_temperature(filteredTemperature);
+  evaluate_trend_temperature();
+  evaluate_charge_temperature(filteredTemperature);
 
   return SYSTEM_ERROR_NONE;
 }
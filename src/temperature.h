@@ -19,6 +19,7 @@
 #include "Particle.h"
 #include "tracker_config.h"
 #include "config_service.h"
+#include "tracker_retained.h"
 
 enum class TemperatureChargeEvent {
   NORMAL,                 //< Normal temperature condition
@@ -51,6 +52,21 @@ constexpr double ChargeTempReducedALimit = 40.0; // degrees celsius
 // Hysteresis applied to high/low limits to re-enable battery charging
 constexpr double ChargeTempHyst = 2.0; // degrees celsius
 
+// Default interval between filtered temperature samples
+constexpr int32_t TemperatureSampleIntervalDefault = 1000; // milliseconds
+
+// Default time constant of the filter applied to temperature samples, zero to disable
+constexpr double TemperatureFilterTimeDefault = 10.0; // seconds
+
+// ADC readings taken for each temperature sample, the median is used
+constexpr size_t TemperatureOversampleCount = 5;
+
+// Default length of the window over which the temperature trend is fitted
+constexpr int32_t TemperatureTrendWindowDefault = 600; // seconds
+
+// Fraction of the rate of change limit the trend must fall below before another rate event
+constexpr double TemperatureRateRearmRatio = 0.5;
+
 // Rate, in seconds, to sample the temperature and evaluate battery charge enablement when awake
 constexpr unsigned int ChargeTickAwakeEvalInterval = 30; // seconds
 
@@ -58,7 +74,7 @@ constexpr unsigned int ChargeTickAwakeEvalInterval = 30; // seconds
 constexpr unsigned int ChargeTickSleepEvalInterval = 1; // seconds
 
 /**
- * @brief Get the current temperature
+ * @brief Get the current temperature, filtered once sampling has started
  *
  * @return float Current temperature in degrees celsius.
  */
@@ -78,6 +94,21 @@ size_t temperature_high_events();
  */
 size_t temperature_low_events();
 
+/**
+ * @brief Get the number of temperature rate of change events since last call to this function.
+ *
+ * @return size_t Number of events that have elapsed.
+ */
+size_t temperature_rate_events();
+
+/**
+ * @brief Get the number of events, since last call to this function, where the temperature trend is
+ * projected to reach the high or low threshold within the configured lead time.
+ *
+ * @return size_t Number of events that have elapsed.
+ */
+size_t temperature_predict_events();
+
 /**
  * @brief Initialize the temperature sampling feature.
  *
@@ -88,6 +119,20 @@ size_t temperature_low_events();
  */
 int temperature_init(pin_t analogPin, TemperatureCallback eventCallback);
 
+/**
+ * @brief Save the temperature state machines to the retained snapshot.
+ *
+ * @param [out] state         Retained temperature section.
+ */
+void temperature_save(tracker_retained_temperature_t& state);
+
+/**
+ * @brief Resume the temperature state machines from the retained snapshot.
+ *
+ * @param [in]  state         Retained temperature section.
+ */
+void temperature_restore(const tracker_retained_temperature_t& state);
+
 /**
  * @brief Process the temperature loop tick.
  *
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "temperature_log.h"
+
+TemperatureLog::TemperatureLog() {
+    reset();
+}
+
+void TemperatureLog::reset() {
+    summary_ = {
+        .min = 0.0f,
+        .max = 0.0f,
+        .sum = 0.0f,
+        .count = 0,
+        .durationSec = 0.0f,
+        .aboveSec = 0.0f,
+        .belowSec = 0.0f,
+    };
+    for (auto& point : series_) {
+        point = {0.0f, 0};
+    }
+    seriesCount_ = 0;
+    stride_ = 1;
+}
+
+void TemperatureLog::add(float temperature, float elapsedSec, bool above, bool below) {
+    if (!summary_.count || (temperature < summary_.min)) {
+        summary_.min = temperature;
+    }
+    if (!summary_.count || (temperature > summary_.max)) {
+        summary_.max = temperature;
+    }
+    summary_.sum += temperature;
+    summary_.count++;
+
+    // The time since the previous sample is credited to this one.  The first sample of a period
+    // has nothing before it to cover.
+    if (summary_.count > 1) {
+        summary_.durationSec += elapsedSec;
+        if (above) {
+            summary_.aboveSec += elapsedSec;
+        }
+        if (below) {
+            summary_.belowSec += elapsedSec;
+        }
+    }
+
+    // Start a new point once the current one covers a full stride
+    if (!seriesCount_ || (series_[seriesCount_ - 1].count >= stride_)) {
+        if (seriesCount_ >= SERIES_SIZE) {
+            // Halve the resolution to make room, the remaining points cover twice the samples
+            for (size_t i = 0; i < SERIES_SIZE / 2; i++) {
+                series_[i].sum = series_[2 * i].sum + series_[2 * i + 1].sum;
+                series_[i].count = series_[2 * i].count + series_[2 * i + 1].count;
+            }
+            seriesCount_ = SERIES_SIZE / 2;
+            stride_ *= 2;
+        }
+        if (!seriesCount_ || (series_[seriesCount_ - 1].count >= stride_)) {
+            series_[seriesCount_++] = {0.0f, 0};
+        }
+    }
+
+    auto& point = series_[seriesCount_ - 1];
+    point.sum += temperature;
+    point.count++;
+}
+
+void TemperatureLog::merge(const TemperatureLog& other) {
+    auto& older = other.summary_;
+    if (!older.count) {
+        return;
+    }
+
+    if (!summary_.count || (older.min < summary_.min)) {
+        summary_.min = older.min;
+    }
+    if (!summary_.count || (older.max > summary_.max)) {
+        summary_.max = older.max;
+    }
+    summary_.sum += older.sum;
+    summary_.count += older.count;
+    summary_.durationSec += older.durationSec;
+    summary_.aboveSec += older.aboveSec;
+    summary_.belowSec += older.belowSec;
+
+    // Bring both series to the coarser stride, oldest first, then halve the resolution until
+    // the points fit
+    Point merged[2 * SERIES_SIZE];
+    auto stride = (other.stride_ > stride_) ? other.stride_ : stride_;
+    size_t count = other.appendSeries(merged, 0, stride);
+    count = appendSeries(merged, count, stride);
+
+    while (count > SERIES_SIZE) {
+        for (size_t i = 0; i < count / 2; i++) {
+            merged[i].sum = merged[2 * i].sum + merged[2 * i + 1].sum;
+            merged[i].count = merged[2 * i].count + merged[2 * i + 1].count;
+        }
+        if (count % 2) {
+            merged[count / 2] = merged[count - 1];
+        }
+        count = (count + 1) / 2;
+        stride *= 2;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        series_[i] = merged[i];
+    }
+    seriesCount_ = count;
+    stride_ = stride;
+}
+
+size_t TemperatureLog::appendSeries(Point* points, size_t count, uint32_t stride) const {
+    // Strides are powers of two so a coarser stride combines whole groups of points
+    auto group = stride / stride_;
+    for (size_t i = 0; i < seriesCount_; i++) {
+        if (i % group == 0) {
+            points[count++] = {0.0f, 0};
+        }
+        points[count - 1].sum += series_[i].sum;
+        points[count - 1].count += series_[i].count;
+    }
+
+    return count;
+}
+
+const TemperatureSummary& TemperatureLog::getSummary() const {
+    return summary_;
+}
+
+size_t TemperatureLog::getSeriesSize() const {
+    return seriesCount_;
+}
+
+float TemperatureLog::getSeriesPoint(size_t index) const {
+    auto& point = series_[index];
+    return (point.count) ? (point.sum / point.count) : 0.0f;
+}
+
+uint32_t TemperatureLog::getSeriesStride() const {
+    return stride_;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Summary of the temperature samples logged over a period.
+ *
+ */
+struct TemperatureSummary {
+    float min;                      /**< Lowest sample, in degrees Celsius */
+    float max;                      /**< Highest sample, in degrees Celsius */
+    float sum;                      /**< Sum of samples, in degrees Celsius, for the mean */
+    uint32_t count;                 /**< Count of samples */
+    float durationSec;              /**< Time covered by the samples, in seconds */
+    float aboveSec;                 /**< Time at or above the high threshold, in seconds */
+    float belowSec;                 /**< Time at or below the low threshold, in seconds */
+};
+
+/**
+ * @brief Fixed memory log of temperature samples between publishes.
+ *
+ * Keeps a running summary and, optionally, a downsampled series.  The series has a fixed number of
+ * points; once they are all used adjacent points are averaged together and each point then covers
+ * twice as many samples, so the series always spans the whole period.
+ */
+class TemperatureLog {
+public:
+    static constexpr size_t SERIES_SIZE = 16;
+
+    TemperatureLog();
+
+    /**
+     * @brief Discard all samples
+     *
+     */
+    void reset();
+
+    /**
+     * @brief Add one sample
+     *
+     * @param temperature Sample, in degrees Celsius
+     * @param elapsedSec Time, in seconds, since the previous sample
+     * @param above Sample is at or above the high threshold
+     * @param below Sample is at or below the low threshold
+     */
+    void add(float temperature, float elapsedSec, bool above, bool below);
+
+    /**
+     * @brief Fold another log, covering an earlier period, into this one
+     *
+     * The series of the other log is placed ahead of this one at the coarser of the two strides,
+     * then the resolution is halved as needed to fit.
+     *
+     * @param other Log to merge
+     */
+    void merge(const TemperatureLog& other);
+
+    /**
+     * @brief Get the summary of the logged samples
+     *
+     * @return const TemperatureSummary& Summary
+     */
+    const TemperatureSummary& getSummary() const;
+
+    /**
+     * @brief Get the count of points in the series
+     *
+     * @return size_t Count of points
+     */
+    size_t getSeriesSize() const;
+
+    /**
+     * @brief Get a point of the series, oldest first
+     *
+     * @param index Index of the point, less than getSeriesSize()
+     * @return float Mean of the samples covered by the point, in degrees Celsius
+     */
+    float getSeriesPoint(size_t index) const;
+
+    /**
+     * @brief Get the count of samples covered by each point in the series
+     *
+     * @return uint32_t Samples per point
+     */
+    uint32_t getSeriesStride() const;
+
+private:
+    struct Point {
+        float sum;
+        uint32_t count;
+    };
+
+    size_t appendSeries(Point* points, size_t count, uint32_t stride) const;
+
+    TemperatureSummary summary_;
+    Point series_[SERIES_SIZE];
+    size_t seriesCount_;
+    uint32_t stride_;
+};
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "temperature_trend.h"
+
+TemperatureTrend::TemperatureTrend() {
+    reset();
+}
+
+void TemperatureTrend::reset() {
+    head_ = 0;
+    count_ = 0;
+    sumT_ = 0.0;
+    sumY_ = 0.0;
+    sumTT_ = 0.0;
+    sumTY_ = 0.0;
+}
+
+void TemperatureTrend::remove() {
+    auto& oldest = samples_[(head_ + WINDOW_SIZE - count_) % WINDOW_SIZE];
+    auto& newest = samples_[(head_ + WINDOW_SIZE - 1) % WINDOW_SIZE];
+    double t = -(double)(newest.timeMs - oldest.timeMs) / 1000.0;
+
+    sumT_ -= t;
+    sumY_ -= oldest.temperature;
+    sumTT_ -= t * t;
+    sumTY_ -= t * oldest.temperature;
+    count_--;
+}
+
+void TemperatureTrend::add(uint64_t timeMs, float temperature, uint32_t windowMs) {
+    // Move the time origin to the new sample, t' = t - shift, before adding it at t' = 0
+    if (count_) {
+        auto& newest = samples_[(head_ + WINDOW_SIZE - 1) % WINDOW_SIZE];
+        double shift = (double)(timeMs - newest.timeMs) / 1000.0;
+        sumTT_ += -2.0 * shift * sumT_ + count_ * shift * shift;
+        sumTY_ -= shift * sumY_;
+        sumT_ -= count_ * shift;
+    }
+
+    if (count_ >= WINDOW_SIZE) {
+        // The new sample takes the slot of the oldest, which is measured from the new origin
+        auto& oldest = samples_[head_];
+        double t = -(double)(timeMs - oldest.timeMs) / 1000.0;
+        sumT_ -= t;
+        sumY_ -= oldest.temperature;
+        sumTT_ -= t * t;
+        sumTY_ -= t * oldest.temperature;
+        count_--;
+    }
+
+    samples_[head_] = {timeMs, temperature};
+    head_ = (head_ + 1) % WINDOW_SIZE;
+    count_++;
+    sumY_ += temperature;
+
+    while ((count_ > 1) &&
+        (timeMs - samples_[(head_ + WINDOW_SIZE - count_) % WINDOW_SIZE].timeMs > windowMs)) {
+        remove();
+    }
+}
+
+bool TemperatureTrend::isValid() const {
+    return (count_ >= MIN_POINTS);
+}
+
+float TemperatureTrend::getSlope() const {
+    double denominator = count_ * sumTT_ - sumT_ * sumT_;
+    if (count_ < 2 || denominator <= 0.0) {
+        return 0.0f;
+    }
+
+    return (float)((count_ * sumTY_ - sumT_ * sumY_) / denominator * 60.0);
+}
+
+float TemperatureTrend::getValue() const {
+    if (!count_) {
+        return 0.0f;
+    }
+
+    // Intercept at t = 0, the newest sample
+    double slope = getSlope() / 60.0;
+    return (float)((sumY_ - slope * sumT_) / count_);
+}
+
+float TemperatureTrend::getTimeTo(float threshold) const {
+    auto slope = getSlope();
+    if (slope == 0.0f) {
+        return -1.0f;
+    }
+
+    return (threshold - getValue()) / slope;
+}
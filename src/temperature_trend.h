@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Particle.h"
+
+/**
+ * @brief Least squares trend of temperature over a sliding window of time.
+ *
+ * Regression sums are updated as samples enter and leave the window so that each sample costs the
+ * same regardless of window size.  Times are kept relative to the newest sample so that the sums stay
+ * small however long the device runs, which also makes the intercept the trend value at the newest
+ * sample.
+ */
+class TemperatureTrend {
+public:
+    static constexpr size_t WINDOW_SIZE = 32;
+
+    // Points needed before the trend is reported
+    static constexpr size_t MIN_POINTS = 8;
+
+    TemperatureTrend();
+
+    /**
+     * @brief Discard all samples
+     *
+     */
+    void reset();
+
+    /**
+     * @brief Add a sample and drop samples older than the window
+     *
+     * @param timeMs Time of the sample, in milliseconds of System.millis()
+     * @param temperature Sample, in degrees Celsius
+     * @param windowMs Length of the window, in milliseconds
+     */
+    void add(uint64_t timeMs, float temperature, uint32_t windowMs);
+
+    /**
+     * @brief Indicate if enough samples are in the window to report a trend
+     *
+     * @return true Trend is valid
+     * @return false Not enough samples
+     */
+    bool isValid() const;
+
+    /**
+     * @brief Get the slope of the trend
+     *
+     * @return float Rate of change, in degrees Celsius per minute
+     */
+    float getSlope() const;
+
+    /**
+     * @brief Get the value of the trend at the newest sample
+     *
+     * @return float Temperature, in degrees Celsius
+     */
+    float getValue() const;
+
+    /**
+     * @brief Project the time until the trend reaches a threshold
+     *
+     * @param threshold Temperature, in degrees Celsius
+     * @return float Minutes until the threshold is reached, or a negative value if the trend is
+     * not heading towards it
+     */
+    float getTimeTo(float threshold) const;
+
+private:
+    struct Sample {
+        uint64_t timeMs;
+        float temperature;
+    };
+
+    void remove();
+
+    Sample samples_[WINDOW_SIZE];
+    size_t head_;
+    size_t count_;
+    double sumT_;
+    double sumY_;
+    double sumTT_;
+    double sumTY_;
+};
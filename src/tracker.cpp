@@ -30,7 +30,11 @@ constexpr int TrackerLowBatteryWarningHyst = 1; // percent of battery charge
 constexpr unsigned int TrackerLowBatteryAwakeEvalInterval = 15 * 60; // seconds to sample for low battery condition
 constexpr unsigned int TrackerLowBatterySleepEvalInterval = 1; // seconds to sample for low battery condition
 constexpr unsigned int TrackerLowBatterySleepWakeInterval = 15 * 60; // seconds to sample for low battery condition
+constexpr unsigned int TrackerLowBatterySleepWakeTolerance = 5 * 60; // seconds the low battery sample may be delayed to share a wake
 constexpr system_tick_t TrackerPostChargeSettleTime = 500; // milliseconds
+constexpr system_tick_t TrackerQuickStartTime = 200; // milliseconds after a fuel gauge quickstart before readings are updated
+constexpr system_tick_t TrackerAlertClearTime = 100; // milliseconds after clearing the fuel gauge alert
+constexpr unsigned int TrackerLowBatteryLookahead = TrackerLowBatterySleepWakeInterval + TrackerLowBatterySleepWakeTolerance; // seconds until the next low battery sample at the latest
 constexpr unsigned int TrackerLowBatteryStartTime = 20; // seconds to debounce low battery condition
 constexpr unsigned int TrackerLowBatteryDebounceTime = 5; // seconds to debounce low battery condition
 constexpr unsigned int TrackerChargingAwakeEvalTime = 10; // seconds to sample the PMIC charging state
@@ -70,16 +74,22 @@ Tracker::Tracker() :
     location(TrackerLocation::instance()),
     motion(TrackerMotion::instance()),
     shipping(TrackerShipping::instance()),
+    energy(TrackerEnergy::instance()),
+    power(TrackerPower::instance()),
+    snapshot(TrackerRetained::instance()),
     rgb(TrackerRGB::instance()),
     _model(TRACKER_MODEL_BARE_SOM),
     _variant(0),
     _lastLoopSec(0),
     _canPowerEnabled(false),
-    _pastWarnLimit(false),
+    _batteryWarning({"battery warning", ThresholdDirection::BELOW, TrackerLowBatteryWarning, TrackerLowBatteryWarningHyst, 1}),
     _evalTick(0),
+    _batterySampleSec(0),
     _lastBatteryCharging(false),
-    _delayedBatteryCheck(true),
-    _delayedBatteryCheckTick(0),
+    _batteryInitState(TrackerBatteryInitState::START_DELAY),
+    _batteryInitMs(0),
+    _chargeEventPending(false),
+    _pendingChargeEvent(TemperatureChargeEvent::NORMAL),
     _pendingChargeStatus{.uptime = 0, .state = TrackerChargeState::CHARGE_INIT},
     _chargeStatus(TrackerChargeState::CHARGE_INIT),
     _lowBatteryEvent(0),
@@ -312,8 +322,18 @@ void Tracker::batteryStateHandler(system_event_t event, int data) {
 }
 
 
-void Tracker::initBatteryMonitor() {
+void Tracker::initBatteryMonitor(bool warmBoot) {
     auto powerConfig = System.getPowerConfiguration();
+
+    // Keep a handy variable to check on battery charge enablement
+    _batteryChargeEnabled = !powerConfig.isFeatureSet(SystemPowerFeature::DISABLE_CHARGING);
+
+    // The charger and fuel gauge keep running through a reset, along with the charge current
+    // last chosen from temperature, so only a cold boot needs them initialized
+    if (warmBoot) {
+        return;
+    }
+
     // Start battery charging at low current state from boot then increase if necessary
     if ((powerConfig.batteryChargeCurrent() != TrackerChargeCurrentLow) ||
         (powerConfig.powerSourceMaxCurrent() != TrackerInputCurrent)) {
@@ -323,44 +343,67 @@ void Tracker::initBatteryMonitor() {
         System.setPowerConfiguration(powerConfig);
     }
 
-    // Keep a handy variable to check on battery charge enablement
-    _batteryChargeEnabled = !powerConfig.isFeatureSet(SystemPowerFeature::DISABLE_CHARGING);
-
     // To initialize the fuel gauge so that it provides semi-accurate readings we
     // want to ensure that the charging circuit is off when providing the
     // fuel gauge quick start command.
     // In order to disable charging safely we want to enable the PMIC watchdog so that
     // if anything happens during the procedure that the circuit can return to
     // normal operation in the event the MCU doesn't complete.
+    // The rest of the procedure is stepped through from the loop so that boot isn't held up.
     PMIC pmic(true);
-    FuelGauge fuelGauge;
 
     pmic.setWatchdog(0x1); // 40 seconds
     pmic.disableCharging();
-    // Delay so that the bulk capacitance and battery can equalize
-    delay(TrackerPostChargeSettleTime);
+    _batteryInitMs = millis();
+    _batteryInitState = TrackerBatteryInitState::SETTLE;
+}
+
+void Tracker::loopBatteryInit() {
+    switch (_batteryInitState) {
+        case TrackerBatteryInitState::SETTLE: {
+            // Wait so that the bulk capacitance and battery can equalize
+            if (millis() - _batteryInitMs < TrackerPostChargeSettleTime) {
+                break;
+            }
 
-    fuelGauge.quickStart();
-    // Must delay at least 175ms after quickstart, before calling
-    // getSoC(), or reading will not have updated yet.
-    delay(200);
+            FuelGauge fuelGauge;
+            fuelGauge.quickStart();
+            _batteryInitMs = millis();
+            _batteryInitState = TrackerBatteryInitState::QUICKSTART;
+            break;
+        }
 
-    if (_batteryChargeEnabled) {
-        pmic.enableCharging();
-    }
-    pmic.disableWatchdog();
-}
+        case TrackerBatteryInitState::QUICKSTART: {
+            // Must wait at least 175ms after quickstart, before calling
+            // getSoC(), or reading will not have updated yet.
+            if (millis() - _batteryInitMs < TrackerQuickStartTime) {
+                break;
+            }
 
-bool Tracker::getChargeEnabled() {
-    return !System.getPowerConfiguration().isFeatureSet(SystemPowerFeature::DISABLE_CHARGING);
-}
+            _batteryInitState = TrackerBatteryInitState::START_DELAY;
+
+            // Apply any charge temperature decision held back while charging had to stay off
+            if (_chargeEventPending) {
+                _chargeEventPending = false;
+                chargeCallback(_pendingChargeEvent);
+            }
+
+            PMIC pmic(true);
+            if (_batteryChargeEnabled) {
+                pmic.enableCharging();
+            }
+            pmic.disableWatchdog();
+            break;
+        }
+
+        case TrackerBatteryInitState::START_DELAY: {
+            // This is delayed intialization for the fuel gauge threshold since power on
+            // events may glitch between battery states easily.
+            // Power on glitches are not a concern when resuming after a reset.
+            if ((System.uptime() < TrackerLowBatteryStartTime) && !snapshot.isRestored()) {
+                break;
+            }
 
-void Tracker::evaluateBatteryCharge() {
-    // This is delayed intialization for the fuel gauge threshold since power on
-    // events may glitch between battery states easily.
-    if (_delayedBatteryCheck) {
-        if (System.uptime() >= TrackerLowBatteryStartTime) {
-            _delayedBatteryCheck = false;
             FuelGauge fuelGauge;
 
             // Set the alert level for <SET VALUE> - 1%.  This value will not be normalized but rather the raw
@@ -369,7 +412,15 @@ void Tracker::evaluateBatteryCharge() {
             // succesive charge amounts.  It is important to check whether we are already below this limit
             fuelGauge.setAlertThreshold((uint8_t)(TrackerLowBatteryCutoff - TrackerLowBatteryCutoffCorrection));
             fuelGauge.clearAlert();
-            delay(100);
+            _batteryInitMs = millis();
+            _batteryInitState = TrackerBatteryInitState::ALERT_CLEAR;
+            break;
+        }
+
+        case TrackerBatteryInitState::ALERT_CLEAR: {
+            if (millis() - _batteryInitMs < TrackerAlertClearTime) {
+                break;
+            }
 
             // NOTE: This is a workaround in case the fuel gauge interrupt is not configured as an input
             pinMode(LOW_BAT_UC, INPUT_PULLUP);
@@ -379,8 +430,22 @@ void Tracker::evaluateBatteryCharge() {
             if (_chargeStatus == TrackerChargeState::CHARGE_INIT) {
                 setPendingChargeStatus(System.uptime(), batteryDecode(static_cast<battery_state_t>(System.batteryState())));
             }
+            _batteryInitState = TrackerBatteryInitState::DONE;
+            break;
         }
+
+        case TrackerBatteryInitState::DONE:
+            break;
     }
+}
+
+bool Tracker::getChargeEnabled() {
+    return !System.getPowerConfiguration().isFeatureSet(SystemPowerFeature::DISABLE_CHARGING);
+}
+
+void Tracker::evaluateBatteryCharge() {
+    // Step through fuel gauge and charger initialization without blocking the loop
+    loopBatteryInit();
 
     // Debounce the charge status here by looking at data collected by the interrupt handler and making sure that the
     // last state is present over a qualified amount of time.
@@ -393,13 +458,14 @@ void Tracker::evaluateBatteryCharge() {
 
     // No further work necessary if we are still in the delayed battery check interval or not on a evaluation interval
     unsigned int evalLoopInterval = sleep.isSleepDisabled() ? TrackerLowBatteryAwakeEvalInterval : TrackerLowBatterySleepEvalInterval;
-    if (_delayedBatteryCheck ||
+    if ((_batteryInitState != TrackerBatteryInitState::DONE) ||
         (System.uptime() - _evalTick < evalLoopInterval)) {
 
         return;
     }
 
     _evalTick = System.uptime();
+    _batterySampleSec = _evalTick;
 
     auto stateOfCharge = System.batteryCharge();
 
@@ -409,6 +475,22 @@ void Tracker::evaluateBatteryCharge() {
         return;
     }
 
+    // Sensor errors are reported below absolute zero
+    auto temperature = get_temperature();
+    if (temperature < -273.15f) {
+        temperature = NAN;
+    }
+    bool charging = (_chargeStatus == TrackerChargeState::CHARGE_DONT_CARE);
+    energy.updateBattery(stateOfCharge, temperature, charging);
+    auto &battery = energy.getBattery();
+
+    // Degrade the duty cycle well before shipping mode becomes necessary
+    power.update(battery.getCharge(), charging);
+
+    // Charge expected by the next sample, so that shipping mode is entered while there is still
+    // enough left to publish and shut down cleanly
+    auto projectedCharge = battery.project((float)TrackerLowBatteryLookahead / 3600.0f);
+
     switch (_chargeStatus) {
         case TrackerChargeState::CHARGE_CARE: {
             if (_lowBatteryEvent || (stateOfCharge <= (float)TrackerLowBatteryCutoff)) {
@@ -416,12 +498,16 @@ void Tracker::evaluateBatteryCharge() {
                 Log.error("Battery charge of %0.1f%% is less than limit of %0.1f%%.  Entering shipping mode", stateOfCharge, (float)TrackerLowBatteryCutoff);
                 startLowBatteryShippingMode();
             }
-            else if (!_pastWarnLimit && (stateOfCharge <= (float)TrackerLowBatteryWarning)) {
-                _pastWarnLimit = true;
+            else if (projectedCharge <= (float)TrackerLowBatteryCutoff) {
+                Log.error("Battery charge of %0.1f%% is projected to reach limit of %0.1f%% before next check.  Entering shipping mode", battery.getCharge(), (float)TrackerLowBatteryCutoff);
+                startLowBatteryShippingMode();
+            }
+            // Only enter the warning while discharging
+            else if (!_batteryWarning.isActive() && (_batteryWarning.update(battery.getCharge()) == ThresholdTransition::ENTERED)) {
                 // Publish once when falling through this value
-                Particle.publishVitals();
+                energy.publishVitals();
                 location.triggerLocPub(Trigger::IMMEDIATE,"batt_warn");
-                Log.warn("Battery charge of %0.1f%% is less than limit of %0.1f%%.  Publishing warning", stateOfCharge, (float)TrackerLowBatteryWarning);
+                Log.warn("Battery charge of %0.1f%% is less than limit of %0.1f%%.  Publishing warning", battery.getCharge(), (float)TrackerLowBatteryWarning);
             }
             break;
         }
@@ -433,10 +519,10 @@ void Tracker::evaluateBatteryCharge() {
                 Log.error("Battery charge of %0.1f%% is less than limit of %0.1f%%.  Entering shipping mode", stateOfCharge, (float)TrackerLowBatteryCutoff);
                 startLowBatteryShippingMode();
             }
-            else if (_pastWarnLimit && (stateOfCharge >= (float)(TrackerLowBatteryWarning + TrackerLowBatteryWarningHyst))) {
-                _pastWarnLimit = false;
+            // Only leave the warning while charging
+            else if (_batteryWarning.isActive() && (_batteryWarning.update(battery.getCharge()) == ThresholdTransition::EXITED)) {
                 // Publish again to announce that we are out of low battery warning
-                Particle.publishVitals();
+                energy.publishVitals();
             }
         }
     }
@@ -446,12 +532,19 @@ void Tracker::onSleepPrepare(TrackerSleepContext context)
 {
     configService.flush();
     if (_model == TRACKER_MODEL_TRACKERONE) {
-        TrackerSleep::instance().wakeAtSeconds(System.uptime() + TrackerLowBatterySleepWakeInterval);
+        // Anchor to the last sample since brief wakes skip the evaluation and would otherwise keep
+        // pushing it out.  An overdue sample takes the next wake.
+        unsigned int now = System.uptime();
+        auto wake = std::max(_batterySampleSec + TrackerLowBatterySleepWakeInterval, now + 1);
+        auto latest = std::max(_batterySampleSec + TrackerLowBatterySleepWakeInterval + TrackerLowBatterySleepWakeTolerance, now + 1);
+        TrackerSleep::instance().wakeWithinSeconds("battery", wake, latest);
     }
 }
 
 void Tracker::onSleep(TrackerSleepContext context)
 {
+    saveRetained();
+
     if (_model == TRACKER_MODEL_TRACKERONE) {
         GnssLedEnable(false);
     }
@@ -473,6 +566,35 @@ void Tracker::onSleepStateChange(TrackerSleepContext context)
     }
 }
 
+void Tracker::saveRetained()
+{
+    auto &data = snapshot.data();
+
+    sleep.saveRetained(data.sleep);
+    location.saveRetained(data.location);
+    if (_model == TRACKER_MODEL_TRACKERONE)
+    {
+        temperature_save(data.temperature);
+        data.battery.charge_status = (uint8_t)_chargeStatus;
+        data.battery.past_warn_limit = _batteryWarning.isActive();
+    }
+    snapshot.save();
+}
+
+void Tracker::restoreRetained()
+{
+    auto &data = snapshot.data();
+
+    sleep.restoreRetained(data.sleep);
+    location.restoreRetained(data.location);
+    if (_model == TRACKER_MODEL_TRACKERONE)
+    {
+        temperature_restore(data.temperature);
+        _chargeStatus = (TrackerChargeState)data.battery.charge_status;
+        _batteryWarning.restore((data.battery.past_warn_limit) ? ThresholdState::OUTSIDE_LIMIT : ThresholdState::NORMAL);
+    }
+}
+
 void Tracker::completeSetupDone()
 {
     // mark setup as complete to skip mobile app commissioning flow
@@ -486,6 +608,9 @@ void Tracker::completeSetupDone()
 
 void Tracker::startup()
 {
+    // Needed to tell a warm reset from a power on
+    System.enableFeature(FEATURE_RESET_INFO);
+
     completeSetupDone();
 
     // Correct power manager states in the DCT
@@ -498,6 +623,15 @@ int Tracker::init()
 
     _lastLoopSec = System.uptime();
 
+    // Thresholds keep time and log through the system
+    Threshold::setClock([]() { return System.millis(); });
+    Threshold::setLogger([](const char* name, ThresholdTransition transition, float value) {
+        Log.trace("%s threshold %s at %.2f", name, (transition == ThresholdTransition::ENTERED) ? "entered" : "exited", value);
+    });
+
+    // Determine early whether this is a reset that can resume from the retained snapshot
+    auto warmBoot = snapshot.restore();
+
 #ifndef TRACKER_MODEL_NUMBER
     ret = hal_get_device_hw_model(&_model, &_variant, nullptr);
     if (ret)
@@ -524,7 +658,7 @@ int Tracker::init()
     if (_model == TRACKER_MODEL_TRACKERONE)
     {
         BLE.selectAntenna(BleAntennaType::EXTERNAL);
-        initBatteryMonitor();
+        initBatteryMonitor(warmBoot);
     }
 
     cloudService.init();
@@ -532,10 +666,10 @@ int Tracker::init()
     configService.init();
 
     sleep.init([this](bool enable){ this->enableWatchdog(enable); });
-    sleep.registerSleepPrepare([this](TrackerSleepContext context){ this->onSleepPrepare(context); });
-    sleep.registerSleep([this](TrackerSleepContext context){ this->onSleep(context); });
-    sleep.registerWake([this](TrackerSleepContext context){ this->onWake(context); });
-    sleep.registerStateChange([this](TrackerSleepContext context){ this->onSleepStateChange(context); });
+    sleep.registerSleepPrepare([this](TrackerSleepContext context){ this->onSleepPrepare(context); }, "tracker");
+    sleep.registerSleep([this](TrackerSleepContext context){ this->onSleep(context); }, "tracker");
+    sleep.registerWake([this](TrackerSleepContext context){ this->onWake(context); }, "tracker");
+    sleep.registerStateChange([this](TrackerSleepContext context){ this->onSleepStateChange(context); }, "tracker");
 
     // Register our own configuration settings
     registerConfig();
@@ -567,6 +701,10 @@ int Tracker::init()
 
     motion.init();
 
+    energy.init();
+
+    power.init();
+
     shipping.init();
     shipping.regShutdownBeginCallback(std::bind(&Tracker::stop, this));
     shipping.regShutdownIoCallback(std::bind(&Tracker::end, this));
@@ -578,6 +716,12 @@ int Tracker::init()
 
     rgb.init();
 
+    // Resume where the previous boot left off, all services must be initialized beforehand
+    if (warmBoot)
+    {
+        restoreRetained();
+    }
+
     rtc.begin();
     enableWatchdog(true);
 
@@ -588,6 +732,16 @@ int Tracker::init()
 
 void Tracker::loop()
 {
+    // Wakes caused only by the IMU interrupt handle the motion event and go back to sleep unless
+    // it warrants a publish, everything else waits for the next full wake
+    if (sleep.isBriefWake())
+    {
+        motion.loop();
+        location.evaluateNetwork();
+        sleep.loop();
+        return;
+    }
+
     uint32_t cur_sec = System.uptime();
 
     // slow operations for once a second
@@ -595,6 +749,8 @@ void Tracker::loop()
     {
         _lastLoopSec = cur_sec;
 
+        saveRetained();
+
 #ifndef RTC_WDT_DISABLE
         rtc.reset_wdt();
 #endif
@@ -606,6 +762,13 @@ void Tracker::loop()
         evaluateBatteryCharge();
     }
 
+    // Hold the modem, which the sleep state machine starts on boot, and everything depending on it
+    // until the fuel gauge quickstart has read the battery unloaded
+    if (isBatteryQuickStartPending())
+    {
+        return;
+    }
+
     // fast operations for every loop
     sleep.loop();
     motion.loop();
@@ -624,6 +787,17 @@ void Tracker::loop()
         {
             location.triggerLocPub(Trigger::NORMAL,"temp_l");
         }
+
+        if (temperature_rate_events())
+        {
+            location.triggerLocPub(Trigger::NORMAL,"temp_r");
+        }
+
+        // Publish ahead of a threshold excursion without waiting out the minimum interval
+        if (temperature_predict_events())
+        {
+            location.triggerLocPub(Trigger::IMMEDIATE,"temp_p");
+        }
     }
 
 
@@ -682,6 +856,13 @@ int Tracker::setChargeCurrent(uint16_t current) {
 }
 
 int Tracker::chargeCallback(TemperatureChargeEvent event) {
+    // Charging must stay off until the fuel gauge quickstart completes, keep the latest decision for then
+    if (isBatteryQuickStartPending()) {
+        _pendingChargeEvent = event;
+        _chargeEventPending = true;
+        return SYSTEM_ERROR_NONE;
+    }
+
     auto shouldCharge = true;
 
     switch (event) {
@@ -730,11 +911,12 @@ void Tracker::loc_gen_cb(JSONWriter& writer, LocationPoint &loc, const void *con
         return;
     }
 
-    // add cellular signal strength if available
-    CellularSignal signal;
-    if(!TrackerCellular::instance().getSignal(signal))
+    // add cellular signal strength if available, averaged over recent samples
+    TrackerCellularStats signal;
+    if(!TrackerCellular::instance().getSignalStats(signal))
     {
-        writer.name("cell").value(signal.getStrength(), 1);
+        writer.name("cell").value(signal.strength_avg, 1);
+        writer.name("cell_min").value(signal.strength_min, 1);
     }
 
     // add lipo battery charge if available
@@ -31,9 +31,13 @@
 #include "tracker_location.h"
 #include "tracker_motion.h"
 #include "tracker_shipping.h"
+#include "tracker_energy.h"
+#include "tracker_power.h"
+#include "tracker_retained.h"
 #include "tracker_rgb.h"
 #include "gnss_led.h"
 #include "temperature.h"
+#include "threshold.h"
 #include "mcp_can.h"
 
 struct TrackerCloudConfig {
@@ -46,6 +50,14 @@ enum class TrackerChargeState {
     CHARGE_CARE,
 };
 
+enum class TrackerBatteryInitState {
+    SETTLE,             // Charging disabled, waiting for the battery and bulk capacitance to equalize
+    QUICKSTART,         // Fuel gauge restarted, waiting for its first reading
+    START_DELAY,        // Waiting for power on glitches between battery states to pass
+    ALERT_CLEAR,        // Fuel gauge alert cleared, waiting for the alert pin to release
+    DONE,               // Low battery monitoring running
+};
+
 struct TrackerChargeStatus {
     unsigned int uptime;
     TrackerChargeState state;
@@ -241,6 +253,20 @@ class Tracker {
             return _cloudConfig.UsbCommandEnable;
         }
 
+        /**
+         * @brief Indicates whether the fuel gauge quickstart is still in progress after a cold boot
+         *
+         * The quickstart must read the battery unloaded and with charging off, so the application
+         * should hold the cloud connection and power configuration changes until it completes.
+         *
+         * @return true Quickstart in progress
+         * @return false Quickstart completed, or not needed
+         */
+        bool isBatteryQuickStartPending() const {
+            return (_batteryInitState == TrackerBatteryInitState::SETTLE) ||
+                (_batteryInitState == TrackerBatteryInitState::QUICKSTART);
+        }
+
         /**
          * @brief Enable or disable application watchdog
          *
@@ -278,6 +304,9 @@ class Tracker {
         TrackerLocation &location;
         TrackerMotion &motion;
         TrackerShipping &shipping;
+        TrackerEnergy &energy;
+        TrackerPower &power;
+        TrackerRetained &snapshot;
         TrackerRGB &rgb;
 
     private:
@@ -294,11 +323,14 @@ class Tracker {
 
         uint32_t _lastLoopSec;
         bool _canPowerEnabled;
-        bool _pastWarnLimit;
+        Threshold _batteryWarning;
         unsigned int _evalTick;
+        unsigned int _batterySampleSec;
         bool _lastBatteryCharging;
-        bool _delayedBatteryCheck;
-        unsigned int _delayedBatteryCheckTick;
+        TrackerBatteryInitState _batteryInitState;
+        system_tick_t _batteryInitMs;
+        bool _chargeEventPending;
+        TemperatureChargeEvent _pendingChargeEvent;
         TrackerChargeStatus _pendingChargeStatus;
         Mutex _pendingLock;
         TrackerChargeState _chargeStatus;
@@ -324,6 +356,10 @@ class Tracker {
         // Shutdown related
         void startLowBatteryShippingMode();
 
+        // Reset recovery related
+        void saveRetained();
+        void restoreRetained();
+
         // Various methods
         int registerConfig();
         static void loc_gen_cb(JSONWriter& writer, LocationPoint &loc, const void *context);
@@ -332,7 +368,8 @@ class Tracker {
         TrackerChargeStatus getPendingChargeStatus();
         static void lowBatteryHandler(system_event_t event, int data);
         static void batteryStateHandler(system_event_t event, int data);
-        void initBatteryMonitor();
+        void initBatteryMonitor(bool warmBoot);
+        void loopBatteryInit();
         bool getChargeEnabled();
         void evaluateBatteryCharge();
 };
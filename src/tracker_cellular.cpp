@@ -18,16 +18,104 @@
 
 TrackerCellular *TrackerCellular::_instance = nullptr;
 
-TrackerCellular::TrackerCellular() : _signal_update(0), thread(nullptr)
+TrackerCellular::TrackerCellular() :
+    _signal_update(0),
+    _history_head(0),
+    _history_count(0),
+    _read_until(0),
+    _publish_until(0),
+    _read_demand(false),
+    _publish_demand(false),
+    thread(nullptr),
+    _wake_queue(nullptr)
 {
+    os_queue_create(&_wake_queue, sizeof(uint8_t), 1, nullptr);
     thread = new Thread("tracker_cellular", [this]() {TrackerCellular::thread_f();}, OS_THREAD_PRIORITY_DEFAULT);
 }
 
+void TrackerCellular::requestSignal(TrackerCellularDemand demand)
+{
+    bool faster = false;
+    auto now = millis();
+
+    WITH_LOCK(mutex)
+    {
+        auto previous = getPeriod();
+        if(demand == TrackerCellularDemand::PUBLISH)
+        {
+            _publish_until = now + TRACKER_CELLULAR_DEMAND_PUBLISH_MS;
+            _publish_demand = true;
+        }
+        else
+        {
+            _read_until = now + TRACKER_CELLULAR_DEMAND_READ_MS;
+            _read_demand = true;
+        }
+        // only wake the thread when sampling starts or speeds up, not on every request
+        auto period = getPeriod();
+        faster = !previous || (period < previous);
+    }
+
+    if(faster && _wake_queue)
+    {
+        uint8_t msg = 0;
+        os_queue_put(_wake_queue, &msg, 0, nullptr);
+    }
+}
+
+// the sampling period for the demands still in effect, or zero when idle
+system_tick_t TrackerCellular::getPeriod()
+{
+    const std::lock_guard<RecursiveMutex> lg(mutex);
+    auto now = millis();
+
+    if(_publish_demand && (int32_t)(_publish_until - now) <= 0)
+    {
+        _publish_demand = false;
+    }
+    if(_read_demand && (int32_t)(_read_until - now) <= 0)
+    {
+        _read_demand = false;
+    }
+
+    if(_publish_demand)
+    {
+        return TRACKER_CELLULAR_PERIOD_SUCCESS_MS;
+    }
+    if(_read_demand)
+    {
+        return TRACKER_CELLULAR_PERIOD_READ_MS;
+    }
+    return 0;
+}
+
+// wait for the timeout or until a request wants sampling sooner
+void TrackerCellular::wait(system_tick_t timeout)
+{
+    uint8_t msg;
+    if(_wake_queue)
+    {
+        os_queue_take(_wake_queue, &msg, timeout, nullptr);
+    }
+    else
+    {
+        delay(timeout);
+    }
+}
+
 // a thread to capture cellular signal strength in a non-blocking fashion
 void TrackerCellular::thread_f()
 {
     while(true)
     {
+        // each sample is an AT command that competes with publishes so only sample on demand
+        auto period = getPeriod();
+        if(!period)
+        {
+            wait(CONCURRENT_WAIT_FOREVER);
+            continue;
+        }
+
         if(Cellular.ready())
         {
             CellularSignal rssi = Cellular.RSSI();
@@ -39,8 +127,14 @@ void TrackerCellular::thread_f()
                 {
                     _signal = rssi;
                     _signal_update = uptime;
+                    _history[_history_head] = {uptime, rssi.getStrength(), rssi.getQuality()};
+                    _history_head = (_history_head + 1) % TRACKER_CELLULAR_HISTORY_SIZE;
+                    if(_history_count < TRACKER_CELLULAR_HISTORY_SIZE)
+                    {
+                        _history_count++;
+                    }
                 }
-                delay(TRACKER_CELLULAR_PERIOD_SUCCESS_MS);
+                wait(period);
             }
             else
             {
@@ -51,13 +145,15 @@ void TrackerCellular::thread_f()
         else
         {
             _signal_update = 0;
-            delay(TRACKER_CELLULAR_PERIOD_SUCCESS_MS);
+            wait(TRACKER_CELLULAR_PERIOD_SUCCESS_MS);
         }
     }
 }
 
 int TrackerCellular::getSignal(CellularSignal &signal, unsigned int max_age)
 {
+    requestSignal(TrackerCellularDemand::READ);
+
     const std::lock_guard<RecursiveMutex> lg(mutex);
 
     if(!_signal_update || System.uptime() - _signal_update > max_age)
@@ -73,3 +169,42 @@ unsigned int TrackerCellular::getSignalUpdate()
 {
     return _signal_update;
 }
+
+int TrackerCellular::getSignalStats(TrackerCellularStats &stats, unsigned int max_age)
+{
+    const std::lock_guard<RecursiveMutex> lg(mutex);
+    auto uptime = System.uptime();
+
+    stats = {};
+    float strength_sum = 0.0f;
+    float quality_sum = 0.0f;
+    for(size_t i = 0; i < _history_count; i++)
+    {
+        auto &sample = _history[(_history_head + TRACKER_CELLULAR_HISTORY_SIZE - 1 - i) % TRACKER_CELLULAR_HISTORY_SIZE];
+        if(uptime - sample.uptime > max_age)
+        {
+            // samples are newest first so the rest are older still
+            break;
+        }
+        if(!stats.count || sample.strength < stats.strength_min)
+        {
+            stats.strength_min = sample.strength;
+        }
+        if(!stats.count || sample.quality < stats.quality_min)
+        {
+            stats.quality_min = sample.quality;
+        }
+        strength_sum += sample.strength;
+        quality_sum += sample.quality;
+        stats.count++;
+    }
+
+    if(!stats.count)
+    {
+        return -ENODATA;
+    }
+
+    stats.strength_avg = strength_sum / stats.count;
+    stats.quality_avg = quality_sum / stats.count;
+    return 0;
+}
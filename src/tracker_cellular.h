@@ -18,22 +18,54 @@
 
 #include "Particle.h"
 
-// delay between checking cell strength when no errors detected
+// delay between checking cell strength around publishes
 #define TRACKER_CELLULAR_PERIOD_SUCCESS_MS (1000)
+// delay between checking cell strength when only read, such as for the status LED
+#define TRACKER_CELLULAR_PERIOD_READ_MS (5000)
 // delay between checking cell strength when errors detected
 // longer than success to minimize thrashing on the cell interface which could
 // delay recovery in Device-OS
 #define TRACKER_CELLULAR_PERIOD_ERROR_MS (10000)
 
+// how long sampling continues after the last request for each demand
+#define TRACKER_CELLULAR_DEMAND_READ_MS (30000)
+#define TRACKER_CELLULAR_DEMAND_PUBLISH_MS (30000)
+
 // cell updates need to be at least this often or flagged as an error
 #define TRACKER_CELLULAR_DEFAULT_MAX_AGE_SEC (10)
 
+// samples kept for signal statistics and how old they may be to count
+#define TRACKER_CELLULAR_HISTORY_SIZE (16)
+#define TRACKER_CELLULAR_HISTORY_MAX_AGE_SEC (300)
+
+// reasons for the signal to be sampled, sampling stops when there are none
+enum class TrackerCellularDemand {
+    READ,       // signal is being read, sample at a relaxed rate
+    PUBLISH,    // a publish is coming up, sample quickly
+};
+
+// statistics of recent signal samples, in percent
+struct TrackerCellularStats {
+    unsigned int count;
+    float strength_min;
+    float strength_avg;
+    float quality_min;
+    float quality_avg;
+};
+
 class TrackerCellular
 {
     public:
+        // get the latest signal, which also requests sampling for a while
         int getSignal(CellularSignal &signal, unsigned int max_age=TRACKER_CELLULAR_DEFAULT_MAX_AGE_SEC);
         unsigned int getSignalUpdate();
 
+        // get statistics of the samples taken within the given age
+        int getSignalStats(TrackerCellularStats &stats, unsigned int max_age=TRACKER_CELLULAR_HISTORY_MAX_AGE_SEC);
+
+        // start, or extend, sampling for the given reason
+        void requestSignal(TrackerCellularDemand demand);
+
         void lock() {mutex.lock();}
         void unlock() {mutex.unlock();}
 
@@ -48,12 +80,30 @@ class TrackerCellular
     private:
         TrackerCellular();
 
+        struct Sample {
+            unsigned int uptime;
+            float strength;
+            float quality;
+        };
+
         CellularSignal _signal;
         unsigned int _signal_update;
 
+        Sample _history[TRACKER_CELLULAR_HISTORY_SIZE];
+        size_t _history_head;
+        size_t _history_count;
+
+        system_tick_t _read_until;
+        system_tick_t _publish_until;
+        bool _read_demand;
+        bool _publish_demand;
+
         RecursiveMutex mutex;
         Thread * thread;
+        os_queue_t _wake_queue;
 
+        system_tick_t getPeriod();
+        void wait(system_tick_t timeout);
         void thread_f();
 
         static TrackerCellular *_instance;
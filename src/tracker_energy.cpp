@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tracker_energy.h"
+
+#include "cloud_service.h"
+#include "config_service.h"
+
+TrackerEnergy *TrackerEnergy::_instance = nullptr;
+
+static void write_cycle(JSONWriter &writer, const EnergyCycle &cycle)
+{
+    static const char *names[EnergyComponentCount] = {"run", "mdm", "gnss", "wifi", "slp", "mdm_idle"};
+
+    writer.name("dur").value((unsigned int) (cycle.durationMs / 1000));
+    for (size_t i = 0; i < EnergyComponentCount; i++)
+    {
+        writer.name(names[i]).value((unsigned int) (cycle.onMs[i] / 1000));
+    }
+}
+
+void TrackerEnergy::init()
+{
+    static ConfigObject energy_desc
+    (
+        "energy",
+        {
+            ConfigFloat("run_ma", &_config.run_ma, 0.0, 1000.0),
+            ConfigFloat("modem_ma", &_config.modem_ma, 0.0, 1000.0),
+            ConfigFloat("gnss_ma", &_config.gnss_ma, 0.0, 1000.0),
+            ConfigFloat("wifi_ma", &_config.wifi_ma, 0.0, 1000.0),
+            ConfigFloat("sleep_ma", &_config.sleep_ma, 0.0, 1000.0),
+            ConfigFloat("modem_idle_ma", &_config.modem_idle_ma, 0.0, 1000.0),
+            ConfigFloat("batt_mah", &_config.battery_mah, 1.0, 100000.0),
+        }
+    );
+
+    ConfigService::instance().registerModule(energy_desc);
+
+    // The modem connects and the GNSS receiver is started as part of boot
+    _ledger.start(System.millis(),
+        (1UL << (size_t) EnergyComponent::RUN) |
+        (1UL << (size_t) EnergyComponent::MODEM) |
+        (1UL << (size_t) EnergyComponent::GNSS));
+
+    TrackerSleep &sleep = TrackerSleep::instance();
+    sleep.registerSleep([this](TrackerSleepContext context){ this->onSleep(context); }, "energy", TrackerSleepCallbackPriorityLast);
+    sleep.registerWake([this](TrackerSleepContext context){ this->onWake(context); }, "energy", TrackerSleepCallbackPriorityFirst);
+    sleep.registerStateChange([this](TrackerSleepContext context){ this->onSleepStateChange(context); }, "energy");
+}
+
+void TrackerEnergy::set(EnergyComponent component, bool on)
+{
+    _ledger.set(component, on, System.millis());
+}
+
+void TrackerEnergy::getModel(EnergyModel &model)
+{
+    model.current[(size_t) EnergyComponent::RUN] = (float) _config.run_ma;
+    model.current[(size_t) EnergyComponent::MODEM] = (float) _config.modem_ma;
+    model.current[(size_t) EnergyComponent::GNSS] = (float) _config.gnss_ma;
+    model.current[(size_t) EnergyComponent::WIFI] = (float) _config.wifi_ma;
+    model.current[(size_t) EnergyComponent::SLEEP] = (float) _config.sleep_ma;
+    model.current[(size_t) EnergyComponent::MODEM_IDLE] = (float) _config.modem_idle_ma;
+}
+
+bool TrackerEnergy::getLastCycle(EnergyCycle &cycle)
+{
+    return _ledger.getLastCycle(cycle);
+}
+
+void TrackerEnergy::getTotals(EnergyCycle &cycle)
+{
+    _ledger.update(System.millis());
+    _ledger.getTotals(cycle);
+}
+
+// Called after the modem, GNSS and Wi-Fi have been stopped and just before the system sleeps
+void TrackerEnergy::onSleep(TrackerSleepContext context)
+{
+    auto now = System.millis();
+    bool warm = TrackerSleep::instance().isModemKeptWarm();
+    _ledger.set(EnergyComponent::MODEM, false, now);
+    _ledger.set(EnergyComponent::MODEM_IDLE, warm, now);
+    _ledger.set(EnergyComponent::RUN, false, now);
+    _ledger.set(EnergyComponent::SLEEP, true, now);
+}
+
+// Each cycle runs from one wake to the next so that it includes the sleep that follows the work
+void TrackerEnergy::onWake(TrackerSleepContext context)
+{
+    auto now = System.millis();
+    if (_ledger.isOn(EnergyComponent::MODEM_IDLE))
+    {
+        _ledger.set(EnergyComponent::MODEM_IDLE, false, now);
+        _ledger.set(EnergyComponent::MODEM, true, now);
+    }
+    _ledger.set(EnergyComponent::SLEEP, false, now);
+    _ledger.set(EnergyComponent::RUN, true, now);
+    _ledger.beginCycle(now);
+}
+
+void TrackerEnergy::onSleepStateChange(TrackerSleepContext context)
+{
+    if (context.reason == TrackerSleepReason::STATE_TO_CONNECTING)
+    {
+        set(EnergyComponent::MODEM, true);
+    }
+}
+
+void TrackerEnergy::updateBattery(float gauge, float temperature, bool charging)
+{
+    EnergyModel model;
+    EnergyCycle totals;
+    getModel(model);
+    getTotals(totals);
+
+    // A change of model can make the running total step backwards, which isn't load
+    auto mah = EnergyLedger::charge(model, totals);
+    auto discharge = (mah > _batteryMah) ? (mah - _batteryMah) : 0.0f;
+    _batteryMah = mah;
+
+    _battery.update(gauge, discharge, (float) _config.battery_mah, temperature, charging, System.millis());
+}
+
+void TrackerEnergy::publishVitals()
+{
+    Particle.publishVitals();
+    publish();
+}
+
+void TrackerEnergy::publish()
+{
+    EnergyModel model;
+    EnergyCycle totals;
+    EnergyCycle cycle;
+    getModel(model);
+    getTotals(totals);
+
+    CloudService &cloud_service = CloudService::instance();
+    cloud_service.lock();
+    cloud_service.beginCommand("energy");
+    cloud_service.writer().name("tot").beginObject();
+    write_cycle(cloud_service.writer(), totals);
+    cloud_service.writer().name("mah").value(EnergyLedger::charge(model, totals), 2);
+    cloud_service.writer().endObject();
+    if (_ledger.getLastCycle(cycle))
+    {
+        cloud_service.writer().name("cyc").beginObject();
+        write_cycle(cloud_service.writer(), cycle);
+        cloud_service.writer().name("mah").value(EnergyLedger::charge(model, cycle), 3);
+        cloud_service.writer().endObject();
+    }
+    cloud_service.writer().name("life_h").value(EnergyLedger::projectLife(model, totals, (float) _config.battery_mah), 1);
+    if (_battery.isValid())
+    {
+        cloud_service.writer().name("soc").value(_battery.getCharge(), 1);
+        auto hours = _battery.getTimeTo(0.0f);
+        if (hours >= 0.0f)
+        {
+            cloud_service.writer().name("tte_h").value(hours, 1);
+        }
+    }
+    cloud_service.send(WITH_ACK, CloudServicePublishFlags::NONE);
+    cloud_service.unlock();
+}
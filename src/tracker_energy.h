@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Particle.h"
+#include "energy_ledger.h"
+#include "battery_estimator.h"
+#include "tracker_sleep.h"
+
+// Current model exposed through the "energy" configuration object
+struct tracker_energy_config_t {
+    double run_ma;
+    double modem_ma;
+    double gnss_ma;
+    double wifi_ma;
+    double sleep_ma;
+    double modem_idle_ma;
+    double battery_mah;
+};
+
+class TrackerEnergy
+{
+    public:
+        /**
+         * @brief Return instance of the tracker energy object
+         *
+         * @retval TrackerEnergy&
+         */
+        static TrackerEnergy &instance()
+        {
+            if(!_instance)
+            {
+                _instance = new TrackerEnergy();
+            }
+            return *_instance;
+        }
+
+        void init();
+
+        /**
+         * @brief Record a component being powered on or off
+         *
+         * @param component Component that changed
+         * @param on Component is powered
+         */
+        void set(EnergyComponent component, bool on);
+
+        /**
+         * @brief Get the current model from configuration
+         *
+         * @param model Returned current model
+         */
+        void getModel(EnergyModel &model);
+
+        /**
+         * @brief Get the last completed wake cycle
+         *
+         * @param cycle Returned cycle
+         * @return true A cycle has completed
+         * @return false No cycle has completed yet
+         */
+        bool getLastCycle(EnergyCycle &cycle);
+
+        /**
+         * @brief Get the totals since boot
+         *
+         * @param cycle Returned totals
+         */
+        void getTotals(EnergyCycle &cycle);
+
+        /**
+         * @brief Update the battery estimate with a fuel gauge reading and the load modeled since the last one
+         *
+         * @param gauge Fuel gauge state of charge, in percent
+         * @param temperature Battery temperature, in degrees Celsius, or NAN if unknown
+         * @param charging Battery is being charged
+         */
+        void updateBattery(float gauge, float temperature, bool charging);
+
+        /**
+         * @brief Get the battery estimate
+         *
+         * @retval const BatteryEstimator&
+         */
+        const BatteryEstimator &getBattery() const
+        {
+            return _battery;
+        }
+
+        /**
+         * @brief Publish device vitals followed by the energy ledger
+         *
+         */
+        void publishVitals();
+
+    private:
+        TrackerEnergy() : _config({
+            .run_ma = EnergyDefaultRunMa,
+            .modem_ma = EnergyDefaultModemMa,
+            .gnss_ma = EnergyDefaultGnssMa,
+            .wifi_ma = EnergyDefaultWifiMa,
+            .sleep_ma = EnergyDefaultSleepMa,
+            .modem_idle_ma = EnergyDefaultModemIdleMa,
+            .battery_mah = EnergyDefaultBatteryMah,
+        }), _batteryMah(0.0f) {}
+        static TrackerEnergy *_instance;
+
+        void onSleep(TrackerSleepContext context);
+        void onWake(TrackerSleepContext context);
+        void onSleepStateChange(TrackerSleepContext context);
+        void publish();
+
+        EnergyLedger _ledger;
+        tracker_energy_config_t _config;
+        BatteryEstimator _battery;
+        float _batteryMah;
+};
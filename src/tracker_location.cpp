@@ -20,6 +20,8 @@
 #include "Particle.h"
 #include "tracker_config.h"
 #include "tracker_location.h"
+#include "tracker_energy.h"
+#include "tracker_cellular.h"
 
 #include "config_service.h"
 #include "location_service.h"
@@ -28,8 +30,6 @@ TrackerLocation *TrackerLocation::_instance = nullptr;
 
 static constexpr system_tick_t LoopSampleRate = 1000; // milliseconds
 static constexpr uint32_t EarlySleepSec = 2; // seconds
-static constexpr uint32_t MiscSleepWakeSec = 3; // seconds - miscellaneous time spent by system entering and exiting sleep
-static constexpr uint32_t LockTimeoutSec = 10; // seconds - time to wait for GNSS lock (sleep disabled)
 
 static constexpr size_t EnhancedLocationQueueSize = 5; // up to this many elements
 static constexpr size_t ObjectEstimateWpsHeaderSize = sizeof(",{\"wps\":[]}") - 1 /* null */;
@@ -79,6 +79,73 @@ int TrackerLocation::exit_location_config_cb(bool write, int status, const void
     return status;
 }
 
+void TrackerLocation::setOverride(const tracker_location_override_t &override)
+{
+    std::lock_guard<RecursiveMutex> lg(mutex);
+    _override = override;
+    _override_enabled = true;
+}
+
+void TrackerLocation::clearOverride()
+{
+    std::lock_guard<RecursiveMutex> lg(mutex);
+    _override_enabled = false;
+}
+
+bool TrackerLocation::isPublishPending()
+{
+    std::lock_guard<RecursiveMutex> lg(mutex);
+    return _pending_immediate || !_pending_triggers.isEmpty();
+}
+
+bool TrackerLocation::isMotionPending()
+{
+    std::lock_guard<RecursiveMutex> lg(mutex);
+    for (auto trigger : _pending_triggers)
+    {
+        if (!strncmp(trigger, "imu_", 4))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// the configuration as saved with any runtime override applied on top
+tracker_location_config_t TrackerLocation::getActiveConfig()
+{
+    tracker_location_config_t config = _config_state;
+    if (!_override_enabled)
+    {
+        return config;
+    }
+
+    // a zero interval means no limit and stays that way
+    auto scale = [this](int32_t seconds) {
+        auto scaled = (double)seconds * _override.interval_scale;
+        return (scaled > 86400.0) ? 86400 : (int32_t)scaled;
+    };
+    config.interval_min_seconds = scale(config.interval_min_seconds);
+    config.interval_max_seconds = scale(config.interval_max_seconds);
+    config.wps = config.wps && _override.wps;
+
+    switch (_override.gnss)
+    {
+        case TrackerLocationGnssMode::ON:
+            break;
+
+        case TrackerLocationGnssMode::MOTION:
+            config.gnss = config.gnss && isMotionPending();
+            break;
+
+        case TrackerLocationGnssMode::OFF:
+            config.gnss = false;
+            break;
+    }
+
+    return config;
+}
+
 int TrackerLocation::get_loc_cb(CloudServiceStatus status,
     JSONValue *root,
     const void *context)
@@ -129,6 +196,12 @@ void TrackerLocation::init()
                 config_get_bool_cb, config_set_bool_cb,
                 &_config_state.loc_cb, &_config_state_shadow.loc_cb
             ),
+            ConfigInt("defer", config_get_int32_cb, config_set_int32_cb,
+                &_config_state.defer_seconds, &_config_state_shadow.defer_seconds,
+                0, 3600l),
+            ConfigInt("defer_sig", config_get_int32_cb, config_set_int32_cb,
+                &_config_state.defer_signal, &_config_state_shadow.defer_signal,
+                0, 100l),
         },
         std::bind(&TrackerLocation::enter_location_config_cb, this, _1, _2),
         std::bind(&TrackerLocation::exit_location_config_cb, this, _1, _2, _3)
@@ -138,13 +211,13 @@ void TrackerLocation::init()
 
     CloudService::instance().regCommandCallback("get_loc", &TrackerLocation::get_loc_cb, this);
 
-    _last_location_publish_sec = System.uptime() - _config_state.interval_min_seconds;
+    _last_location_publish_sec = System.uptime() - getActiveConfig().interval_min_seconds;
 
-    _sleep.registerSleepPrepare([this](TrackerSleepContext context){ this->onSleepPrepare(context); });
-    _sleep.registerSleep([this](TrackerSleepContext context){ this->onSleep(context); });
-    _sleep.registerSleepCancel([this](TrackerSleepContext context){ this->onSleepCancel(context); });
-    _sleep.registerWake([this](TrackerSleepContext context){ this->onWake(context); });
-    _sleep.registerStateChange([this](TrackerSleepContext context){ this->onSleepState(context); });
+    _sleep.registerSleepPrepare([this](TrackerSleepContext context){ this->onSleepPrepare(context); }, "location");
+    _sleep.registerSleep([this](TrackerSleepContext context){ this->onSleep(context); }, "location");
+    _sleep.registerSleepCancel([this](TrackerSleepContext context){ this->onSleepCancel(context); }, "location");
+    _sleep.registerWake([this](TrackerSleepContext context){ this->onWake(context); }, "location");
+    _sleep.registerStateChange([this](TrackerSleepContext context){ this->onSleepState(context); }, "location");
 
     CloudService::instance().regCommandCallback("loc-enhanced", &TrackerLocation::enhanced_cb, this);
 }
@@ -283,6 +356,33 @@ int TrackerLocation::triggerLocPub(Trigger type, const char *s)
     return 0;
 }
 
+void TrackerLocation::saveRetained(tracker_retained_location_t &state)
+{
+    std::lock_guard<RecursiveMutex> lg(mutex);
+
+    state.last_publish_sec = _last_location_publish_sec;
+    state.monotonic_publish_sec = _monotonic_publish_sec;
+    state.new_monotonic = _newMonotonic;
+    state.published = !_first_publish;
+}
+
+void TrackerLocation::restoreRetained(const tracker_retained_location_t &state)
+{
+    std::lock_guard<RecursiveMutex> lg(mutex);
+
+    // Nothing was published before the reset so keep the boot publish behavior
+    if (!state.published)
+    {
+        return;
+    }
+
+    auto &snapshot = TrackerRetained::instance();
+    _last_location_publish_sec = snapshot.rebase(state.last_publish_sec);
+    _monotonic_publish_sec = snapshot.rebase(state.monotonic_publish_sec);
+    _newMonotonic = state.new_monotonic;
+    _first_publish = false;
+}
+
 void TrackerLocation::issue_location_publish_callbacks(CloudServiceStatus status, JSONValue *rsp_root, const char *req_event)
 {
     for(auto cb : pendingLocPubCallbacks)
@@ -414,20 +514,45 @@ void TrackerLocation::enableNetwork() {
     _gnssStartedSec = System.uptime();
 }
 
+void TrackerLocation::startNetwork() {
+    enableNetwork();
+    if (_config_state_loop_safe.gnss) {
+        enableGnss();
+    }
+    if (_config_state_loop_safe.enhance_loc) {
+        if (_config_state_loop_safe.wps) {
+            enableWifi();
+        }
+    }
+}
+
+void TrackerLocation::evaluateNetwork() {
+    std::lock_guard<RecursiveMutex> lg(mutex);
+
+    if (!_sleep.isFullWakeCycle() && evaluatePublish().networkNeeded) {
+        startNetwork();
+        Log.trace("%s needs to start the network", __FUNCTION__);
+    }
+}
+
 void TrackerLocation::enableGnss() {
     LocationService::instance().start();
+    TrackerEnergy::instance().set(EnergyComponent::GNSS, true);
 }
 
 void TrackerLocation::disableGnss() {
     LocationService::instance().stop();
+    TrackerEnergy::instance().set(EnergyComponent::GNSS, false);
 }
 
 void TrackerLocation::enableWifi() {
     WiFi.on();
+    TrackerEnergy::instance().set(EnergyComponent::WIFI, true);
 }
 
 void TrackerLocation::disableWifi() {
     WiFi.off();
+    TrackerEnergy::instance().set(EnergyComponent::WIFI, false);
 }
 
 bool TrackerLocation::isSleepEnabled() {
@@ -436,6 +561,7 @@ bool TrackerLocation::isSleepEnabled() {
 
 EvaluationResults TrackerLocation::evaluatePublish() {
     auto now = System.uptime();
+    auto config = getActiveConfig();
 
     if (_pending_immediate) {
         // request for immediate publish overrides the default min/max interval checking
@@ -451,116 +577,54 @@ EvaluationResults TrackerLocation::evaluatePublish() {
         return EvaluationResults {PublishReason::TRIGGERS, true, (now - _gnssStartedSec) < (uint32_t)_sleep.getConfigConnectingTime()};
     }
 
-    uint32_t interval = now - _last_location_publish_sec;
-    uint32_t maxInterval = now - _monotonic_publish_sec;
-
-    bool networkNeeded = false;
-    uint32_t max = (uint32_t)_config_state.interval_max_seconds;
-    auto maxNetwork = max;
-    if  (maxNetwork > (uint32_t)_nextEarlyWake) {
-        maxNetwork -= (uint32_t)_nextEarlyWake;
-    }
-
-    if (_config_state.interval_max_seconds) {
-        if (maxInterval >= maxNetwork) {
-            // max interval adjusted for early wake
-            Log.trace("%s maxNetwork", __FUNCTION__);
-            networkNeeded = true;
-        }
-
-        if (maxInterval >= max) {
-            // max interval and past the max interval so have to publish
-            Log.trace("%s max", __FUNCTION__);
-            // timeout may be pre-empted when sleep enabled
-            return EvaluationResults {PublishReason::TIME, true, (maxInterval - max) < LockTimeoutSec};
-        }
-    }
-
-    uint32_t min = (uint32_t)_config_state.interval_min_seconds;
-    auto minNetwork = min;
-    if  (minNetwork > (uint32_t)_nextEarlyWake) {
-        minNetwork -= (uint32_t)_nextEarlyWake;
-    }
-
-    if (_pending_triggers.size()) {
-        if (!_config_state.interval_min_seconds ||
-            (interval >= minNetwork)) {
-            // min interval adjusted for early wake
-            Log.trace("%s minNetwork", __FUNCTION__);
-            networkNeeded = true;
-        }
-
-        if (!_config_state.interval_min_seconds ||
-            (interval >= min)) {
-            // no min interval or past the min interval so can publish
-            Log.trace("%s min", __FUNCTION__);
-            // timeout may be pre-empted when sleep enabled
-            return EvaluationResults {PublishReason::TRIGGERS, true, (interval - min) < LockTimeoutSec};
-        }
-    }
-
-    return EvaluationResults {PublishReason::NONE, networkNeeded, false};
+    return PublishSchedule::evaluateIntervals(now,
+        _last_location_publish_sec,
+        _monotonic_publish_sec,
+        (uint32_t)config.interval_min_seconds,
+        (uint32_t)config.interval_max_seconds,
+        (uint32_t)_nextEarlyWake,
+        _pending_triggers.size() > 0);
 }
 
 // The purpose of thhe sleep prepare callback is to allow each task to calculate
 // the next time it needs to wake and process inputs, publish, and what not.
 void TrackerLocation::onSleepPrepare(TrackerSleepContext context) {
-    // The first thing to figure out is the needed interval, min or max
-    unsigned int wake = _last_location_publish_sec;
-    int32_t interval = 0;
-    if (_pending_triggers.size()) {
-        interval = _config_state.interval_min_seconds;
-        wake += interval;
-    }
-    else {
-        interval = _config_state.interval_max_seconds;
-        wake += interval;
-    }
+    auto config = getActiveConfig();
+    bool pendingTriggers = _pending_triggers.size() > 0;
 
     // Next calculate the early wake offset so that we can wake in the minimum amount of time before
     // the next publish in order to minimize time spent in fully powered operation
     auto t_conn = (uint32_t)_sleep.getConfigConnectingTime();
     if (_sleep.isFullWakeCycle()) {
-        uint32_t newEarlyWakeSec = 0;
-        uint32_t lastWakeSec = (uint32_t)(context.lastWakeMs + 500) / 1000; // Round ms to s
-        if (lastWakeSec >= MiscSleepWakeSec) {
-            lastWakeSec -= MiscSleepWakeSec;
-        }
-        uint32_t wakeToLockDurationSec = 0;
-        int32_t publishVariance = 0;
-
-        if (_firstLockSec == 0) {
-            wakeToLockDurationSec = t_conn;
-        }
-        else {
-            wakeToLockDurationSec = _firstLockSec - lastWakeSec;
-        }
-
-        publishVariance = (int32_t)_last_location_publish_sec - (int32_t)_monotonic_publish_sec;
-
-        newEarlyWakeSec = wakeToLockDurationSec + publishVariance + 1;
-        if (newEarlyWakeSec > t_conn) {
-            newEarlyWakeSec = t_conn;
-        }
-        _nextEarlyWake = _earlyWake = newEarlyWakeSec;
+        _nextEarlyWake = _earlyWake = PublishSchedule::calculateEarlyWake(context.lastWakeMs,
+            _firstLockSec,
+            (uint32_t)_sleep.getReconnectCost(),
+            t_conn,
+            _last_location_publish_sec,
+            _monotonic_publish_sec);
     }
     else {  // Not in full wake (modem on)
         _nextEarlyWake = (_earlyWake == 0) ? t_conn : _earlyWake;
     }
 
-    // If the interval and early adjustments puts the wake time in the past then
-    // spoil the next sleep attempt and stay awake.
-    if (wake > _nextEarlyWake)
-        wake -= _nextEarlyWake;
+    // Wake for the min interval if there are pending triggers, otherwise the max interval.  If the
+    // interval and early adjustments puts the wake time in the past then spoil the next sleep
+    // attempt and stay awake.
+    unsigned int wake = PublishSchedule::calculateWake(_last_location_publish_sec,
+        (uint32_t)config.interval_min_seconds,
+        (uint32_t)config.interval_max_seconds,
+        (uint32_t)_nextEarlyWake,
+        pendingTriggers);
 
-    TrackerSleepError wakeRet = _sleep.wakeAtSeconds(wake);
+    TrackerSleepError wakeRet = _sleep.wakeWithinSeconds("location", wake, wake);
 
     if (wakeRet == TrackerSleepError::TIME_IN_PAST) {
         wake = 0; // Force cancelled sleep
         _sleep.wakeAtSeconds(wake);
     }
 
-    Log.trace("TrackerLocation: last=%lu, interval=%ld, wake=%u", _last_location_publish_sec, interval, wake);
+    Log.trace("TrackerLocation: last=%lu, interval=%ld, wake=%u", _last_location_publish_sec,
+        (pendingTriggers) ? config.interval_min_seconds : config.interval_max_seconds, wake);
 }
 
 // The purpose of this callback is to alert us that sleep has been cancelled by another task or improper wake settings.
@@ -584,15 +648,7 @@ void TrackerLocation::onWake(TrackerSleepContext context) {
     auto result = evaluatePublish();
 
     if (result.networkNeeded) {
-        enableNetwork();
-        if (_config_state_loop_safe.gnss) {
-            enableGnss();
-        }
-        if (_config_state_loop_safe.enhance_loc) {
-            if (_config_state_loop_safe.wps) {
-                enableWifi();
-            }
-        }
+        startNetwork();
         Log.trace("%s needs to start the network", __FUNCTION__);
     }
     else {
@@ -807,7 +863,7 @@ size_t TrackerLocation::buildWpsInfo(JSONBufferWriter& writer, size_t size) {
 }
 
 GnssState TrackerLocation::loopLocation(LocationPoint& cur_loc) {
-    if (!_config_state.gnss) {
+    if (!_config_state_loop_safe.gnss) {
         return GnssState::DISABLED;
     }
     GnssState currentGnssState = GnssState::ON_LOCKED_STABLE;
@@ -868,8 +924,83 @@ GnssState TrackerLocation::loopLocation(LocationPoint& cur_loc) {
     return currentGnssState;
 }
 
+// the link is poor when recent signal strength averages below the configured level, and
+// unknown without enough recent samples
+SignalQuality TrackerLocation::getSignalQuality(float &strength) {
+    TrackerCellularStats stats;
+    if (TrackerCellular::instance().getSignalStats(stats, TRACKER_LOCATION_DEFER_SIGNAL_AGE_SEC) ||
+        (stats.count < TRACKER_LOCATION_DEFER_SIGNAL_MIN_COUNT)) {
+        return SignalQuality::UNKNOWN;
+    }
+
+    strength = stats.strength_avg;
+    return (strength < (float)_config_state.defer_signal) ? SignalQuality::POOR : SignalQuality::GOOD;
+}
+
+// Transmitting at the cell edge takes more energy and fails more often so trigger publishes
+// wait, for a while, for better signal or for a scheduled publish to go out with.
+// Returns true if the publish is being held.
+bool TrackerLocation::deferPublish(PublishReason reason) {
+    auto now = System.uptime();
+    float strength = 0.0f;
+    auto signal = getSignalQuality(strength);
+
+    auto result = PublishSchedule::evaluateDeferral(now,
+        _deferStartSec,
+        (uint32_t)_config_state.defer_seconds,
+        reason,
+        _first_publish,
+        signal);
+
+    switch (result) {
+        case DeferResult::HOLD: {
+            if (!_deferStartSec) {
+                Log.info("deferring publish for signal %.1f%%", strength);
+                _deferStartSec = now;
+                _deferStrength = strength;
+                _defer.deferred++;
+            }
+            return true;
+        }
+
+        case DeferResult::IMPROVED: {
+            Log.info("publishing deferred after %lu seconds, signal %.1f%%", now - _deferStartSec, strength);
+            _defer.improved++;
+            _defer.gain += strength - _deferStrength;
+            break;
+        }
+
+        case DeferResult::EXPIRED: {
+            Log.info("publishing deferred after %lu seconds with poor signal", now - _deferStartSec);
+            _defer.expired++;
+            break;
+        }
+
+        case DeferResult::MERGED: {
+            Log.info("publishing deferred with scheduled publish");
+            _defer.merged++;
+            break;
+        }
+
+        case DeferResult::SEND: {
+            break;
+        }
+    }
+
+    _deferStartSec = 0;
+    _lastPublishSignal = signal;
+    if (signal == SignalQuality::POOR) {
+        _defer.poor_publishes++;
+    }
+    else if (signal == SignalQuality::GOOD) {
+        _defer.good_publishes++;
+    }
+
+    return false;
+}
+
 void TrackerLocation::buildPublish(LocationPoint& cur_loc) {
-    bool locked = (_config_state.gnss) ? cur_loc.locked : false;
+    bool locked = (_config_state_loop_safe.gnss) ? cur_loc.locked : false;
 
     if(locked) {
         LocationService::instance().setWayPoint(cur_loc.latitude, cur_loc.longitude);
@@ -900,6 +1031,24 @@ void TrackerLocation::buildPublish(LocationPoint& cur_loc) {
         cb(cloud_service.writer(), cur_loc);
     }
 
+    // report how deferring for signal has worked out, merged publishes are transmissions saved
+    // and the retry counts compare publishes sent on poor and good signal
+    if (_defer.deferred) {
+        cloud_service.writer().name("defer").beginObject();
+        cloud_service.writer().name("n").value((unsigned int)_defer.deferred);
+        cloud_service.writer().name("imp").value((unsigned int)_defer.improved);
+        cloud_service.writer().name("exp").value((unsigned int)_defer.expired);
+        cloud_service.writer().name("mrg").value((unsigned int)_defer.merged);
+        if (_defer.improved) {
+            cloud_service.writer().name("gain").value(_defer.gain / _defer.improved, 1);
+        }
+        cloud_service.writer().name("pub_p").value((unsigned int)_defer.poor_publishes);
+        cloud_service.writer().name("rty_p").value((unsigned int)_defer.poor_retries);
+        cloud_service.writer().name("pub_g").value((unsigned int)_defer.good_publishes);
+        cloud_service.writer().name("rty_g").value((unsigned int)_defer.good_retries);
+        cloud_service.writer().endObject();
+    }
+
     cloud_service.writer().endObject();
 
     if(!_pending_triggers.isEmpty()) {
@@ -940,7 +1089,7 @@ void TrackerLocation::loop() {
     _loopSampleTick = millis();
 
     // Sync power state changes
-    tracker_location_config_t captureConfig = _config_state;
+    tracker_location_config_t captureConfig = getActiveConfig();
 
     if (firstLoop) {
         if (captureConfig.gnss) {
@@ -978,6 +1127,12 @@ void TrackerLocation::loop() {
     if (location_publish_retry_str && Particle.connected())
     {
         Log.info("retry failed publish");
+        if (_lastPublishSignal == SignalQuality::POOR) {
+            _defer.poor_retries++;
+        }
+        else if (_lastPublishSignal == SignalQuality::GOOD) {
+            _defer.good_retries++;
+        }
         location_publish();
     }
 
@@ -988,6 +1143,11 @@ void TrackerLocation::loop() {
     // Perform interval evaluation
     auto publishReason = evaluatePublish();
 
+    // Have signal samples ready to go with the publish
+    if (publishReason.networkNeeded || (publishReason.reason != PublishReason::NONE)) {
+        TrackerCellular::instance().requestSignal(TrackerCellularDemand::PUBLISH);
+    }
+
     // This evaluation may have performed earlier and determined that no network was needed.  Check again
     // because this loop may overlap with required network operations.
     if (!_sleep.isFullWakeCycle() && publishReason.networkNeeded) {
@@ -1081,8 +1241,8 @@ void TrackerLocation::loop() {
     // Perform publish of location data if requested
     //
 
-    // then of any new publish
-    if(publishNow && Particle.connected())
+    // then of any new publish, unless it is worth waiting for better signal
+    if(publishNow && Particle.connected() && !deferPublish(publishReason.reason))
     {
         if(location_publish_retry_str)
         {
@@ -1098,15 +1258,11 @@ void TrackerLocation::loop() {
         pendingLocPubCallbacks = locPubCallbacks;
         locPubCallbacks.clear();
         _last_location_publish_sec = System.uptime();
-        if ((_first_publish && !_pending_first_publish) || _newMonotonic)
-        {
-            _monotonic_publish_sec = _last_location_publish_sec;
-            _newMonotonic = false;
-        }
-        else
-        {
-            _monotonic_publish_sec += (uint32_t)_config_state.interval_max_seconds;
-        }
+        _monotonic_publish_sec = PublishSchedule::advanceMonotonic(_last_location_publish_sec,
+            _monotonic_publish_sec,
+            (uint32_t)getActiveConfig().interval_max_seconds,
+            (_first_publish && !_pending_first_publish) || _newMonotonic);
+        _newMonotonic = false;
 
         // Prevent flooding of first publishes when there are no acknowledges.
         if (!_config_state.process_ack && _first_publish) {
@@ -21,12 +21,20 @@
 #include "location_service.h"
 #include "motion_service.h"
 #include "tracker_sleep.h"
+#include "tracker_retained.h"
+#include "publish_schedule.h"
 
 #define TRACKER_LOCATION_INTERVAL_MIN_DEFAULT_SEC (900)
 #define TRACKER_LOCATION_INTERVAL_MAX_DEFAULT_SEC (3600)
 #define TRACKER_LOCATION_MIN_PUBLISH_DEFAULT (false)
 #define TRACKER_LOCATION_LOCK_TRIGGER (true)
 #define TRACKER_LOCATION_PROCESS_ACK (true)
+#define TRACKER_LOCATION_DEFER_DEFAULT_SEC (0)
+#define TRACKER_LOCATION_DEFER_SIGNAL_DEFAULT (20)
+
+// signal samples, over this many seconds, that decide whether the link is poor
+#define TRACKER_LOCATION_DEFER_SIGNAL_AGE_SEC (10)
+#define TRACKER_LOCATION_DEFER_SIGNAL_MIN_COUNT (3)
 
 // wait at most this many seconds for a locked GPS location to become stable
 // before publishing regardless
@@ -92,6 +100,21 @@ struct tracker_location_config_t {
     bool wps;
     bool enhance_loc;
     bool loc_cb;
+    int32_t defer_seconds; // 0 = never defer for poor signal, held publishes keep the device awake
+    int32_t defer_signal; // signal strength, in percent, below which publishes may be deferred
+};
+
+enum class TrackerLocationGnssMode {
+    ON,             // GNSS follows the location configuration
+    MOTION,         // GNSS only runs while a motion trigger is pending
+    OFF,            // GNSS is off
+};
+
+// Runtime adjustments applied on top of the location configuration, never saved
+struct tracker_location_override_t {
+    float interval_scale;   // multiplier of the min and max publish intervals
+    bool wps;               // Wi-Fi scans may run if configured
+    TrackerLocationGnssMode gnss;
 };
 
 enum class Trigger {
@@ -108,17 +131,17 @@ enum class GnssState {
     DISABLED,
 };
 
-enum class PublishReason {
-    NONE,
-    TIME,
-    TRIGGERS,
-    IMMEDIATE,
-};
-
-struct EvaluationResults {
-    PublishReason reason;
-    bool networkNeeded;
-    bool lockWait;
+// Outcome of publishes deferred for poor signal, and of publishes by the signal, when known, they were sent at
+struct tracker_location_defer_stats_t {
+    uint32_t deferred;
+    uint32_t improved;
+    uint32_t expired;
+    uint32_t merged;
+    float gain;             // sum of signal strength improvement, in percent, of improved publishes
+    uint32_t poor_publishes;
+    uint32_t poor_retries;
+    uint32_t good_publishes;
+    uint32_t good_retries;
 };
 
 class TrackerLocation
@@ -185,8 +208,24 @@ class TrackerLocation
 
         inline bool getMinPublish() { return _config_state.min_publish; }
 
+        // triggers are waiting to be published
+        bool isPublishPending();
+
+        // adjust the configuration at runtime without changing what is saved, or
+        // go back to the configuration as saved
+        void setOverride(const tracker_location_override_t &override);
+        void clearOverride();
+
         int addWap(WiFiAccessPoint* wap);
 
+        // start the network if pending triggers now warrant a publish, used during brief
+        // wakes where the rest of the loop is skipped
+        void evaluateNetwork();
+
+        // save publish timing to, and resume it from, the retained snapshot
+        void saveRetained(tracker_retained_location_t &state);
+        void restoreRetained(const tracker_retained_location_t &state);
+
     private:
         TrackerLocation() :
             _sleep(TrackerSleep::instance()),
@@ -201,7 +240,12 @@ class TrackerLocation
             _newMonotonic(true),
             _firstLockSec(0),
             _gnssStartedSec(0),
-            _lastGnssState(GnssState::OFF)
+            _lastGnssState(GnssState::OFF),
+            _override_enabled(false),
+            _deferStartSec(0),
+            _deferStrength(0.0f),
+            _lastPublishSignal(SignalQuality::UNKNOWN),
+            _defer()
         {
             _config_state = {
                 .interval_min_seconds = TRACKER_LOCATION_INTERVAL_MIN_DEFAULT_SEC,
@@ -214,9 +258,16 @@ class TrackerLocation
                 .wps = true,
                 .enhance_loc = true,
                 .loc_cb = false,
+                .defer_seconds = TRACKER_LOCATION_DEFER_DEFAULT_SEC,
+                .defer_signal = TRACKER_LOCATION_DEFER_SIGNAL_DEFAULT,
             };
 
             _config_state_loop_safe = _config_state;
+            _override = {
+                .interval_scale = 1.0f,
+                .wps = true,
+                .gnss = TrackerLocationGnssMode::ON,
+            };
         }
         static TrackerLocation *_instance;
         TrackerSleep& _sleep;
@@ -246,6 +297,7 @@ class TrackerLocation
 
         bool isSleepEnabled();
         void enableNetwork();
+        void startNetwork();
         void enableGnss();
         void disableGnss();
         void enableWifi();
@@ -256,6 +308,10 @@ class TrackerLocation
         void onWake(TrackerSleepContext context);
         void onSleepState(TrackerSleepContext context);
         EvaluationResults evaluatePublish();
+        tracker_location_config_t getActiveConfig();
+        bool isMotionPending();
+        SignalQuality getSignalQuality(float &strength);
+        bool deferPublish(PublishReason reason);
         void buildPublish(LocationPoint& cur_loc);
         GnssState loopLocation(LocationPoint& cur_loc);
         static int parseServeCell(const char* in, CellularServing& out);
@@ -277,6 +333,13 @@ class TrackerLocation
         GnssState _lastGnssState;
 
         tracker_location_config_t _config_state, _config_state_shadow, _config_state_loop_safe;
+        tracker_location_override_t _override;
+        bool _override_enabled;
+
+        uint32_t _deferStartSec;
+        float _deferStrength;
+        SignalQuality _lastPublishSignal;
+        tracker_location_defer_stats_t _defer;
 
         Vector<std::function<void(JSONWriter&, LocationPoint&)>> locGenCallbacks;
         // publish callback for the next publish (not in flight)
@@ -21,8 +21,36 @@
 #include "config_service.h"
 #include "motion_service.h"
 
+using namespace particle;
+
 TrackerMotion *TrackerMotion::_instance = nullptr;
 
+static size_t base64_encode(const uint8_t *src, size_t len, char *dst, size_t size)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t out = 0;
+
+    if (((len + 2) / 3) * 4 + 1 > size)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < len; i += 3)
+    {
+        uint32_t block = (uint32_t) src[i] << 16;
+        if (i + 1 < len) block |= (uint32_t) src[i + 1] << 8;
+        if (i + 2 < len) block |= (uint32_t) src[i + 2];
+
+        dst[out++] = table[(block >> 18) & 0x3f];
+        dst[out++] = table[(block >> 12) & 0x3f];
+        dst[out++] = (i + 1 < len) ? table[(block >> 6) & 0x3f] : '=';
+        dst[out++] = (i + 2 < len) ? table[block & 0x3f] : '=';
+    }
+    dst[out] = '\0';
+
+    return out;
+}
+
 static int get_motion_enabled_cb(int32_t &value, const void *context)
 {
     value = (int32_t) static_cast<MotionService *>((void *)context)->getMotionDetection();
@@ -75,6 +103,88 @@ static int set_high_g_enabled_cb(int32_t value, const void *context)
     return 0;
 }
 
+static int get_int32_field_cb(int32_t &value, const void *context)
+{
+    value = *(const int32_t *) context;
+    return 0;
+}
+
+static int set_int32_field_cb(int32_t value, const void *context)
+{
+    *(int32_t *) context = value;
+    return 0;
+}
+
+static int get_capture_enabled_cb(int32_t &value, const void *context)
+{
+    value = (int32_t) static_cast<MotionService *>((void *)context)->isCaptureEnabled();
+    return 0;
+}
+
+static int set_capture_enabled_cb(int32_t value, const void *context)
+{
+    static_cast<MotionService *>((void *)context)->enableCapture(value != 0);
+    return 0;
+}
+
+static int get_classify_enabled_cb(int32_t &value, const void *context)
+{
+    value = (int32_t) static_cast<MotionService *>((void *)context)->isClassifierEnabled();
+    return 0;
+}
+
+static int set_classify_enabled_cb(int32_t value, const void *context)
+{
+    static_cast<MotionService *>((void *)context)->enableClassifier(value != 0);
+    return 0;
+}
+
+static int get_fusion_enabled_cb(int32_t &value, const void *context)
+{
+    value = (int32_t) static_cast<MotionService *>((void *)context)->isFusionEnabled();
+    return 0;
+}
+
+static int set_fusion_enabled_cb(int32_t value, const void *context)
+{
+    static_cast<MotionService *>((void *)context)->enableFusion(value != 0);
+    return 0;
+}
+
+static int get_stop_enabled_cb(int32_t &value, const void *context)
+{
+    value = (int32_t) static_cast<MotionService *>((void *)context)->isStopDetectionEnabled();
+    return 0;
+}
+
+static int set_stop_enabled_cb(int32_t value, const void *context)
+{
+    static_cast<MotionService *>((void *)context)->enableStopDetection(value != 0);
+    return 0;
+}
+
+static int get_posture_enabled_cb(int32_t &value, const void *context)
+{
+    value = (int32_t) static_cast<MotionService *>((void *)context)->isPostureDetectionEnabled();
+    return 0;
+}
+
+static int set_posture_enabled_cb(int32_t value, const void *context)
+{
+    MotionService *motion_service = static_cast<MotionService *>((void *)context);
+
+    motion_service->enablePostureDetection(value != 0);
+    if (value)
+    {
+        TrackerSleep::instance().wakeFor((pin_t)BMI160_INT_PIN, BMI160_INT_MODE);
+    }
+    else if (!motion_service->isAnyAwake())
+    {
+        TrackerSleep::instance().ignore((pin_t)BMI160_INT_PIN);
+    }
+    return 0;
+}
+
 void TrackerMotion::init()
 {
     static ConfigObject imu_desc
@@ -88,6 +198,7 @@ void TrackerMotion::init()
                     {"low", (int32_t) MotionDetectionMode::LOW_SENSITIVITY},
                     {"medium", (int32_t) MotionDetectionMode::MEDIUM_SENSITIVITY},
                     {"high", (int32_t) MotionDetectionMode::HIGH_SENSITIVITY},
+                    {"custom", (int32_t) MotionDetectionMode::CUSTOM_SENSITIVITY},
                 },
                 get_motion_enabled_cb,
                 set_motion_enabled_cb,
@@ -103,27 +214,360 @@ void TrackerMotion::init()
                 set_high_g_enabled_cb,
                 &MotionService::instance()
             ),
+            ConfigStringEnum(
+                "capture",
+                {
+                    {"disable", 0},
+                    {"enable", 1},
+                },
+                get_capture_enabled_cb,
+                set_capture_enabled_cb,
+                &MotionService::instance()
+            ),
+            ConfigStringEnum(
+                "classify",
+                {
+                    {"disable", 0},
+                    {"enable", 1},
+                },
+                get_classify_enabled_cb,
+                set_classify_enabled_cb,
+                &MotionService::instance()
+            ),
+            ConfigStringEnum(
+                "orient",
+                {
+                    {"disable", 0},
+                    {"enable", 1},
+                },
+                get_fusion_enabled_cb,
+                set_fusion_enabled_cb,
+                &MotionService::instance()
+            ),
+            ConfigStringEnum(
+                "stop",
+                {
+                    {"disable", 0},
+                    {"enable", 1},
+                },
+                get_stop_enabled_cb,
+                set_stop_enabled_cb,
+                &MotionService::instance()
+            ),
+            ConfigStringEnum(
+                "posture",
+                {
+                    {"disable", 0},
+                    {"enable", 1},
+                },
+                get_posture_enabled_cb,
+                set_posture_enabled_cb,
+                &MotionService::instance()
+            ),
         }
     );
 
     ConfigService::instance().registerModule(imu_desc);
+
+    // Wakes only from the IMU interrupt just need the motion event handled
+    TrackerSleep::instance().allowBriefWake((pin_t)BMI160_INT_PIN);
+
+    // Start from the settings currently used by the motion service
+    Bmi160AccelerometerConfig accel;
+    Bmi160AccelMotionConfig motion;
+    Bmi160AccelHighGConfig high_g;
+    MotionService::instance().getAccelerometerConfig(accel);
+    MotionService::instance().getMotionConfig(motion);
+    MotionService::instance().getHighGConfig(high_g);
+    _tune_config = {
+        .rate = accel.rate,
+        .range = (int32_t) accel.range,
+        .motion_mode = (int32_t) motion.mode,
+        .motion_threshold = motion.motionThreshold,
+        .motion_duration = (int32_t) motion.motionDuration,
+        .motion_skip = (int32_t) motion.motionSkip,
+        .motion_proof = (int32_t) motion.motionProof,
+        .high_g_threshold = high_g.threshold,
+        .high_g_duration = high_g.duration,
+        .high_g_hysteresis = high_g.hysteresis,
+    };
+
+    static ConfigObject imu_tune_desc
+    (
+        "imu_tune",
+        {
+            ConfigFloat("rate", &_tune_config.rate, 0.78, 1600.0),
+            ConfigInt("range", &_tune_config.range, 2, 16),
+            ConfigStringEnum(
+                "motion_mode",
+                {
+                    {"any", (int32_t) Bmi160AccelMotionMode::ACCEL_MOTION_MODE_ANY},
+                    {"significant", (int32_t) Bmi160AccelMotionMode::ACCEL_MOTION_MODE_SIGNIFICANT},
+                },
+                get_int32_field_cb,
+                set_int32_field_cb,
+                &_tune_config.motion_mode
+            ),
+            ConfigFloat("motion_th", &_tune_config.motion_threshold, 0.0, 16.0),
+            ConfigInt("motion_dur", &_tune_config.motion_duration, 1, 4),
+            ConfigStringEnum(
+                "motion_skip",
+                {
+                    {"1.5", (int32_t) Bmi160AccelSignificantMotionSkip::SIG_MOTION_SKIP_1_5_S},
+                    {"3", (int32_t) Bmi160AccelSignificantMotionSkip::SIG_MOTION_SKIP_3_0_S},
+                    {"6", (int32_t) Bmi160AccelSignificantMotionSkip::SIG_MOTION_SKIP_6_0_S},
+                    {"12", (int32_t) Bmi160AccelSignificantMotionSkip::SIG_MOTION_SKIP_12_S},
+                },
+                get_int32_field_cb,
+                set_int32_field_cb,
+                &_tune_config.motion_skip
+            ),
+            ConfigStringEnum(
+                "motion_proof",
+                {
+                    {"0.25", (int32_t) Bmi160AccelSignificantMotionProof::SIG_MOTION_PROOF_0_25_S},
+                    {"0.5", (int32_t) Bmi160AccelSignificantMotionProof::SIG_MOTION_PROOF_0_5_S},
+                    {"1", (int32_t) Bmi160AccelSignificantMotionProof::SIG_MOTION_PROOF_1_S},
+                    {"2", (int32_t) Bmi160AccelSignificantMotionProof::SIG_MOTION_PROOF_2_S},
+                },
+                get_int32_field_cb,
+                set_int32_field_cb,
+                &_tune_config.motion_proof
+            ),
+            ConfigFloat("high_g_th", &_tune_config.high_g_threshold, 0.0, 16.0),
+            ConfigFloat("high_g_dur", &_tune_config.high_g_duration, 0.0025, 0.64),
+            ConfigFloat("high_g_hyst", &_tune_config.high_g_hysteresis, 0.0, 16.0),
+        },
+        nullptr,
+        std::bind(&TrackerMotion::exit_tune_config_cb, this, _1, _2, _3)
+    );
+
+    ConfigService::instance().registerModule(imu_tune_desc);
+
+    TrackerLocation::instance().regLocGenCallback(loc_gen_cb, this);
+}
+
+// when exiting the tuning config object push the settings to the motion service,
+// which only writes the ones that changed to the IMU
+int TrackerMotion::exit_tune_config_cb(bool write, int status, const void *context)
+{
+    if(write && !status)
+    {
+        Bmi160AccelerometerConfig accel = {
+            .rate = (float) _tune_config.rate,
+            .range = (float) _tune_config.range,
+        };
+        Bmi160AccelMotionConfig motion = {
+            .mode = (Bmi160AccelMotionMode) _tune_config.motion_mode,
+            .motionThreshold = (float) _tune_config.motion_threshold,
+            .motionDuration = (unsigned) _tune_config.motion_duration,
+            .motionSkip = (Bmi160AccelSignificantMotionSkip) _tune_config.motion_skip,
+            .motionProof = (Bmi160AccelSignificantMotionProof) _tune_config.motion_proof,
+        };
+        Bmi160AccelHighGConfig high_g = {
+            .threshold = (float) _tune_config.high_g_threshold,
+            .duration = (float) _tune_config.high_g_duration,
+            .hysteresis = (float) _tune_config.high_g_hysteresis,
+        };
+
+        MotionService &motion_service = MotionService::instance();
+        status = motion_service.setAccelerometerConfig(accel);
+        if (!status)
+        {
+            status = motion_service.setMotionConfig(motion);
+        }
+        if (!status)
+        {
+            status = motion_service.setHighGConfig(high_g);
+        }
+    }
+    return status;
+}
+
+void TrackerMotion::trigger_publish(const char *trigger, const MotionEvent &event)
+{
+    TrackerLocation::instance().triggerLocPub(Trigger::NORMAL, trigger);
+
+    // Measure latency from the oldest motion event still waiting to be published
+    if (!_publish_pending)
+    {
+        _publish_pending = true;
+        _publish_event_ms = event.timestamp;
+    }
+}
+
+void TrackerMotion::loc_gen_cb(JSONWriter &writer, LocationPoint &loc, const void *context)
+{
+    TrackerMotion *self = static_cast<TrackerMotion *>((void *)context);
+
+    // Latency runs until this publish is acknowledged
+    if (self->_publish_pending)
+    {
+        self->_publish_sent_ms = self->_publish_event_ms;
+        self->_publish_pending = false;
+        TrackerLocation::instance().regLocPubCallback(loc_pub_cb, self);
+    }
+
+    MotionOrientation orientation;
+    if (!MotionService::instance().getOrientation(orientation))
+    {
+        writer.name("imu_hd").value(orientation.heading, 1);
+        writer.name("imu_tilt").value(orientation.tilt, 1);
+    }
+}
+
+int TrackerMotion::loc_pub_cb(CloudServiceStatus status, JSONValue *rsp_root, const char *req_event, const void *context)
+{
+    const TrackerMotion *self = static_cast<const TrackerMotion *>(context);
+
+    if (status == CloudServiceStatus::SUCCESS)
+    {
+        MotionService::instance().recordPublishLatency(self->_publish_sent_ms);
+    }
+
+    return 0;
 }
 
 void TrackerMotion::loop()
 {
-    MotionEvent motion_event;
-    size_t depth = MotionService::instance().getQueueDepth();
+    MotionEvent motion_events[MotionService::MOTION_EVENTS_DEFAULT];
+    size_t count = MotionService::instance().drainEvents(motion_events, MotionService::MOTION_EVENTS_DEFAULT);
 
-    do {
-        MotionService::instance().waitOnEvent(motion_event, 0);
+    for (size_t i = 0; i < count; i++) {
+        const MotionEvent &motion_event = motion_events[i];
         switch (motion_event.source)
         {
             case MotionSource::MOTION_HIGH_G:
-                TrackerLocation::instance().triggerLocPub(Trigger::NORMAL, "imu_g");
+                trigger_publish("imu_g", motion_event);
                 break;
             case MotionSource::MOTION_MOVEMENT:
-                TrackerLocation::instance().triggerLocPub(Trigger::NORMAL,"imu_m");
+                trigger_publish("imu_m", motion_event);
+                break;
+            case MotionSource::MOTION_ACTIVITY:
+                // Only publish when the device starts being moved, not for vibration alone
+                if ((motion_event.activity == MotionActivity::DRIVING) ||
+                    (motion_event.activity == MotionActivity::HANDLING))
+                {
+                    trigger_publish("imu_m", motion_event);
+                }
+                break;
+            case MotionSource::MOTION_ORIENTATION:
+                trigger_publish("imu_o", motion_event);
+                break;
+            case MotionSource::MOTION_STOPPED:
+                // The asset is parked so there is no reason to wait out the rest of the execution time
+                if (!TrackerLocation::instance().isPublishPending())
+                {
+                    TrackerSleep::instance().endExecution();
+                }
                 break;
         }
-    } while (--depth && (motion_event.source != MotionSource::MOTION_NONE));
+    }
+
+    capture_publish();
+
+    // A brief wake stays open while a high G capture collects its samples, and a completed capture
+    // needs the network for its publish
+    auto &sleep = TrackerSleep::instance();
+    if (sleep.isBriefWake())
+    {
+        if (MotionService::instance().isCapturing())
+        {
+            sleep.extendBriefWake();
+        }
+        else if (_capture || MotionService::instance().getCapture())
+        {
+            sleep.forceFullWakeCycle();
+        }
+    }
+}
+
+int TrackerMotion::capture_publish_cb(CloudServiceStatus status, JSONValue *rsp_root, const char *req_event, const void *context)
+{
+    _capture_pending = false;
+
+    if (status == CloudServiceStatus::SUCCESS)
+    {
+        _capture_chunk++;
+        _capture_attempts = 0;
+    }
+    else
+    {
+        _capture_attempts++;
+        Log.info("capture chunk %u publish failed", _capture_chunk);
+    }
+
+    return 0;
+}
+
+void TrackerMotion::capture_publish()
+{
+    // Only one chunk is in flight at a time and the next one is sent once it has been acknowledged
+    if (_capture_pending)
+    {
+        return;
+    }
+
+    if (!_capture)
+    {
+        _capture = MotionService::instance().getCapture();
+        _capture_chunk = 0;
+        _capture_attempts = 0;
+        if (!_capture)
+        {
+            return;
+        }
+    }
+
+    size_t chunks = (_capture->count + TrackerMotionCaptureChunkSamples - 1) / TrackerMotionCaptureChunkSamples;
+    if ((_capture_chunk >= chunks) || (_capture_attempts >= TrackerMotionCaptureRetries))
+    {
+        if (_capture_chunk < chunks)
+        {
+            Log.info("capture dropped after chunk %u of %u", _capture_chunk, chunks);
+        }
+        _capture = nullptr;
+        MotionService::instance().releaseCapture();
+        return;
+    }
+
+    if (!Particle.connected())
+    {
+        return;
+    }
+
+    size_t first = _capture_chunk * TrackerMotionCaptureChunkSamples;
+    size_t count = std::min(TrackerMotionCaptureChunkSamples, _capture->count - first);
+
+    // Worst case is three bytes for each axis of each sample
+    uint8_t encoded[TrackerMotionCaptureChunkSamples * 3 * 3];
+    char data[((sizeof(encoded) + 2) / 3) * 4 + 1];
+    size_t len = MotionCapture::encode(&_capture->samples[first], count, encoded, sizeof(encoded));
+    base64_encode(encoded, len, data, sizeof(data));
+
+    CloudService &cloud_service = CloudService::instance();
+    cloud_service.lock();
+    cloud_service.beginCommand("crash");
+    cloud_service.writer().name("time").value((unsigned int) _capture->time);
+    cloud_service.writer().name("rate").value(_capture->rate, 2);
+    cloud_service.writer().name("pre").value((unsigned int) _capture->preSamples);
+    cloud_service.writer().name("seq").value((unsigned int) _capture_chunk);
+    cloud_service.writer().name("total").value((unsigned int) chunks);
+    cloud_service.writer().name("first").value((unsigned int) first);
+    cloud_service.writer().name("data").value(data);
+    int rval = cloud_service.send(WITH_ACK,
+        CloudServicePublishFlags::NONE,
+        &TrackerMotion::capture_publish_cb, this,
+        CLOUD_DEFAULT_TIMEOUT_MS, nullptr);
+    cloud_service.unlock();
+
+    if (rval == 0)
+    {
+        _capture_pending = true;
+    }
+    else if (rval != -EBUSY)
+    {
+        // -EBUSY is transient and is retried on the next loop without counting against the chunk
+        _capture_attempts++;
+    }
 }
@@ -16,6 +16,30 @@
 
 #pragma once
 
+#include "cloud_service.h"
+#include "location_service.h"
+#include "motion_service.h"
+
+// Samples of a high G capture sent in each "crash" publish
+constexpr size_t TrackerMotionCaptureChunkSamples = 32;
+
+// Attempts to publish each capture chunk before the capture is dropped
+constexpr unsigned int TrackerMotionCaptureRetries = 3;
+
+// IMU settings exposed through the "imu_tune" configuration object
+typedef struct {
+    double rate;                    // Hz
+    int32_t range;                  // g
+    int32_t motion_mode;            // Bmi160AccelMotionMode
+    double motion_threshold;        // g
+    int32_t motion_duration;        // samples
+    int32_t motion_skip;            // Bmi160AccelSignificantMotionSkip
+    int32_t motion_proof;           // Bmi160AccelSignificantMotionProof
+    double high_g_threshold;        // g
+    double high_g_duration;         // seconds
+    double high_g_hysteresis;       // g
+} tracker_motion_tune_t;
+
 class TrackerMotion
 {
     public:
@@ -36,6 +60,29 @@ class TrackerMotion
         void init();
         void loop();
     private:
-        TrackerMotion() {}
+        TrackerMotion() :
+            _capture(nullptr),
+            _capture_chunk(0),
+            _capture_attempts(0),
+            _capture_pending(false),
+            _publish_event_ms(0),
+            _publish_sent_ms(0),
+            _publish_pending(false) {}
         static TrackerMotion *_instance;
+
+        void trigger_publish(const char *trigger, const MotionEvent &event);
+        static void loc_gen_cb(JSONWriter &writer, LocationPoint &loc, const void *context);
+        static int loc_pub_cb(CloudServiceStatus status, JSONValue *rsp_root, const char *req_event, const void *context);
+        int exit_tune_config_cb(bool write, int status, const void *context);
+        void capture_publish();
+        int capture_publish_cb(CloudServiceStatus status, JSONValue *rsp_root, const char *req_event, const void *context);
+
+        const MotionCaptureWindow *_capture;
+        size_t _capture_chunk;
+        unsigned int _capture_attempts;
+        bool _capture_pending;
+        system_tick_t _publish_event_ms;    // oldest motion event waiting for a publish
+        system_tick_t _publish_sent_ms;     // oldest motion event in the publish in flight
+        bool _publish_pending;
+        tracker_motion_tune_t _tune_config;
 };
\ No newline at end of file
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tracker_power.h"
+
+#include "config_service.h"
+#include "tracker_sleep.h"
+
+TrackerPower *TrackerPower::_instance = nullptr;
+
+static const char *profile_name(TrackerPowerProfile profile)
+{
+    switch (profile)
+    {
+        case TrackerPowerProfile::REDUCED:
+            return "reduced";
+
+        case TrackerPowerProfile::MINIMAL:
+            return "minimal";
+
+        default:
+            return "normal";
+    }
+}
+
+void TrackerPower::init()
+{
+    static ConfigObject power_desc
+    (
+        "power",
+        {
+            ConfigBool("enable", &_config.enable),
+            ConfigFloat("red_pct", &_config.reduced_pct, 0.0, 100.0),
+            ConfigFloat("min_pct", &_config.minimal_pct, 0.0, 100.0),
+            ConfigFloat("hyst", &_config.hyst, 0.0, 100.0),
+            ConfigFloat("red_scale", &_config.reduced_scale, 1.0, 100.0),
+            ConfigBool("red_wps", &_config.reduced_wps),
+            ConfigStringEnum(
+                "red_gnss",
+                {
+                    {"on", (int32_t) TrackerLocationGnssMode::ON},
+                    {"motion", (int32_t) TrackerLocationGnssMode::MOTION},
+                    {"off", (int32_t) TrackerLocationGnssMode::OFF},
+                },
+                &_config.reduced_gnss
+            ),
+            ConfigFloat("min_scale", &_config.minimal_scale, 1.0, 100.0),
+            ConfigBool("min_wps", &_config.minimal_wps),
+            ConfigStringEnum(
+                "min_gnss",
+                {
+                    {"on", (int32_t) TrackerLocationGnssMode::ON},
+                    {"motion", (int32_t) TrackerLocationGnssMode::MOTION},
+                    {"off", (int32_t) TrackerLocationGnssMode::OFF},
+                },
+                &_config.minimal_gnss
+            ),
+        }
+    );
+
+    ConfigService::instance().registerModule(power_desc);
+
+    TrackerLocation::instance().regLocGenCallback(
+        [this](JSONWriter &writer, LocationPoint &point, const void *context){ this->loc_gen_cb(writer, point, context); });
+}
+
+void TrackerPower::update(float charge, bool charging)
+{
+    _reduced.setLimit((float) _config.reduced_pct, (float) _config.hyst);
+    _minimal.setLimit((float) _config.minimal_pct, (float) _config.hyst);
+    _reduced.update(charge);
+    _minimal.update(charge);
+
+    // Charging covers whatever the device draws so there is no reason to hold back
+    auto profile = TrackerPowerProfile::NORMAL;
+    if (_config.enable && !charging)
+    {
+        if (_minimal.isActive())
+        {
+            profile = TrackerPowerProfile::MINIMAL;
+        }
+        else if (_reduced.isActive())
+        {
+            profile = TrackerPowerProfile::REDUCED;
+        }
+    }
+
+    if (profile != _profile)
+    {
+        Log.info("Power profile %s at %0.1f%% charge", profile_name(profile), charge);
+    }
+
+    // Applied every time so that configuration changes take effect in the current profile
+    apply(profile);
+}
+
+void TrackerPower::apply(TrackerPowerProfile profile)
+{
+    auto &location = TrackerLocation::instance();
+    _profile = profile;
+
+    switch (profile)
+    {
+        case TrackerPowerProfile::NORMAL:
+            location.clearOverride();
+            break;
+
+        case TrackerPowerProfile::REDUCED:
+            location.setOverride({
+                .interval_scale = (float) _config.reduced_scale,
+                .wps = _config.reduced_wps,
+                .gnss = _config.reduced_gnss,
+            });
+            break;
+
+        case TrackerPowerProfile::MINIMAL:
+            location.setOverride({
+                .interval_scale = (float) _config.minimal_scale,
+                .wps = _config.minimal_wps,
+                .gnss = _config.minimal_gnss,
+            });
+            break;
+    }
+
+    // Keeping the modem registered through sleep only pays off with frequent publishes
+    TrackerSleep::instance().allowModemWarm(profile == TrackerPowerProfile::NORMAL);
+}
+
+void TrackerPower::loc_gen_cb(JSONWriter &writer, LocationPoint &point, const void *context)
+{
+    if (_profile != TrackerPowerProfile::NORMAL)
+    {
+        writer.name("pwr").value(profile_name(_profile));
+    }
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Particle.h"
+#include "threshold.h"
+#include "tracker_location.h"
+
+// Default state of charge, in percent, below which each profile applies
+constexpr double TrackerPowerDefaultReducedPercent = 50.0;
+constexpr double TrackerPowerDefaultMinimalPercent = 20.0;
+
+// Default rise in state of charge, in percent, needed to leave a profile
+constexpr double TrackerPowerDefaultHysteresis = 3.0;
+
+// Default multiplier of the publish intervals in each profile
+constexpr double TrackerPowerDefaultReducedScale = 2.0;
+constexpr double TrackerPowerDefaultMinimalScale = 4.0;
+
+/**
+ * @brief Duty cycle applied according to the battery.
+ *
+ */
+enum class TrackerPowerProfile {
+    NORMAL,                         /**< Configuration as saved */
+    REDUCED,                        /**< Longer intervals and fewer radios */
+    MINIMAL,                        /**< Least activity short of shipping mode */
+};
+
+// Profiles exposed through the "power" configuration object
+struct tracker_power_config_t {
+    bool enable;
+    double reduced_pct;
+    double minimal_pct;
+    double hyst;
+    double reduced_scale;
+    bool reduced_wps;
+    TrackerLocationGnssMode reduced_gnss;
+    double minimal_scale;
+    bool minimal_wps;
+    TrackerLocationGnssMode minimal_gnss;
+};
+
+class TrackerPower
+{
+    public:
+        /**
+         * @brief Return instance of the tracker power object
+         *
+         * @retval TrackerPower&
+         */
+        static TrackerPower &instance()
+        {
+            if(!_instance)
+            {
+                _instance = new TrackerPower();
+            }
+            return *_instance;
+        }
+
+        void init();
+
+        /**
+         * @brief Select and apply the profile for the battery state
+         *
+         * @param charge Estimated state of charge, in percent
+         * @param charging Battery is being charged
+         */
+        void update(float charge, bool charging);
+
+        /**
+         * @brief Get the profile in effect
+         *
+         * @retval TrackerPowerProfile
+         */
+        TrackerPowerProfile getProfile() const
+        {
+            return _profile;
+        }
+
+    private:
+        TrackerPower() :
+            _config({
+                .enable = true,
+                .reduced_pct = TrackerPowerDefaultReducedPercent,
+                .minimal_pct = TrackerPowerDefaultMinimalPercent,
+                .hyst = TrackerPowerDefaultHysteresis,
+                .reduced_scale = TrackerPowerDefaultReducedScale,
+                .reduced_wps = false,
+                .reduced_gnss = TrackerLocationGnssMode::ON,
+                .minimal_scale = TrackerPowerDefaultMinimalScale,
+                .minimal_wps = false,
+                .minimal_gnss = TrackerLocationGnssMode::MOTION,
+            }),
+            _reduced({"power reduced", ThresholdDirection::BELOW, TrackerPowerDefaultReducedPercent, TrackerPowerDefaultHysteresis, 1}),
+            _minimal({"power minimal", ThresholdDirection::BELOW, TrackerPowerDefaultMinimalPercent, TrackerPowerDefaultHysteresis, 1}),
+            _profile(TrackerPowerProfile::NORMAL) {}
+        static TrackerPower *_instance;
+
+        void apply(TrackerPowerProfile profile);
+        void loc_gen_cb(JSONWriter &writer, LocationPoint &point, const void *context);
+
+        tracker_power_config_t _config;
+        Threshold _reduced;
+        Threshold _minimal;
+        TrackerPowerProfile _profile;
+};
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tracker_retained.h"
+
+constexpr uint32_t TrackerRetainedMagic = 0x54524b52; // "TRKR"
+
+TrackerRetained *TrackerRetained::_instance = nullptr;
+
+static retained tracker_retained_t retained_snapshot;
+
+static uint32_t crc32(const uint8_t *data, size_t size)
+{
+    uint32_t crc = 0xffffffff;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+        }
+    }
+
+    return ~crc;
+}
+
+static uint32_t snapshot_crc(const tracker_retained_t &snapshot)
+{
+    auto start = (const uint8_t *) &snapshot.uptime_sec;
+    auto end = (const uint8_t *) (&snapshot + 1);
+
+    return crc32(start, end - start);
+}
+
+TrackerRetained::TrackerRetained() :
+    _data(retained_snapshot),
+    _elapsedSec(0),
+    _restored(false)
+{
+}
+
+bool TrackerRetained::restore()
+{
+    _restored = false;
+
+    // Retained memory doesn't survive power loss and a firmware update may have changed what the
+    // snapshot means even when the layout matches
+    switch (System.resetReason())
+    {
+        case RESET_REASON_POWER_DOWN:
+        case RESET_REASON_POWER_BROWNOUT:
+        case RESET_REASON_UPDATE:
+            invalidate();
+            return false;
+
+        default:
+            break;
+    }
+
+    if ((_data.magic != TrackerRetainedMagic) ||
+        (_data.version != TrackerRetainedVersion) ||
+        (_data.size != sizeof(_data)) ||
+        (_data.crc != snapshot_crc(_data)))
+    {
+        Log.info("No valid retained snapshot, cold boot");
+        invalidate();
+        return false;
+    }
+
+    // Account for time spent in reset, or hibernation, when the clock allows it
+    _elapsedSec = 0;
+    if (_data.time && Time.isValid() && ((uint32_t) Time.now() > _data.time))
+    {
+        _elapsedSec = (uint32_t) Time.now() - _data.time;
+    }
+
+    Log.info("Restoring retained snapshot saved %lu seconds ago", _elapsedSec);
+    _restored = true;
+
+    return true;
+}
+
+uint32_t TrackerRetained::rebase(uint32_t uptime) const
+{
+    auto age = _data.uptime_sec - uptime;
+
+    return System.uptime() - age - _elapsedSec;
+}
+
+void TrackerRetained::save()
+{
+    _data.magic = TrackerRetainedMagic;
+    _data.version = TrackerRetainedVersion;
+    _data.size = sizeof(_data);
+    _data.uptime_sec = System.uptime();
+    _data.time = Time.isValid() ? (uint32_t) Time.now() : 0;
+    _data.crc = snapshot_crc(_data);
+}
+
+void TrackerRetained::invalidate()
+{
+    memset(&_data, 0, sizeof(_data));
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Particle.h"
+
+// Layout version of the retained snapshot, increment whenever any section below changes
+constexpr uint16_t TrackerRetainedVersion = 1;
+
+// Hot state of TrackerLocation, times are uptime in seconds when saved
+struct tracker_retained_location_t {
+    uint32_t last_publish_sec;
+    uint32_t monotonic_publish_sec;
+    bool new_monotonic;
+    bool published;
+};
+
+// Hot state of TrackerSleep
+struct tracker_retained_sleep_t {
+    uint32_t reconnect_cost_ms;
+};
+
+// Threshold and charge temperature state machines
+struct tracker_retained_temperature_t {
+    uint8_t high_state;
+    uint8_t low_state;
+    uint8_t charge_state;
+    bool high_latch;
+    bool low_latch;
+};
+
+// Debounced battery charge status
+struct tracker_retained_battery_t {
+    uint8_t charge_status;
+    bool past_warn_limit;
+};
+
+struct tracker_retained_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    uint32_t crc;               // Covers every field that follows
+    uint32_t uptime_sec;        // Uptime when saved
+    uint32_t time;              // Unix time when saved, zero if not valid
+    tracker_retained_location_t location;
+    tracker_retained_sleep_t sleep;
+    tracker_retained_temperature_t temperature;
+    tracker_retained_battery_t battery;
+};
+
+/**
+ * @brief Snapshot of application state kept in retained memory so that a reset resumes where
+ * the previous boot left off.
+ *
+ */
+class TrackerRetained
+{
+    public:
+        /**
+         * @brief Return instance of the tracker retained object
+         *
+         * @retval TrackerRetained&
+         */
+        static TrackerRetained &instance()
+        {
+            if(!_instance)
+            {
+                _instance = new TrackerRetained();
+            }
+            return *_instance;
+        }
+
+        /**
+         * @brief Validate the snapshot left by the previous boot, call once early in initialization
+         *
+         * @return true Snapshot is valid and may be restored from
+         * @return false Cold boot, the snapshot is discarded
+         */
+        bool restore();
+
+        /**
+         * @brief Indicate if a valid snapshot was found on boot
+         *
+         * @return true Snapshot is valid
+         * @return false Cold boot
+         */
+        bool isRestored() const
+        {
+            return _restored;
+        }
+
+        /**
+         * @brief Convert an uptime, in seconds, from the snapshot to the current boot
+         *
+         * The result may lie before boot and relies on unsigned arithmetic for differences.
+         *
+         * @param uptime Uptime, in seconds, saved in the snapshot
+         * @return uint32_t Equivalent uptime in the current boot
+         */
+        uint32_t rebase(uint32_t uptime) const;
+
+        /**
+         * @brief Get the snapshot sections for reading or update
+         *
+         * @return tracker_retained_t& Snapshot
+         */
+        tracker_retained_t &data()
+        {
+            return _data;
+        }
+
+        /**
+         * @brief Seal the snapshot after its sections have been updated
+         *
+         */
+        void save();
+
+        /**
+         * @brief Discard the snapshot so that the next boot is a cold boot
+         *
+         */
+        void invalidate();
+
+    private:
+        TrackerRetained();
+        static TrackerRetained *_instance;
+
+        tracker_retained_t &_data;
+        uint32_t _elapsedSec;
+        bool _restored;
+};
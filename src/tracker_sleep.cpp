@@ -18,9 +18,11 @@
 #include "cloud_service.h"
 #include "tracker_location.h"
 #include "tracker.h"
+#include "tracker_energy.h"
 
 // Private constants
 constexpr system_tick_t TrackerSleepMinSleepDuration = 1000; // milliseconds
+constexpr uint32_t TrackerSleepSlowCallbackMicros = 10 * 1000; // microseconds
 
 TrackerSleep *TrackerSleep::_instance = nullptr;
 
@@ -55,7 +57,8 @@ int TrackerSleep::init(SleepWatchdogCallback watchdog) {
         &_config_state.mode
       ),
       ConfigInt("exe_min", &_config_state.execute_min_seconds, TrackerSleepDefaultExeMinTime, TrackerSleepDefaultMaxTime),
-      ConfigInt("conn_max", &_config_state.connecting_max_seconds, TrackerSleepDefaultConnMaxTime, TrackerSleepDefaultMaxTime)
+      ConfigInt("conn_max", &_config_state.connecting_max_seconds, TrackerSleepDefaultConnMaxTime, TrackerSleepDefaultMaxTime),
+      ConfigInt("warm_max", &_config_state.warm_max_seconds, 0, TrackerSleepDefaultMaxTime)
     }
   );
 
@@ -77,39 +80,48 @@ int TrackerSleep::init(SleepWatchdogCallback watchdog) {
 
 TrackerSleepError TrackerSleep::updateNextWake(uint64_t milliseconds) {
   // A input value of 0 means that the requestor wants to cancel the current sleep cycle, pass through
-  // the sleep state and re-enter the execution phase
+  // the sleep state and re-enter the execution phase.  The cancellation holds even if other modules
+  // request a wake afterwards.
   if (milliseconds == 0) {
+    _wakeSchedule.cancel();
     _nextWakeMs = 0;
     return TrackerSleepError::NONE;
   }
 
-  // This function performs a basic priority scheduler calculation based on the next scheduled wake
-  // time versus the requested value from the caller.  Any action for sleep evaluation is performed in
-  // the future so the only comparison to present time would be the requested value.  The next wake
-  // time is compared to the future present time later on.
+  // Requests without a name or tolerance share one window that keeps the soonest time
+  return scheduleWake(nullptr, milliseconds, milliseconds);
+}
+
+TrackerSleepError TrackerSleep::scheduleWake(const char* name, uint64_t earliestMs, uint64_t latestMs) {
+  // Any action for sleep evaluation is performed in the future so the only comparison to present time
+  // would be the requested value.  The next wake time is compared to the future present time later on.
   uint64_t now = System.millis();
 
   // Nothing from the past makes sense
-  if (milliseconds <= now) {
+  if (latestMs <= now) {
     return TrackerSleepError::TIME_IN_PAST;
   }
-  // Anything evaluated past this point assumes the requested wake time is in the future
-
-  // We want to capture the very first wake request after waking or a subsequent time that is
-  // sooner than one already established.
-  if (_nextWakeMs == 0) {
-    _nextWakeMs = milliseconds;
+  if (earliestMs > latestMs) {
+    earliestMs = latestMs;
   }
-  else {
-    if (milliseconds > _nextWakeMs) {
-      return TrackerSleepError::TIME_SKIPPED;
-    }
-    else {
-      _nextWakeMs = milliseconds;
-    }
+
+  if (_wakeSchedule.add(name, earliestMs, latestMs) != SYSTEM_ERROR_NONE) {
+    Log.error("unable to schedule wake for %s", (name) ? name : "-");
+    return TrackerSleepError::TIME_SKIPPED;
   }
 
-  return TrackerSleepError::NONE;
+  // The schedule wakes at the most urgent latest time, coalescing every window open at that time
+  _nextWakeMs = _wakeSchedule.getWakeMs();
+
+  return (latestMs > _nextWakeMs) ? TrackerSleepError::TIME_SKIPPED : TrackerSleepError::NONE;
+}
+
+TrackerSleepError TrackerSleep::wakeWithin(const char* name, uint64_t earliestMs, uint64_t latestMs) {
+  return scheduleWake(name, earliestMs, latestMs);
+}
+
+TrackerSleepError TrackerSleep::wakeWithinSeconds(const char* name, unsigned int earliestSeconds, unsigned int latestSeconds) {
+  return scheduleWake(name, (uint64_t)earliestSeconds * 1000, (uint64_t)latestSeconds * 1000);
 }
 
 TrackerSleepError TrackerSleep::wakeAtSeconds(unsigned int uptimeSeconds) {
@@ -141,6 +153,13 @@ int TrackerSleep::wakeFor(pin_t pin, InterruptMode mode) {
   return SYSTEM_ERROR_NONE;
 }
 
+int TrackerSleep::allowBriefWake(pin_t pin) {
+  if (!_briefPins.contains(pin)) {
+    _briefPins.append(pin);
+  }
+  return SYSTEM_ERROR_NONE;
+}
+
 int TrackerSleep::wakeFor(SystemSleepFlag flag) {
   _onFlag.append(flag);
   return SYSTEM_ERROR_NONE;
@@ -196,34 +215,83 @@ int TrackerSleep::ignoreBle() {
   return SYSTEM_ERROR_NONE;
 }
 
-int TrackerSleep::registerSleepPrepare(SleepCallback callback) {
-  _onSleepPrepare.append(callback);
+int TrackerSleepCallbacks::add(SleepCallback callback, const char* name, int priority) {
+  CHECK_TRUE(_count < TrackerSleepMaxCallbacks, SYSTEM_ERROR_LIMIT_EXCEEDED);
+
+  // Keep the list in call order, after any callbacks of the same priority
+  size_t index = _count;
+  while ((index > 0) && (_entries[index - 1].stats.priority > priority)) {
+    _entries[index] = std::move(_entries[index - 1]);
+    index--;
+  }
+  _entries[index].callback = std::move(callback);
+  _entries[index].stats = {
+    .name = name,
+    .priority = priority,
+    .calls = 0,
+    .lastMicros = 0,
+    .maxMicros = 0,
+  };
+  _count++;
+
   return SYSTEM_ERROR_NONE;
 }
 
-int TrackerSleep::registerSleepCancel(SleepCallback callback) {
-  _onSleepCancel.append(callback);
-  return SYSTEM_ERROR_NONE;
+void TrackerSleepCallbacks::call(const TrackerSleepContext& context) {
+  for (size_t i = 0; i < _count; i++) {
+    auto& entry = _entries[i];
+    auto start = micros();
+    entry.callback(context);
+    auto elapsed = (uint32_t)(micros() - start);
+
+    entry.stats.calls++;
+    entry.stats.lastMicros = elapsed;
+    if (elapsed > entry.stats.maxMicros) {
+      entry.stats.maxMicros = elapsed;
+    }
+    if (elapsed >= TrackerSleepSlowCallbackMicros) {
+      Log.trace("%s callback took %lu us", (entry.stats.name) ? entry.stats.name : "unnamed", elapsed);
+    }
+  }
 }
 
-int TrackerSleep::registerSleep(SleepCallback callback) {
-  _onSleep.append(callback);
-  return SYSTEM_ERROR_NONE;
+int TrackerSleep::registerSleepPrepare(SleepCallback callback, const char* name, int priority) {
+  return _onSleepPrepare.add(callback, name, priority);
 }
 
-int TrackerSleep::registerWake(SleepCallback callback) {
-  _onWake.append(callback);
-  return SYSTEM_ERROR_NONE;
+int TrackerSleep::registerSleepCancel(SleepCallback callback, const char* name, int priority) {
+  return _onSleepCancel.add(callback, name, priority);
 }
 
-int TrackerSleep::registerStateChange(SleepCallback callback) {
-  _onStateTransition.append(callback);
-  return SYSTEM_ERROR_NONE;
+int TrackerSleep::registerSleep(SleepCallback callback, const char* name, int priority) {
+  return _onSleep.add(callback, name, priority);
+}
+
+int TrackerSleep::registerWake(SleepCallback callback, const char* name, int priority) {
+  return _onWake.add(callback, name, priority);
+}
+
+int TrackerSleep::registerStateChange(SleepCallback callback, const char* name, int priority) {
+  return _onStateTransition.add(callback, name, priority);
+}
+
+const TrackerSleepCallbacks& TrackerSleep::getCallbacks(TrackerSleepCallbackType type) {
+  switch (type) {
+    case TrackerSleepCallbackType::PREPARE:   return _onSleepPrepare;
+    case TrackerSleepCallbackType::CANCEL:    return _onSleepCancel;
+    case TrackerSleepCallbackType::SLEEP:     return _onSleep;
+    case TrackerSleepCallbackType::WAKE:      return _onWake;
+    default:                                  return _onStateTransition;
+  }
 }
 
 void TrackerSleep::startModem() {
-  Log.info("Starting modem");
-  _lastModemOnMs = System.millis();
+  // A modem kept on through sleep is still registered and needs no attach
+  if (!_inFullWakeup) {
+    Log.info("Starting modem");
+    _lastModemOnMs = System.millis();
+    _reconnectMeasured = false;
+  }
   Particle.connect();
   _inFullWakeup = true;
 }
@@ -238,9 +306,31 @@ void TrackerSleep::stopModem() {
   _inFullWakeup = false;
 }
 
+bool TrackerSleep::shouldKeepModemWarm(system_tick_t sleepMs) {
+  if (!_modemWarmAllowed ||
+      (_config_state.warm_max_seconds <= 0) ||
+      (sleepMs > (system_tick_t)_config_state.warm_max_seconds * 1000) ||
+      _pendingShutdown || _pendingReset ||
+      !Particle.connected()) {
+    return false;
+  }
+
+  // Reconnecting draws the full modem current for the measured connection time while staying
+  // registered draws the idle current for the whole sleep
+  EnergyModel model;
+  TrackerEnergy::instance().getModel(model);
+  float reconnectCost = model.current[(size_t)EnergyComponent::MODEM] * (float)_reconnectCostMs;
+  float warmCost = model.current[(size_t)EnergyComponent::MODEM_IDLE] * (float)sleepMs;
+
+  return (warmCost < reconnectCost);
+}
+
 TrackerSleepResult TrackerSleep::sleep() {
   TrackerSleepResult retval;
 
+  // Decided again on wake
+  _briefWake = false;
+
   SystemSleepConfiguration config;
 
   // Prepare to call all of the registered sleep prep callbacks with the same message
@@ -256,9 +346,8 @@ TrackerSleepResult TrackerSleep::sleep() {
   // Full wakeup is requested only after this point
   _fullWakeupOverride = false;
 
-  for (auto callback : _onSleepPrepare) {
-    callback(sleepContext);
-  }
+  _onSleepPrepare.call(sleepContext);
+  _wakeSchedule.dump();
 
   // We need to calculate the sleep duration based on the absolute uptime in milliseconds and how much time we need
   // to wake beforehand to power on the cellular modem and GNSS module.
@@ -287,11 +376,10 @@ TrackerSleepResult TrackerSleep::sleep() {
       .modemOnMs = _lastModemOnMs,
     };
 
-    for (auto callback : _onSleepCancel) {
-      callback(sleepCancelContext);
-    }
+    _onSleepCancel.call(sleepCancelContext);
 
     // The next wake time is now invalid and should be treated uninitialized
+    _wakeSchedule.clear();
     _nextWakeMs = 0;
     retval.error = TrackerSleepError::CANCELLED;
     return retval;
@@ -306,7 +394,10 @@ TrackerSleepResult TrackerSleep::sleep() {
     config.gpio(pin.first, pin.second);
   }
 
-  if (_onNetwork) {
+  // Short sleeps keep the modem registered and wake on network activity instead of paying for another attach
+  _modemWarm = shouldKeepModemWarm(duration);
+
+  if (_onNetwork || _modemWarm) {
     config.network(NETWORK_INTERFACE_CELLULAR);
   }
 
@@ -314,7 +405,12 @@ TrackerSleepResult TrackerSleep::sleep() {
     config.ble();
   }
 
-  stopModem();
+  if (_modemWarm) {
+    Log.info("keeping modem on for %lu milliseconds of sleep", duration);
+  }
+  else {
+    stopModem();
+  }
 
   TrackerSleepContext sleepNowContext = {
     .reason = TrackerSleepReason::SLEEP,
@@ -325,9 +421,7 @@ TrackerSleepResult TrackerSleep::sleep() {
     .modemOnMs = _lastModemOnMs,
   };
 
-  for (auto callback : _onSleep) {
-    callback(sleepNowContext);
-  }
+  _onSleep.call(sleepNowContext);
 
   (void)Tracker::instance().prepareSleep();
 
@@ -365,8 +459,17 @@ TrackerSleepResult TrackerSleep::sleep() {
 
   // Our loop count restarts to indicate that we are executing out of sleep
   _loopCount = 0;
+  _wakeSchedule.clear();
   _nextWakeMs = 0;
-  _inFullWakeup = false;
+  // A modem kept on through sleep makes this a full wake cycle already
+  _inFullWakeup = _modemWarm;
+  _modemWarm = false;
+
+  // A wake from a pin that only needs its event handled can go back to sleep almost immediately
+  _wakeupReason = retval.result.wakeupReason();
+  _briefWake = !_inFullWakeup &&
+    (_wakeupReason == SystemSleepWakeupReason::BY_GPIO) &&
+    _briefPins.contains(retval.result.wakeupPin());
 
   // Call all registered callbacks for wake and provide a common context
   TrackerSleepContext wakeContext = {
@@ -378,9 +481,7 @@ TrackerSleepResult TrackerSleep::sleep() {
     .modemOnMs = _lastModemOnMs,
   };
 
-  for (auto callback : _onWake) {
-    callback(wakeContext);
-  }
+  _onWake.call(wakeContext);
 
   retval.error = TrackerSleepError::NONE;
   return retval;
@@ -388,6 +489,7 @@ TrackerSleepResult TrackerSleep::sleep() {
 
 void TrackerSleep::stateToConnecting() {
   _fullWakeupOverride = false;
+  _briefWake = false;
   _executionState = TrackerExecutionState::CONNECTING;
   _lastConnectingSec = System.uptime();
   _publishFlag = false;
@@ -403,9 +505,7 @@ void TrackerSleep::stateToConnecting() {
     .modemOnMs = _lastModemOnMs,
   };
 
-  for (auto callback : _onStateTransition) {
-    callback(stateContext);
-  }
+  _onStateTransition.call(stateContext);
 }
 
 void TrackerSleep::stateToExecute() {
@@ -421,9 +521,7 @@ void TrackerSleep::stateToExecute() {
     .modemOnMs = _lastModemOnMs,
   };
 
-  for (auto callback : _onStateTransition) {
-    callback(stateContext);
-  }
+  _onStateTransition.call(stateContext);
 }
 
 void TrackerSleep::stateToSleep() {
@@ -438,9 +536,7 @@ void TrackerSleep::stateToSleep() {
     .modemOnMs = _lastModemOnMs,
   };
 
-  for (auto callback : _onStateTransition) {
-    callback(stateContext);
-  }
+  _onStateTransition.call(stateContext);
 }
 
 void TrackerSleep::stateToShutdown() {
@@ -455,9 +551,7 @@ void TrackerSleep::stateToShutdown() {
     .modemOnMs = _lastModemOnMs,
   };
 
-  for (auto callback : _onStateTransition) {
-    callback(stateContext);
-  }
+  _onStateTransition.call(stateContext);
 
   _lastShutdownMs = millis();
 }
@@ -474,9 +568,7 @@ void TrackerSleep::stateToReset() {
     .modemOnMs = _lastModemOnMs,
   };
 
-  for (auto callback : _onStateTransition) {
-    callback(stateContext);
-  }
+  _onStateTransition.call(stateContext);
 
   _lastResetMs = millis();
 }
@@ -510,9 +602,15 @@ int TrackerSleep::loop() {
      *-----------------------------------------------------------------------------------------------------------------
      */
     case TrackerExecutionState::CONNECTING: {
+      if (!_reconnectMeasured && Particle.connected()) {
+        _reconnectMeasured = true;
+        _lastCloudConnectMs = System.millis();
+        _reconnectCostMs = (system_tick_t)(_lastCloudConnectMs - _lastModemOnMs);
+        Log.trace("reconnected in %lu milliseconds", _reconnectCostMs);
+      }
       if (_pendingPublishVitals && Particle.connected()) {
         _pendingPublishVitals = false;
-        Particle.publishVitals();
+        TrackerEnergy::instance().publishVitals();
       }
       if (_publishFlag && Particle.connected()) {
         _publishFlag = false;
@@ -562,7 +660,13 @@ int TrackerSleep::loop() {
           stateToReset();
         }
 
-        if (!_holdSleep &&
+        if (!_holdSleep && _briefWake &&
+            (System.millis() - std::max(_lastWakeMs, _briefWakeExtendMs) >= TrackerSleepBriefWakeDuration)) {
+
+            Log.trace("brief wake handled and transitioning to SLEEP");
+            stateToSleep();
+        }
+        else if (!_holdSleep &&
             (System.uptime() - _lastExecuteSec >= _executeDurationSec)) {
 
             Log.trace("EXECUTE time expired and transitioning to SLEEP");
@@ -575,7 +679,7 @@ int TrackerSleep::loop() {
 
         if (_pendingPublishVitals && Particle.connected()) {
           _pendingPublishVitals = false;
-          Particle.publishVitals();
+          TrackerEnergy::instance().publishVitals();
         }
 
         if (_pendingShutdown) {
@@ -626,7 +730,7 @@ int TrackerSleep::loop() {
     case TrackerExecutionState::SHUTDOWN: {
       if (_pendingPublishVitals && Particle.connected()) {
         _pendingPublishVitals = false;
-        Particle.publishVitals();
+        TrackerEnergy::instance().publishVitals();
       }
       if ((_publishFlag && Particle.connected()) ||
           (millis() - _lastShutdownMs >= TrackerSleepShutdownTimeout)) {
@@ -648,7 +752,7 @@ int TrackerSleep::loop() {
     case TrackerExecutionState::RESET: {
       if (_pendingPublishVitals && Particle.connected()) {
         _pendingPublishVitals = false;
-        Particle.publishVitals();
+        TrackerEnergy::instance().publishVitals();
       }
       if ((_publishFlag && Particle.connected()) ||
           (millis() - _lastResetMs >= TrackerSleepResetTimeout)) {
@@ -19,6 +19,8 @@
 #include "Particle.h"
 #include "tracker_config.h"
 #include "config_service.h"
+#include "wake_schedule.h"
+#include "tracker_retained.h"
 
 
 /**
@@ -36,6 +38,9 @@ constexpr TrackerSleepMode TrackerSleepDefaultMode = TrackerSleepMode::Disable;
 constexpr int32_t TrackerSleepDefaultExeMinTime = 10; // seconds
 constexpr int32_t TrackerSleepDefaultConnMaxTime = 90; // seconds
 constexpr int32_t TrackerSleepDefaultMaxTime = 86400; // seconds
+constexpr int32_t TrackerSleepDefaultWarmMaxTime = 0; // seconds, off
+constexpr system_tick_t TrackerSleepDefaultReconnectCost = 30 * 1000; // milliseconds
+constexpr system_tick_t TrackerSleepBriefWakeDuration = 100; // milliseconds
 constexpr system_tick_t TrackerSleepGracefulTimeout = 5 * 1000; // milliseconds
 constexpr system_tick_t TrackerSleepShutdownTimeout = 4 * 1000; // milliseconds
 constexpr system_tick_t TrackerSleepResetTimeout = 5 * 1000; // milliseconds
@@ -45,6 +50,7 @@ struct tracker_sleep_config_t {
     TrackerSleepMode mode;
     int32_t execute_min_seconds;
     int32_t connecting_max_seconds;
+    int32_t warm_max_seconds; // 0 = never keep the modem warm through sleep
 };
 
 /**
@@ -108,6 +114,93 @@ using SleepWatchdogCallback = std::function<void(bool enable)>;
  */
 using SleepCallback = std::function<void(TrackerSleepContext context)>;
 
+// Callbacks of each kind that can be registered
+constexpr size_t TrackerSleepMaxCallbacks = 8;
+
+// Callbacks run in ascending order of priority and in order of registration for equal priorities
+constexpr int TrackerSleepCallbackPriorityFirst = -100;
+constexpr int TrackerSleepCallbackPriorityDefault = 0;
+constexpr int TrackerSleepCallbackPriorityLast = 100;
+
+/**
+ * @brief Timing statistics for a registered callback.
+ *
+ */
+struct TrackerSleepCallbackStats {
+  const char* name;               /**< Name given at registration, may be nullptr */
+  int priority;                   /**< Priority given at registration */
+  uint32_t calls;                 /**< Count of calls */
+  uint32_t lastMicros;            /**< Duration, in microseconds, of the last call */
+  uint32_t maxMicros;             /**< Longest duration, in microseconds, of any call */
+};
+
+/**
+ * @brief Fixed capacity, priority ordered list of sleep callbacks that times each call.
+ *
+ */
+class TrackerSleepCallbacks {
+public:
+  TrackerSleepCallbacks() : _count(0) {}
+
+  /**
+   * @brief Add a callback.
+   *
+   * @param callback Function to call
+   * @param name Name reported with timing statistics, must remain valid
+   * @param priority Order of the call relative to other callbacks
+   * @retval SYSTEM_ERROR_NONE
+   * @retval SYSTEM_ERROR_LIMIT_EXCEEDED
+   */
+  int add(SleepCallback callback, const char* name, int priority);
+
+  /**
+   * @brief Call every callback, in priority order, with the given context.
+   *
+   * @param context Context passed to every callback
+   */
+  void call(const TrackerSleepContext& context);
+
+  /**
+   * @brief Get the count of registered callbacks.
+   *
+   * @return size_t Count of callbacks
+   */
+  size_t size() const {
+    return _count;
+  }
+
+  /**
+   * @brief Get timing statistics of a callback.
+   *
+   * @param index Index, in call order, less than size()
+   * @return const TrackerSleepCallbackStats& Statistics
+   */
+  const TrackerSleepCallbackStats& stats(size_t index) const {
+    return _entries[index].stats;
+  }
+
+private:
+  struct Entry {
+    SleepCallback callback;
+    TrackerSleepCallbackStats stats;
+  };
+
+  Entry _entries[TrackerSleepMaxCallbacks];
+  size_t _count;
+};
+
+/**
+ * @brief Kinds of sleep callbacks.
+ *
+ */
+enum class TrackerSleepCallbackType {
+  PREPARE,                        /**< Called while preparing for sleep */
+  CANCEL,                         /**< Called after cancelling sleep */
+  SLEEP,                          /**< Called immediately prior to sleep */
+  WAKE,                           /**< Called immediately after waking */
+  STATE,                          /**< Called after sleep state changes */
+};
+
 /**
  * @brief Execution states for sleep
  *
@@ -183,6 +276,16 @@ public:
     return _config_state.connecting_max_seconds;
   }
 
+  /**
+   * @brief Override whether the modem may be kept registered through sleep, without changing
+   * the sleep configuration.
+   *
+   * @param allow Modem may be kept warm when the configuration and energy model allow it
+   */
+  void allowModemWarm(bool allow) {
+    _modemWarmAllowed = allow;
+  }
+
   /**
    * @brief Schedules system wake at specific time in relation to System.uptime().
    *
@@ -227,6 +330,43 @@ public:
    */
   TrackerSleepError wakeAt(std::chrono::milliseconds ms);
 
+  /**
+   * @brief Schedules system wake, on behalf of a named module, anywhere within a window of time in
+   * relation to System.millis().  Windows that overlap the most urgent request are served by the
+   * same wake so that flexible requests should give as wide a window as they can tolerate.  A later
+   * request with the same name replaces the earlier one.
+   *
+   * @param name Name of the requesting module.  Must remain valid until the system sleeps.
+   * @param earliestMs Earliest acceptable wake time, in milliseconds.
+   * @param latestMs Latest acceptable wake time, in milliseconds.
+   * @retval TrackerSleepError::NONE Window was scheduled and sets the wake time
+   * @retval TrackerSleepError::TIME_IN_PAST Given window closed in the past
+   * @retval TrackerSleepError::TIME_SKIPPED Given window was scheduled but a sooner request sets the wake time
+   */
+  TrackerSleepError wakeWithin(const char* name, uint64_t earliestMs, uint64_t latestMs);
+
+  /**
+   * @brief Schedules system wake, on behalf of a named module, anywhere within a window of time in
+   * relation to System.uptime().
+   *
+   * @param name Name of the requesting module.  Must remain valid until the system sleeps.
+   * @param earliestSeconds Earliest acceptable wake time, in seconds.
+   * @param latestSeconds Latest acceptable wake time, in seconds.
+   * @retval TrackerSleepError::NONE Window was scheduled and sets the wake time
+   * @retval TrackerSleepError::TIME_IN_PAST Given window closed in the past
+   * @retval TrackerSleepError::TIME_SKIPPED Given window was scheduled but a sooner request sets the wake time
+   */
+  TrackerSleepError wakeWithinSeconds(const char* name, unsigned int earliestSeconds, unsigned int latestSeconds);
+
+  /**
+   * @brief Get the wake requests made while preparing for the current, or last, sleep cycle.
+   *
+   * @return const WakeSchedule& Schedule of wake requests
+   */
+  const WakeSchedule& getWakeSchedule() {
+    return _wakeSchedule;
+  }
+
   /**
    * @brief Enables system wake for a pin change.
    *
@@ -259,6 +399,16 @@ public:
    */
   int wakeForBle();
 
+  /**
+   * @brief Allow a wake caused only by this pin to be brief.  Such wakes skip all but the handling of
+   * the pin event and return to sleep after TrackerSleepBriefWakeDuration unless a full wake is requested
+   * or sleep is held.
+   *
+   * @param pin System pin, also enabled with wakeFor(), whose wakes may be brief.
+   * @retval SYSTEM_ERROR_NONE
+   */
+  int allowBriefWake(pin_t pin);
+
   /**
    * @brief Disables system wake for a pin change.
    *
@@ -336,45 +486,81 @@ public:
     return _executeDurationSec;
   }
 
+  /**
+   * @brief End the execution phase now rather than waiting out the remaining execution time.  Only
+   * applies while executing, later publishes extend execution as usual.
+   *
+   * @return uint32_t The new execution time.
+   */
+  uint32_t endExecution() {
+    if (_executionState != TrackerExecutionState::EXECUTION) {
+      return _executeDurationSec;
+    }
+    return extendExecutionFromNow(0, true);
+  }
+
   /**
    * @brief Register a callback to be called while preparing for sleep.
    *
    * @param callback Function to call on sleep preparation
+   * @param name Name reported with callback timing
+   * @param priority Order of the call relative to other callbacks, lowest first
    * @retval SYSTEM_ERROR_NONE
+   * @retval SYSTEM_ERROR_LIMIT_EXCEEDED
    */
-  int registerSleepPrepare(SleepCallback callback);
+  int registerSleepPrepare(SleepCallback callback, const char* name = nullptr, int priority = TrackerSleepCallbackPriorityDefault);
 
   /**
    * @brief Register a callback to be called immediately after cancelling sleep.
    *
    * @param callback Function to call on sleep cancellation
+   * @param name Name reported with callback timing
+   * @param priority Order of the call relative to other callbacks, lowest first
    * @retval SYSTEM_ERROR_NONE
+   * @retval SYSTEM_ERROR_LIMIT_EXCEEDED
    */
-  int registerSleepCancel(SleepCallback callback);
+  int registerSleepCancel(SleepCallback callback, const char* name = nullptr, int priority = TrackerSleepCallbackPriorityDefault);
 
   /**
    * @brief Register a callback to be called immediately prior to going to sleep.
    *
    * @param callback Function to call on sleep
+   * @param name Name reported with callback timing
+   * @param priority Order of the call relative to other callbacks, lowest first
    * @retval SYSTEM_ERROR_NONE
+   * @retval SYSTEM_ERROR_LIMIT_EXCEEDED
    */
-  int registerSleep(SleepCallback callback);
+  int registerSleep(SleepCallback callback, const char* name = nullptr, int priority = TrackerSleepCallbackPriorityDefault);
 
   /**
    * @brief Register a callback to be called immediately after returning sleep.
    *
    * @param callback Function to call on sleep completion
+   * @param name Name reported with callback timing
+   * @param priority Order of the call relative to other callbacks, lowest first
    * @retval SYSTEM_ERROR_NONE
+   * @retval SYSTEM_ERROR_LIMIT_EXCEEDED
    */
-  int registerWake(SleepCallback callback);
+  int registerWake(SleepCallback callback, const char* name = nullptr, int priority = TrackerSleepCallbackPriorityDefault);
 
   /**
    * @brief Register a callback to be called immediately after sleep state change.
    *
    * @param callback Function to call on sleep state change
+   * @param name Name reported with callback timing
+   * @param priority Order of the call relative to other callbacks, lowest first
    * @retval SYSTEM_ERROR_NONE
+   * @retval SYSTEM_ERROR_LIMIT_EXCEEDED
    */
-  int registerStateChange(SleepCallback callback);
+  int registerStateChange(SleepCallback callback, const char* name = nullptr, int priority = TrackerSleepCallbackPriorityDefault);
+
+  /**
+   * @brief Get the registered callbacks, and their timing, of the given kind.
+   *
+   * @param type Kind of callbacks
+   * @return const TrackerSleepCallbacks& Registered callbacks
+   */
+  const TrackerSleepCallbacks& getCallbacks(TrackerSleepCallbackType type);
 
   /**
    * @brief Indicate that the current connecting/execution phase has cellular modem and GNSS powered.
@@ -401,6 +587,74 @@ public:
     return SYSTEM_ERROR_NONE;
   }
 
+  /**
+   * @brief Indicate that the current wake was caused only by a pin allowed to wake briefly and nothing
+   * has asked for more time yet.
+   *
+   * @return true Only the wake source needs handling before sleeping again.
+   * @return false Normal execution.
+   */
+  bool isBriefWake() {
+    return _briefWake;
+  }
+
+  /**
+   * @brief Keep a brief wake open for another TrackerSleepBriefWakeDuration.  Call from each loop for as
+   * long as work started by the wake event must finish before sleeping again.
+   *
+   */
+  void extendBriefWake() {
+    _briefWakeExtendMs = System.millis();
+  }
+
+  /**
+   * @brief Get the reason for the last wake from sleep.
+   *
+   * @return SystemSleepWakeupReason Reason for last wake.
+   */
+  SystemSleepWakeupReason getWakeupReason() {
+    return _wakeupReason;
+  }
+
+  /**
+   * @brief Indicate whether the cellular modem stays registered through the current, or upcoming, sleep.
+   *
+   * @return true Modem is kept on and the system wakes on network activity.
+   * @return false Modem is powered down for sleep.
+   */
+  bool isModemKeptWarm() {
+    return _modemWarm;
+  }
+
+  /**
+   * @brief Get the measured time to connect to the cloud after powering the modem on.
+   *
+   * @return system_tick_t Reconnect time, in milliseconds
+   */
+  system_tick_t getReconnectCost() {
+    return _reconnectCostMs;
+  }
+
+  /**
+   * @brief Save learned state to the retained snapshot.
+   *
+   * @param state Retained sleep section
+   */
+  void saveRetained(tracker_retained_sleep_t& state) {
+    state.reconnect_cost_ms = _reconnectCostMs;
+  }
+
+  /**
+   * @brief Resume learned state from the retained snapshot.
+   *
+   * @param state Retained sleep section
+   */
+  void restoreRetained(const tracker_retained_sleep_t& state) {
+    if (state.reconnect_cost_ms) {
+      _reconnectCostMs = state.reconnect_cost_ms;
+    }
+  }
+
   /**
    * @brief Instruct TrackerSleep to power down the system after the current execution cycle.
    *
@@ -447,15 +701,21 @@ private:
     _fullWakeupOverride(false),
     _inFullWakeup(true),
     _holdSleep(false),
+    _briefWake(false),
     _pendingPublishVitals(false),
     _pendingShutdown(false),
     _pendingReset(false),
+    _modemWarm(false),
+    _modemWarmAllowed(true),
+    _reconnectMeasured(true),
+    _reconnectCostMs(TrackerSleepDefaultReconnectCost),
     _executionState(TrackerExecutionState::BOOT),
     _lastConnectingSec(0),
     _lastExecuteSec(0),
     _executeDurationSec(0),
     _nextWakeMs(0),
     _lastWakeMs(0),
+    _briefWakeExtendMs(0),
     _lastRequestedWakeMs(0),
     _lastSleepMs(0),
     _lastModemOnMs(0),
@@ -470,6 +730,7 @@ private:
           .mode                     = TrackerSleepDefaultMode,
           .execute_min_seconds      = TrackerSleepDefaultExeMinTime,
           .connecting_max_seconds   = TrackerSleepDefaultConnMaxTime,
+          .warm_max_seconds         = TrackerSleepDefaultWarmMaxTime,
       };
     }
 
@@ -518,6 +779,18 @@ private:
    */
   TrackerSleepError updateNextWake(uint64_t milliseconds);
 
+  /**
+   * @brief Adds a wake window to the schedule and updates the next wake time.
+   *
+   * @param name Name of the requesting module or nullptr.
+   * @param earliestMs Earliest acceptable wake time, in milliseconds.
+   * @param latestMs Latest acceptable wake time, in milliseconds.
+   * @retval TrackerSleepError::NONE Window was scheduled and sets the wake time
+   * @retval TrackerSleepError::TIME_IN_PAST Given window closed in the past
+   * @retval TrackerSleepError::TIME_SKIPPED Given window was scheduled but a sooner request sets the wake time
+   */
+  TrackerSleepError scheduleWake(const char* name, uint64_t earliestMs, uint64_t latestMs);
+
   /**
    * @brief Prepare for sleep and wakeup.
    *
@@ -525,6 +798,16 @@ private:
    */
   TrackerSleepResult sleep();
 
+  /**
+   * @brief Decide whether keeping the modem registered through a sleep of the given length draws less
+   * charge than tearing it down and reconnecting afterwards.
+   *
+   * @param sleepMs Predicted sleep duration, in milliseconds.
+   * @return true Keep the modem on through sleep
+   * @return false Power the modem off for sleep
+   */
+  bool shouldKeepModemWarm(system_tick_t sleepMs);
+
   /**
    * @brief Transition to CONNECTING state
    *
@@ -574,14 +857,15 @@ private:
   SleepWatchdogCallback _watchdog;
 
   // Callback containers for sleep and wake
-  Vector<SleepCallback> _onSleepPrepare;
-  Vector<SleepCallback> _onSleepCancel;
-  Vector<SleepCallback> _onSleep;
-  Vector<SleepCallback> _onWake;
-  Vector<SleepCallback> _onStateTransition;
+  TrackerSleepCallbacks _onSleepPrepare;
+  TrackerSleepCallbacks _onSleepCancel;
+  TrackerSleepCallbacks _onSleep;
+  TrackerSleepCallbacks _onWake;
+  TrackerSleepCallbacks _onStateTransition;
 
   // Sleep conditions
   Vector<std::pair<pin_t,InterruptMode>> _onPin;
+  Vector<pin_t> _briefPins;
   Vector<SystemSleepFlag> _onFlag;
   bool _onNetwork;
   bool _onBle;
@@ -595,17 +879,24 @@ private:
   bool _fullWakeupOverride;
   bool _inFullWakeup;
   bool _holdSleep;
+  bool _briefWake;
   bool _pendingPublishVitals;
   bool _pendingShutdown;
   bool _pendingReset;
+  bool _modemWarm;
+  bool _modemWarmAllowed;
+  bool _reconnectMeasured;
+  system_tick_t _reconnectCostMs;
   TrackerExecutionState _executionState;
   uint32_t _lastConnectingSec;
   uint32_t _lastExecuteSec;
   uint32_t _executeDurationSec;
   system_tick_t _lastShutdownMs;
   system_tick_t _lastResetMs;
+  WakeSchedule _wakeSchedule;
   uint64_t _nextWakeMs;
   uint64_t _lastWakeMs;
+  uint64_t _briefWakeExtendMs;
   uint64_t _lastRequestedWakeMs;
   uint64_t _lastSleepMs;
   uint64_t _lastModemOnMs;
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wake_schedule.h"
+#include <cstring>
+
+namespace {
+
+bool isSameName(const char* a, const char* b) {
+    if (!a || !b) {
+        return (a == b);
+    }
+    return !strcmp(a, b);
+}
+
+} // anonymous namespace
+
+WakeSchedule::WakeSchedule()
+    : count_(0),
+      cancelled_(false) {
+
+}
+
+int WakeSchedule::add(const char* name, uint64_t earliestMs, uint64_t latestMs) {
+    CHECK_TRUE(earliestMs <= latestMs, SYSTEM_ERROR_INVALID_ARGUMENT);
+
+    for (size_t i = 0; i < count_; i++) {
+        if (isSameName(requests_[i].name, name)) {
+            // Unnamed requests come from several modules so only the soonest one matters
+            if (!name && (requests_[i].latestMs <= latestMs)) {
+                return SYSTEM_ERROR_NONE;
+            }
+            remove(i);
+            break;
+        }
+    }
+
+    CHECK_TRUE(count_ < MAX_REQUESTS, SYSTEM_ERROR_LIMIT_EXCEEDED);
+
+    // Insert in order of latest time, then earliest time, so that ties resolve the same way every cycle
+    size_t index = count_;
+    while (index > 0) {
+        auto& previous = requests_[index - 1];
+        if ((previous.latestMs < latestMs) ||
+            ((previous.latestMs == latestMs) && (previous.earliestMs <= earliestMs))) {
+            break;
+        }
+        requests_[index] = previous;
+        index--;
+    }
+    requests_[index] = {name, earliestMs, latestMs};
+    count_++;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+void WakeSchedule::remove(size_t index) {
+    for (size_t i = index; i + 1 < count_; i++) {
+        requests_[i] = requests_[i + 1];
+    }
+    count_--;
+}
+
+void WakeSchedule::cancel() {
+    cancelled_ = true;
+}
+
+void WakeSchedule::clear() {
+    count_ = 0;
+    cancelled_ = false;
+}
+
+uint64_t WakeSchedule::getWakeMs() const {
+    if (cancelled_ || !count_) {
+        return 0;
+    }
+
+    // Waking any later would miss the most urgent request and waking any sooner could only
+    // close windows that are already open
+    return requests_[0].latestMs;
+}
+
+bool WakeSchedule::isServed(const WakeRequest& request) const {
+    auto wakeMs = getWakeMs();
+    return wakeMs && (request.earliestMs <= wakeMs);
+}
+
+size_t WakeSchedule::size() const {
+    return count_;
+}
+
+const WakeRequest& WakeSchedule::at(size_t index) const {
+    return requests_[index];
+}
+
+void WakeSchedule::dump() const {
+    if (cancelled_) {
+        Log.trace("wake schedule cancelled");
+    }
+    for (size_t i = 0; i < count_; i++) {
+        const auto& request = requests_[i];
+        Log.trace("wake %s: %lu to %lu ms%s",
+            (request.name) ? request.name : "-",
+            (uint32_t)request.earliestMs,
+            (uint32_t)request.latestMs,
+            isServed(request) ? ", served" : "");
+    }
+}
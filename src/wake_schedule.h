@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Particle.h"
+
+/**
+ * @brief Window of time in which a module needs the system to wake.
+ *
+ */
+struct WakeRequest {
+    const char* name;               /**< Name of the requesting module, must remain valid until the schedule is cleared */
+    uint64_t earliestMs;            /**< Earliest acceptable wake time, in milliseconds of System.millis() */
+    uint64_t latestMs;              /**< Latest acceptable wake time, in milliseconds of System.millis() */
+};
+
+/**
+ * @brief Schedule of named wake windows that are coalesced into a single wake time.
+ *
+ * The system wakes at the latest time that still satisfies the most urgent request.  Every other
+ * request whose window is open at that time is served by the same wake.  Requests are kept sorted
+ * by their latest time so that the schedule does not depend on the order in which they were made.
+ */
+class WakeSchedule {
+public:
+    static constexpr size_t MAX_REQUESTS = 8;
+
+    WakeSchedule();
+
+    /**
+     * @brief Add, or replace, the wake window for the given name
+     *
+     * Unnamed requests share a single window that keeps the soonest of them.
+     *
+     * @param name Name of the requesting module or nullptr
+     * @param earliestMs Earliest acceptable wake time, in milliseconds
+     * @param latestMs Latest acceptable wake time, in milliseconds
+     * @retval SYSTEM_ERROR_NONE
+     * @retval SYSTEM_ERROR_INVALID_ARGUMENT
+     * @retval SYSTEM_ERROR_LIMIT_EXCEEDED
+     */
+    int add(const char* name, uint64_t earliestMs, uint64_t latestMs);
+
+    /**
+     * @brief Cancel the upcoming sleep cycle until the schedule is cleared
+     *
+     */
+    void cancel();
+
+    /**
+     * @brief Remove all requests and any cancellation
+     *
+     */
+    void clear();
+
+    /**
+     * @brief Get the coalesced wake time
+     *
+     * @return uint64_t Wake time, in milliseconds, or 0 if there are no requests or sleep was cancelled
+     */
+    uint64_t getWakeMs() const;
+
+    /**
+     * @brief Indicate if the given request is served by the coalesced wake time
+     *
+     * @param request Request to check
+     * @return true Request window is open at the wake time
+     * @return false Request needs a later wake
+     */
+    bool isServed(const WakeRequest& request) const;
+
+    /**
+     * @brief Get the count of requests
+     *
+     * @return size_t Count of requests
+     */
+    size_t size() const;
+
+    /**
+     * @brief Get a request, ordered by latest wake time
+     *
+     * @param index Index of the request, less than size()
+     * @return const WakeRequest& Request
+     */
+    const WakeRequest& at(size_t index) const;
+
+    /**
+     * @brief Log the schedule
+     *
+     */
+    void dump() const;
+
+private:
+    void remove(size_t index);
+
+    WakeRequest requests_[MAX_REQUESTS];
+    size_t count_;
+    bool cancelled_;
+};
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+
+#include "test.h"
+#include "energy_ledger.h"
+#include "battery_estimator.h"
+
+namespace {
+
+constexpr uint64_t MsPerSecond = 1000;
+
+// Wake cycle of a tracker that publishes on a fixed interval and sleeps in between
+struct DutyCycle {
+    unsigned int intervalSec;       // Time between wakes, in seconds
+    unsigned int awakeSec;          // Time awake with the modem on, in seconds
+    unsigned int gnssSec;           // Time the GNSS receiver is on while awake, in seconds
+};
+
+uint32_t bit(EnergyComponent component) {
+    return 1UL << (size_t)component;
+}
+
+// Drive the ledger through one wake and sleep the way the tracker does
+void runCycle(EnergyLedger& ledger, const DutyCycle& duty, uint64_t nowMs) {
+    ledger.beginCycle(nowMs);
+    ledger.set(EnergyComponent::SLEEP, false, nowMs);
+    ledger.set(EnergyComponent::RUN, true, nowMs);
+    ledger.set(EnergyComponent::MODEM, true, nowMs);
+    ledger.set(EnergyComponent::GNSS, true, nowMs);
+    ledger.set(EnergyComponent::GNSS, false, nowMs + duty.gnssSec * MsPerSecond);
+    auto sleepMs = nowMs + duty.awakeSec * MsPerSecond;
+    ledger.set(EnergyComponent::MODEM, false, sleepMs);
+    ledger.set(EnergyComponent::RUN, false, sleepMs);
+    ledger.set(EnergyComponent::SLEEP, true, sleepMs);
+}
+
+// Battery life, in hours, worked out by hand for the duty cycle
+float analyticLife(const EnergyModel& model, const DutyCycle& duty, float capacityMah) {
+    auto& current = model.current;
+    auto mas = (current[(size_t)EnergyComponent::RUN] + current[(size_t)EnergyComponent::MODEM]) * duty.awakeSec
+        + current[(size_t)EnergyComponent::GNSS] * duty.gnssSec
+        + current[(size_t)EnergyComponent::SLEEP] * (duty.intervalSec - duty.awakeSec);
+    return capacityMah / (mas / duty.intervalSec);
+}
+
+// Run the duty cycle until the battery is flat, feeding the estimator a perfect fuel gauge after
+// every wake, and return the life projected by the ledger
+float simulate(const EnergyModel& model, const DutyCycle& duty, float capacityMah, float& flatHours) {
+    EnergyLedger ledger;
+    BatteryEstimator estimator;
+    uint64_t nowMs = 0;
+    double drawnMah = 0.0;
+    float projected = 0.0f;
+    bool halfway = false;
+
+    ledger.start(nowMs, bit(EnergyComponent::SLEEP));
+    estimator.update(100.0f, 0.0f, capacityMah, NAN, false, nowMs);
+    runCycle(ledger, duty, nowMs);
+
+    EnergyCycle cycle = {};
+    while (drawnMah < capacityMah) {
+        // Each wake closes the cycle that began with the previous one
+        nowMs += duty.intervalSec * MsPerSecond;
+        runCycle(ledger, duty, nowMs);
+        ledger.getLastCycle(cycle);
+        auto mah = EnergyLedger::charge(model, cycle);
+        drawnMah += mah;
+        estimator.update(100.0f * (1.0f - (float)(drawnMah / capacityMah)), mah, capacityMah, NAN, false, nowMs);
+        projected = EnergyLedger::projectLife(model, cycle, capacityMah);
+
+        // Halfway down, the estimator should see half of the life the ledger projects left
+        if (!halfway && (drawnMah >= capacityMah / 2.0f) && (estimator.getRate() > 0.0f)) {
+            halfway = true;
+            TEST_CHECK_NEAR(estimator.getTimeTo(0.0f) / projected, 0.5f, 0.02f);
+        }
+    }
+    flatHours = (float)nowMs / 3600000.0f;
+
+    return projected;
+}
+
+void testAccounting() {
+    EnergyLedger ledger;
+    EnergyCycle cycle;
+
+    ledger.start(0, bit(EnergyComponent::RUN));
+    TEST_CHECK(ledger.isOn(EnergyComponent::RUN));
+    TEST_CHECK(!ledger.isOn(EnergyComponent::GNSS));
+    TEST_CHECK(!ledger.getLastCycle(cycle));
+
+    ledger.set(EnergyComponent::GNSS, true, 1000);
+    ledger.set(EnergyComponent::GNSS, false, 3000);
+    ledger.update(5000);
+    // Time running backwards is ignored
+    ledger.update(4000);
+    ledger.getCurrentCycle(cycle);
+    TEST_CHECK(cycle.durationMs == 5000);
+    TEST_CHECK(cycle.onMs[(size_t)EnergyComponent::RUN] == 5000);
+    TEST_CHECK(cycle.onMs[(size_t)EnergyComponent::GNSS] == 2000);
+    TEST_CHECK(cycle.onMs[(size_t)EnergyComponent::MODEM] == 0);
+
+    ledger.beginCycle(6000);
+    TEST_CHECK(ledger.getLastCycle(cycle));
+    TEST_CHECK(cycle.startMs == 0);
+    TEST_CHECK(cycle.durationMs == 6000);
+    ledger.getCurrentCycle(cycle);
+    TEST_CHECK(cycle.startMs == 6000);
+    TEST_CHECK(cycle.durationMs == 0);
+
+    ledger.update(10000);
+    ledger.getTotals(cycle);
+    TEST_CHECK(cycle.durationMs == 10000);
+    TEST_CHECK(cycle.onMs[(size_t)EnergyComponent::RUN] == 10000);
+    TEST_CHECK(cycle.onMs[(size_t)EnergyComponent::GNSS] == 2000);
+}
+
+void testCharge() {
+    EnergyCycle cycle = {};
+    TEST_CHECK(EnergyLedger::projectLife(EnergyDefaultModel, cycle, (float)EnergyDefaultBatteryMah) == 0.0f);
+
+    // One hour of running alone draws the running current
+    cycle.durationMs = 3600 * MsPerSecond;
+    cycle.onMs[(size_t)EnergyComponent::RUN] = 3600 * MsPerSecond;
+    TEST_CHECK_NEAR(EnergyLedger::charge(EnergyDefaultModel, cycle), 8.0f, 1e-4f);
+    TEST_CHECK_NEAR(EnergyLedger::projectLife(EnergyDefaultModel, cycle, (float)EnergyDefaultBatteryMah), 250.0f, 1e-2f);
+}
+
+void testProjection() {
+    const DutyCycle duties[] = {
+        {60, 30, 20},
+        {900, 30, 20},
+        {3600, 45, 40},
+        {86400, 60, 60},
+    };
+
+    for (auto& duty : duties) {
+        float flatHours = 0.0f;
+        auto projected = simulate(EnergyDefaultModel, duty, (float)EnergyDefaultBatteryMah, flatHours);
+        auto expected = analyticLife(EnergyDefaultModel, duty, (float)EnergyDefaultBatteryMah);
+        TEST_CHECK_NEAR(projected / expected, 1.0f, 1e-3f);
+        // The battery runs flat during the cycle that crosses the capacity
+        TEST_CHECK((flatHours >= expected * 0.999f) && (flatHours <= expected + duty.intervalSec / 3600.0f));
+    }
+}
+
+} // anonymous namespace
+
+// Run the tests, or project the life of a duty cycle given as "energy_ledger_test <interval> <awake> <gnss>"
+int main(int argc, char* argv[]) {
+    if (argc == 4) {
+        DutyCycle duty = {(unsigned int)atoi(argv[1]), (unsigned int)atoi(argv[2]), (unsigned int)atoi(argv[3])};
+        if (!duty.intervalSec || (duty.awakeSec > duty.intervalSec) || (duty.gnssSec > duty.awakeSec)) {
+            printf("usage: %s <interval sec> <awake sec> <gnss sec>\n", argv[0]);
+            return 1;
+        }
+        float flatHours = 0.0f;
+        auto projected = simulate(EnergyDefaultModel, duty, (float)EnergyDefaultBatteryMah, flatHours);
+        printf("projected %.1f h (%.1f days), flat after %.1f h\n", projected, projected / 24.0f, flatHours);
+        return 0;
+    }
+
+    testAccounting();
+    testCharge();
+    testProjection();
+
+    return TEST_RESULT();
+}
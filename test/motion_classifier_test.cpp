@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+
+#include "test.h"
+#include "motion_classifier.h"
+
+namespace {
+
+constexpr float SampleRate = 100.0;     // Hz, classifier default
+constexpr size_t WindowSamples = (size_t)(MotionClassifier::WINDOW_TIME * SampleRate + 0.5f);
+constexpr size_t MaxWindows = 8;        // Windows allowed for a change to be reported
+
+// Source of one accelerometer sample at the given sample index
+typedef float (*SampleSource)(size_t index);
+
+// Steady 12.5Hz engine vibration
+float idleSample(size_t index) {
+    return 1.0f + 0.05f * sinf(2.0f * (float)M_PI * 12.5f * index / SampleRate);
+}
+
+// Broadband road vibration from a fixed seed linear congruential generator
+float driveSample(size_t index) {
+    uint32_t state = 12345u + (uint32_t)index * 2654435761u;
+    state = state * 1664525u + 1013904223u;
+    return 1.0f + 0.4f * (((float)(state >> 8) / (float)(1u << 24)) * 2.0f - 1.0f);
+}
+
+// Feed samples the way the motion service does while sampling: stop as soon as the classifier
+// reports a quiescent activity.  Returns the number of samples consumed.
+size_t sampleUntilQuiescent(MotionClassifier& classifier, SampleSource source, size_t limit) {
+    for (size_t i = 0; i < limit; i++) {
+        classifier.addSample(0.0f, 0.0f, source(i));
+        if (classifier.isQuiescent()) {
+            return i + 1;
+        }
+    }
+    return limit;
+}
+
+void testIdleThenDrive() {
+    MotionClassifier classifier;
+    classifier.setRate(SampleRate);
+
+    auto used = sampleUntilQuiescent(classifier, idleSample, MaxWindows * WindowSamples);
+    TEST_CHECK(classifier.getActivity() == MotionActivity::IDLING);
+    TEST_CHECK(used < MaxWindows * WindowSamples);
+
+    // Motion interrupt restarts sampling; the settled idle result must not stop it straight away
+    classifier.restart();
+    TEST_CHECK(!classifier.isQuiescent());
+
+    used = sampleUntilQuiescent(classifier, driveSample, MaxWindows * WindowSamples);
+    TEST_CHECK(classifier.getActivity() == MotionActivity::DRIVING);
+    TEST_CHECK(used == MaxWindows * WindowSamples);
+}
+
+void testIdleRestartStaysIdle() {
+    MotionClassifier classifier;
+    classifier.setRate(SampleRate);
+
+    sampleUntilQuiescent(classifier, idleSample, MaxWindows * WindowSamples);
+    TEST_CHECK(classifier.getActivity() == MotionActivity::IDLING);
+
+    // An interrupt with nothing new stops after the first window confirms the idle result
+    classifier.restart();
+    auto used = sampleUntilQuiescent(classifier, idleSample, MaxWindows * WindowSamples);
+    TEST_CHECK(classifier.getActivity() == MotionActivity::IDLING);
+    TEST_CHECK(used == WindowSamples);
+}
+
+void testDriveThenStop() {
+    MotionClassifier classifier;
+    classifier.setRate(SampleRate);
+
+    sampleUntilQuiescent(classifier, driveSample, 4 * WindowSamples);
+    TEST_CHECK(classifier.getActivity() == MotionActivity::DRIVING);
+    TEST_CHECK(!classifier.isQuiescent());
+
+    auto used = sampleUntilQuiescent(classifier, [](size_t) { return 1.0f; }, MaxWindows * WindowSamples);
+    TEST_CHECK(classifier.getActivity() == MotionActivity::STATIONARY);
+    TEST_CHECK(used < MaxWindows * WindowSamples);
+}
+
+} // anonymous namespace
+
+int main() {
+    testIdleThenDrive();
+    testIdleRestartStaysIdle();
+    testDriveThenStop();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,553 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+
+#include "test.h"
+#include "publish_schedule.h"
+#include "energy_ledger.h"
+
+// Model test of PublishSchedule.  Replays configurations and timelines of motion triggers,
+// cellular connectivity and GNSS lock against virtual time.  The publish and wake decisions come
+// from PublishSchedule.  The sleep state machine around them is a simplified model of TrackerSleep,
+// written for this test: connect until published or timed out, execute for the minimum time, then
+// sleep until the location wake or a motion trigger.  TrackerSleep itself is not run here, so a
+// divergence between it and the model is not covered.
+
+namespace {
+
+// Time awake, in seconds, for a wake that needs no network (TrackerLocation EarlySleepSec)
+constexpr uint32_t SimulationEarlySleepSec = 2;
+
+// Connect time, in milliseconds, assumed until one is measured (TrackerSleepDefaultReconnectCost)
+constexpr uint32_t SimulationDefaultConnectMs = 30 * 1000;
+
+struct SimulationConfig {
+    uint32_t intervalMinSec;        // location interval_min_seconds
+    uint32_t intervalMaxSec;        // location interval_max_seconds
+    uint32_t executeMinSec;         // sleep exe_min
+    uint32_t connectingMaxSec;      // sleep conn_max
+    uint32_t connectSec;            // time from modem on to cloud connected, 0 to never connect
+    uint32_t lockSec;               // time from GNSS on to stable lock, 0 to never lock
+};
+
+struct SimulationTimeline {
+    uint32_t durationSec;           // length of the simulation
+    uint32_t triggerPeriodSec;      // time between motion triggers, 0 for none
+    uint32_t outageStartSec;        // no cellular connection from this uptime
+    uint32_t outageEndSec;          // until this uptime
+};
+
+struct SimulationReport {
+    unsigned int wakes;             // wakes from sleep
+    unsigned int fullWakes;         // wakes, and boot, that turned the network on
+    unsigned int publishes;
+    unsigned int missed;            // max interval deadlines passed by more than the lock timeout
+    unsigned int early;             // publishes ahead of the interval that allows them
+    uint32_t maxLateSec;            // latest publish past a max interval deadline
+    uint32_t awakeSec;
+    float lifeHours;                // battery life projected over the whole simulation
+};
+
+enum class SimulationState {
+    CONNECTING,
+    EXECUTION,
+    SLEEP,
+};
+
+class Simulation {
+public:
+    Simulation(const SimulationConfig& config, const SimulationTimeline& timeline, uint32_t* publishes = nullptr, size_t maxPublishes = 0)
+        : config_(config),
+          timeline_(timeline),
+          publishLog_(publishes),
+          publishLogSize_(maxPublishes) {
+    }
+
+    SimulationReport run() {
+        report_ = SimulationReport();
+        now_ = 0;
+        nextTriggerSec_ = (timeline_.triggerPeriodSec) ? timeline_.triggerPeriodSec : UINT32_MAX;
+        pendingTriggers_ = false;
+        pendingImmediate_ = false;
+        firstPublish_ = true;
+        published_ = false;
+        lastPublishSec_ = now_ - config_.intervalMinSec;
+        monotonicPublishSec_ = now_;
+        deadlineValid_ = false;
+        deadlineMissed_ = false;
+        earlyWake_ = 0;
+        nextEarlyWake_ = 0;
+        wakeSec_ = now_;
+        wakeAtSec_ = 0;
+        firstLockSec_ = 0;
+        fullWake_ = false;
+        connectMs_ = SimulationDefaultConnectMs;
+        connectMeasured_ = false;
+        modemOnSec_ = 0;
+        gnssOnSec_ = 0;
+        connectingSec_ = 0;
+        executeEndSec_ = 0;
+        deadlineSec_ = 0;
+        ledger_.start(0, 1UL << (size_t)EnergyComponent::RUN);
+        toConnecting();
+
+        while (now_ < timeline_.durationSec) {
+            if (state_ == SimulationState::SLEEP) {
+                sleep();
+                continue;
+            }
+            step();
+            now_++;
+            report_.awakeSec++;
+        }
+        checkDeadline(now_);
+
+        EnergyCycle totals;
+        ledger_.update((uint64_t)now_ * 1000);
+        ledger_.getTotals(totals);
+        report_.lifeHours = EnergyLedger::projectLife(EnergyDefaultModel, totals, (float)EnergyDefaultBatteryMah);
+
+        return report_;
+    }
+
+private:
+    void setEnergy(EnergyComponent component, bool on) {
+        ledger_.set(component, on, (uint64_t)now_ * 1000);
+    }
+
+    EvaluationResults evaluate() {
+        if (pendingImmediate_) {
+            return EvaluationResults {PublishReason::IMMEDIATE, true, false};
+        }
+        if (firstPublish_) {
+            return EvaluationResults {PublishReason::TRIGGERS, true, (now_ - gnssOnSec_) < config_.connectingMaxSec};
+        }
+
+        return PublishSchedule::evaluateIntervals(now_,
+            lastPublishSec_,
+            monotonicPublishSec_,
+            config_.intervalMinSec,
+            config_.intervalMaxSec,
+            nextEarlyWake_,
+            pendingTriggers_);
+    }
+
+    void collectTriggers() {
+        while (nextTriggerSec_ <= now_) {
+            pendingTriggers_ = true;
+            nextTriggerSec_ += timeline_.triggerPeriodSec;
+        }
+    }
+
+    void checkDeadline(uint32_t now) {
+        if (deadlineValid_ && !deadlineMissed_ && (now > deadlineSec_ + PublishScheduleLockTimeoutSec)) {
+            report_.missed++;
+            deadlineMissed_ = true;
+        }
+    }
+
+    void toConnecting() {
+        state_ = SimulationState::CONNECTING;
+        connectingSec_ = now_;
+        if (!fullWake_) {
+            fullWake_ = true;
+            report_.fullWakes++;
+            connectMeasured_ = false;
+            modemOnSec_ = now_;
+            gnssOnSec_ = now_;
+            setEnergy(EnergyComponent::MODEM, true);
+            setEnergy(EnergyComponent::GNSS, true);
+        }
+    }
+
+    void toExecution(uint32_t durationSec) {
+        state_ = SimulationState::EXECUTION;
+        executeEndSec_ = now_ + durationSec;
+    }
+
+    bool isConnected() const {
+        if (!fullWake_ || !config_.connectSec || (now_ < modemOnSec_ + config_.connectSec)) {
+            return false;
+        }
+
+        return (now_ < timeline_.outageStartSec) || (now_ >= timeline_.outageEndSec);
+    }
+
+    void publish(PublishReason reason) {
+        if (publishLog_ && (report_.publishes < publishLogSize_)) {
+            publishLog_[report_.publishes] = now_;
+        }
+        report_.publishes++;
+
+        // Nothing but the max interval may publish ahead of the min interval
+        if ((reason == PublishReason::TRIGGERS) && !firstPublish_ && (now_ - lastPublishSec_ < config_.intervalMinSec)) {
+            report_.early++;
+        }
+        if (deadlineValid_ && (now_ > deadlineSec_) && (now_ - deadlineSec_ > report_.maxLateSec)) {
+            report_.maxLateSec = now_ - deadlineSec_;
+        }
+        if ((reason == PublishReason::TIME) && (now_ < deadlineSec_)) {
+            report_.early++;
+        }
+        checkDeadline(now_);
+
+        monotonicPublishSec_ = PublishSchedule::advanceMonotonic(now_,
+            monotonicPublishSec_,
+            config_.intervalMaxSec,
+            firstPublish_ || (reason != PublishReason::TIME));
+        lastPublishSec_ = now_;
+        deadlineSec_ = monotonicPublishSec_ + config_.intervalMaxSec;
+        deadlineValid_ = config_.intervalMaxSec > 0;
+        deadlineMissed_ = false;
+        firstPublish_ = false;
+        pendingTriggers_ = false;
+        pendingImmediate_ = false;
+        published_ = true;
+    }
+
+    // One second awake, following TrackerLocation::loop() and TrackerSleep::loop()
+    void step() {
+        collectTriggers();
+        checkDeadline(now_);
+
+        auto locked = fullWake_ && config_.lockSec && (now_ >= gnssOnSec_ + config_.lockSec);
+        if (locked && !firstLockSec_) {
+            firstLockSec_ = now_;
+        }
+
+        auto result = evaluate();
+        if (!fullWake_ && result.networkNeeded) {
+            toConnecting();
+        }
+
+        // TrackerSleep measures the time from modem on to cloud connected
+        auto connected = isConnected();
+        if (connected && !connectMeasured_) {
+            connectMs_ = (now_ - modemOnSec_) * 1000;
+            connectMeasured_ = true;
+        }
+        if ((result.reason != PublishReason::NONE) && connected &&
+            ((result.reason == PublishReason::IMMEDIATE) || locked || !result.lockWait)) {
+            publish(result.reason);
+        }
+
+        switch (state_) {
+            case SimulationState::CONNECTING: {
+                if (published_ && connected) {
+                    published_ = false;
+                    toExecution(config_.executeMinSec);
+                }
+                else if (now_ - connectingSec_ >= config_.connectingMaxSec) {
+                    pendingImmediate_ = true;
+                    toExecution(config_.executeMinSec);
+                }
+                break;
+            }
+
+            case SimulationState::EXECUTION: {
+                if (now_ >= executeEndSec_) {
+                    prepareSleep();
+                }
+                break;
+            }
+
+            case SimulationState::SLEEP: {
+                break;
+            }
+        }
+    }
+
+    // TrackerLocation::onSleepPrepare() and the transition to sleep
+    void prepareSleep() {
+        if (fullWake_) {
+            nextEarlyWake_ = earlyWake_ = PublishSchedule::calculateEarlyWake((uint64_t)wakeSec_ * 1000,
+                firstLockSec_,
+                connectMs_,
+                config_.connectingMaxSec,
+                lastPublishSec_,
+                monotonicPublishSec_);
+        }
+        else {
+            nextEarlyWake_ = (earlyWake_ == 0) ? config_.connectingMaxSec : earlyWake_;
+        }
+
+        wakeAtSec_ = PublishSchedule::calculateWake(lastPublishSec_,
+            config_.intervalMinSec,
+            config_.intervalMaxSec,
+            nextEarlyWake_,
+            pendingTriggers_);
+
+        // A wake time in the past cancels the sleep and execution starts over
+        if (wakeAtSec_ <= now_ + 1) {
+            toExecution(config_.executeMinSec);
+            return;
+        }
+
+        if (fullWake_) {
+            setEnergy(EnergyComponent::MODEM, false);
+            setEnergy(EnergyComponent::GNSS, false);
+        }
+        fullWake_ = false;
+        published_ = false;
+        state_ = SimulationState::SLEEP;
+        now_++;
+        report_.awakeSec++;
+        setEnergy(EnergyComponent::RUN, false);
+        setEnergy(EnergyComponent::SLEEP, true);
+    }
+
+    // Sleep until the location wake or a motion trigger, then TrackerLocation::onWake()
+    void sleep() {
+        auto wake = (nextTriggerSec_ < wakeAtSec_) ? nextTriggerSec_ : wakeAtSec_;
+        if (wake >= timeline_.durationSec) {
+            now_ = timeline_.durationSec;
+            return;
+        }
+        checkDeadline(wake);
+
+        now_ = wake;
+        setEnergy(EnergyComponent::SLEEP, false);
+        setEnergy(EnergyComponent::RUN, true);
+        report_.wakes++;
+        wakeSec_ = now_;
+        firstLockSec_ = 0;
+        collectTriggers();
+
+        auto result = evaluate();
+        if (result.networkNeeded) {
+            toConnecting();
+        }
+        else {
+            toExecution((wake == wakeAtSec_) ? SimulationEarlySleepSec : 0);
+        }
+    }
+
+    const SimulationConfig config_;
+    const SimulationTimeline timeline_;
+    uint32_t* publishLog_;
+    size_t publishLogSize_;
+    SimulationReport report_;
+    EnergyLedger ledger_;
+
+    SimulationState state_;
+    uint32_t now_;
+    uint32_t nextTriggerSec_;
+    bool pendingTriggers_;
+    bool pendingImmediate_;
+    bool firstPublish_;
+    bool published_;
+    bool fullWake_;
+    uint32_t lastPublishSec_;
+    uint32_t monotonicPublishSec_;
+    uint32_t deadlineSec_;
+    bool deadlineValid_;
+    bool deadlineMissed_;
+    uint32_t earlyWake_;
+    uint32_t nextEarlyWake_;
+    uint32_t wakeSec_;
+    uint32_t wakeAtSec_;
+    uint32_t firstLockSec_;
+    uint32_t connectMs_;
+    bool connectMeasured_;
+    uint32_t modemOnSec_;
+    uint32_t gnssOnSec_;
+    uint32_t connectingSec_;
+    uint32_t executeEndSec_;
+};
+
+void print(const SimulationReport& report) {
+    printf("wakes %u (%u full), awake %lu s, publishes %u, missed %u, early %u, latest %lu s, life %.0f h\n",
+        report.wakes, report.fullWakes, (unsigned long)report.awakeSec, report.publishes,
+        report.missed, report.early, (unsigned long)report.maxLateSec, report.lifeHours);
+}
+
+const SimulationConfig HourlyConfig = {900, 3600, 10, 90, 20, 30};
+
+void testScheduled() {
+    uint32_t publishes[32] = {};
+    SimulationTimeline timeline = {24 * 3600 + 60, 0, UINT32_MAX, UINT32_MAX};
+    auto report = Simulation(HourlyConfig, timeline, publishes, 32).run();
+
+    // The first publish waits for lock and the rest land on the max interval
+    TEST_CHECK(report.publishes == 25);
+    for (unsigned int i = 0; i < 25; i++) {
+        TEST_CHECK(publishes[i] == 30 + i * 3600);
+    }
+    TEST_CHECK(report.wakes == 24);
+    TEST_CHECK(report.missed == 0);
+    TEST_CHECK(report.maxLateSec == 0);
+
+    // Each wake is early by the time to lock and the time entering and leaving sleep, then
+    // executes for the minimum time after the publish second and before the sleep second
+    TEST_CHECK(report.awakeSec <= 41 + 24 * (30 + PublishScheduleMiscSleepWakeSec + 1 + 1 + 10 + 1));
+}
+
+void testNoLock() {
+    auto config = HourlyConfig;
+    config.lockSec = 0;
+    uint32_t publishes[32] = {};
+    SimulationTimeline timeline = {24 * 3600 + 60, 0, UINT32_MAX, UINT32_MAX};
+    auto report = Simulation(config, timeline, publishes, 32).run();
+
+    // Waits for lock are bounded by the connecting time and the lock timeout
+    TEST_CHECK(publishes[0] == config.connectingMaxSec);
+    TEST_CHECK(report.publishes == 24);
+    TEST_CHECK(report.missed == 0);
+    TEST_CHECK(report.maxLateSec <= PublishScheduleLockTimeoutSec);
+}
+
+void testTriggers() {
+    auto config = HourlyConfig;
+    config.intervalMinSec = 300;
+    uint32_t publishes[32] = {};
+
+    // Triggers past the min interval go out as soon as connected, without waiting for lock
+    SimulationTimeline timeline = {6 * 3600, 1000, UINT32_MAX, UINT32_MAX};
+    auto report = Simulation(config, timeline, publishes, 32).run();
+    TEST_CHECK(publishes[0] == 30);
+    for (unsigned int i = 1; i < 21; i++) {
+        TEST_CHECK(publishes[i] == i * 1000 + config.connectSec);
+    }
+    TEST_CHECK(report.early == 0);
+    TEST_CHECK(report.missed == 0);
+
+    // Triggers inside the min interval take brief wakes and wait for the min interval
+    timeline.triggerPeriodSec = 100;
+    report = Simulation(config, timeline, publishes, 32).run();
+    for (unsigned int i = 2; i < 32; i++) {
+        TEST_CHECK(publishes[i] - publishes[i - 1] == config.intervalMinSec);
+    }
+    TEST_CHECK(report.wakes > report.fullWakes);
+    TEST_CHECK(report.early == 0);
+    TEST_CHECK(report.missed == 0);
+}
+
+void testOutage() {
+    uint32_t publishes[32] = {};
+    SimulationTimeline timeline = {6 * 3600, 0, 3500, 5000};
+    auto report = Simulation(HourlyConfig, timeline, publishes, 32).run();
+
+    // The deadline inside the outage is missed and the publish goes out when it ends
+    TEST_CHECK(report.missed == 1);
+    TEST_CHECK(publishes[1] == timeline.outageEndSec);
+    TEST_CHECK(publishes[2] == timeline.outageEndSec + 3600);
+}
+
+void testDeferral() {
+    auto reason = PublishReason::TRIGGERS;
+
+    // Only a poor signal starts holding, and never the first publish or with deferral off
+    TEST_CHECK(PublishSchedule::evaluateDeferral(100, 0, 120, reason, false, SignalQuality::POOR) == DeferResult::HOLD);
+    TEST_CHECK(PublishSchedule::evaluateDeferral(100, 0, 120, reason, false, SignalQuality::UNKNOWN) == DeferResult::SEND);
+    TEST_CHECK(PublishSchedule::evaluateDeferral(100, 0, 120, reason, false, SignalQuality::GOOD) == DeferResult::SEND);
+    TEST_CHECK(PublishSchedule::evaluateDeferral(100, 0, 120, reason, true, SignalQuality::POOR) == DeferResult::SEND);
+    TEST_CHECK(PublishSchedule::evaluateDeferral(100, 0, 0, reason, false, SignalQuality::POOR) == DeferResult::SEND);
+
+    // Only a good signal releases a held publish early, an unknown one holds until expiry
+    TEST_CHECK(PublishSchedule::evaluateDeferral(150, 100, 120, reason, false, SignalQuality::GOOD) == DeferResult::IMPROVED);
+    TEST_CHECK(PublishSchedule::evaluateDeferral(150, 100, 120, reason, false, SignalQuality::UNKNOWN) == DeferResult::HOLD);
+    TEST_CHECK(PublishSchedule::evaluateDeferral(150, 100, 120, reason, false, SignalQuality::POOR) == DeferResult::HOLD);
+    TEST_CHECK(PublishSchedule::evaluateDeferral(220, 100, 120, reason, false, SignalQuality::UNKNOWN) == DeferResult::EXPIRED);
+    TEST_CHECK(PublishSchedule::evaluateDeferral(220, 100, 120, reason, false, SignalQuality::POOR) == DeferResult::EXPIRED);
+
+    // Scheduled and immediate publishes are never held and carry held triggers with them
+    TEST_CHECK(PublishSchedule::evaluateDeferral(150, 0, 120, PublishReason::TIME, false, SignalQuality::POOR) == DeferResult::SEND);
+    TEST_CHECK(PublishSchedule::evaluateDeferral(150, 100, 120, PublishReason::TIME, false, SignalQuality::POOR) == DeferResult::MERGED);
+    TEST_CHECK(PublishSchedule::evaluateDeferral(150, 100, 120, PublishReason::IMMEDIATE, false, SignalQuality::UNKNOWN) == DeferResult::MERGED);
+}
+
+void testSweep() {
+    const uint32_t intervalMins[] = {0, 30, 300, 900};
+    const uint32_t intervalMaxs[] = {300, 3600, 86400};
+    const uint32_t executeMins[] = {5, 10};
+    const uint32_t connectingMaxs[] = {60, 90, 300};
+    const uint32_t connects[] = {5, 20, 45};
+    const uint32_t locks[] = {0, 10, 30, 120};
+    const uint32_t triggerPeriods[] = {0, 500, 7000};
+
+    unsigned int count = 0;
+    for (auto intervalMin : intervalMins) {
+        for (auto intervalMax : intervalMaxs) {
+            if (intervalMin > intervalMax) {
+                continue;
+            }
+            for (auto executeMin : executeMins) {
+                for (auto connectingMax : connectingMaxs) {
+                    for (auto connect : connects) {
+                        for (auto lock : locks) {
+                            for (auto triggerPeriod : triggerPeriods) {
+                                SimulationConfig config = {intervalMin, intervalMax, executeMin, connectingMax, connect, lock};
+                                SimulationTimeline timeline = {3 * 86400, triggerPeriod, UINT32_MAX, UINT32_MAX};
+                                auto report = Simulation(config, timeline).run();
+                                count++;
+
+                                // The early wake covers the slower of connecting and locking so no
+                                // publish is late by more than the lock timeout
+                                bool failed = report.early ||
+                                    (report.maxLateSec > PublishScheduleLockTimeoutSec) ||
+                                    report.missed;
+                                if (failed) {
+                                    printf("FAIL min %lu max %lu exe %lu conn %lu connect %lu lock %lu triggers %lu: ",
+                                        (unsigned long)intervalMin, (unsigned long)intervalMax, (unsigned long)executeMin,
+                                        (unsigned long)connectingMax, (unsigned long)connect, (unsigned long)lock,
+                                        (unsigned long)triggerPeriod);
+                                    print(report);
+                                    testFailures++;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    TEST_CHECK(count > 2000);
+}
+
+} // anonymous namespace
+
+// Run the tests, or simulate a configuration given as
+// "publish_schedule_test <min> <max> <exe_min> <conn_max> <connect> <lock> [trigger period] [days]"
+int main(int argc, char* argv[]) {
+    if (argc >= 7) {
+        SimulationConfig config;
+        config.intervalMinSec = (uint32_t)atoi(argv[1]);
+        config.intervalMaxSec = (uint32_t)atoi(argv[2]);
+        config.executeMinSec = (uint32_t)atoi(argv[3]);
+        config.connectingMaxSec = (uint32_t)atoi(argv[4]);
+        config.connectSec = (uint32_t)atoi(argv[5]);
+        config.lockSec = (uint32_t)atoi(argv[6]);
+        SimulationTimeline timeline = {7 * 86400, 0, UINT32_MAX, UINT32_MAX};
+        if (argc >= 8) {
+            timeline.triggerPeriodSec = (uint32_t)atoi(argv[7]);
+        }
+        if (argc >= 9) {
+            timeline.durationSec = (uint32_t)atoi(argv[8]) * 86400;
+        }
+        print(Simulation(config, timeline).run());
+        return 0;
+    }
+
+    testScheduled();
+    testNoLock();
+    testTriggers();
+    testOutage();
+    testDeferral();
+    testSweep();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+#include "temperature_log.h"
+
+namespace {
+
+// Log samples first, first + 1, ... one second apart
+void addSamples(TemperatureLog& log, float first, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        log.add(first + i, 1.0f, false, false);
+    }
+}
+
+void testSummary() {
+    TemperatureLog older;
+    older.add(10.0f, 0.0f, false, true);
+    older.add(30.0f, 60.0f, true, false);
+    TemperatureLog newer;
+    newer.add(20.0f, 0.0f, false, false);
+    newer.add(25.0f, 60.0f, false, false);
+
+    newer.merge(older);
+    auto& summary = newer.getSummary();
+    TEST_CHECK(summary.count == 4);
+    TEST_CHECK_NEAR(summary.min, 10.0, 0.001);
+    TEST_CHECK_NEAR(summary.max, 30.0, 0.001);
+    TEST_CHECK_NEAR(summary.sum, 85.0, 0.001);
+    TEST_CHECK_NEAR(summary.durationSec, 120.0, 0.001);
+    TEST_CHECK_NEAR(summary.aboveSec, 60.0, 0.001);
+    TEST_CHECK_NEAR(summary.belowSec, 0.0, 0.001);
+}
+
+void testSeriesOrder() {
+    TemperatureLog older;
+    addSamples(older, 0.0f, 4);
+    TemperatureLog newer;
+    addSamples(newer, 4.0f, 3);
+
+    // The undelivered points go ahead of the newer ones
+    newer.merge(older);
+    TEST_CHECK(newer.getSeriesStride() == 1);
+    TEST_CHECK(newer.getSeriesSize() == 7);
+    for (size_t i = 0; i < newer.getSeriesSize(); i++) {
+        TEST_CHECK_NEAR(newer.getSeriesPoint(i), (float)i, 0.001);
+    }
+
+    // Logging continues after the merged points
+    addSamples(newer, 7.0f, 2);
+    TEST_CHECK(newer.getSeriesSize() == 9);
+    TEST_CHECK_NEAR(newer.getSeriesPoint(8), 8.0, 0.001);
+}
+
+void testSeriesStride() {
+    // 40 samples take a stride of 4 in 10 points
+    TemperatureLog older;
+    addSamples(older, 0.0f, 40);
+    TEST_CHECK(older.getSeriesStride() == 4);
+    TemperatureLog newer;
+    addSamples(newer, 40.0f, 5);
+
+    // The newer samples are combined to the older stride, the last point partly filled
+    newer.merge(older);
+    TEST_CHECK(newer.getSeriesStride() == 4);
+    TEST_CHECK(newer.getSeriesSize() == 12);
+    TEST_CHECK_NEAR(newer.getSeriesPoint(0), 1.5, 0.001);
+    TEST_CHECK_NEAR(newer.getSeriesPoint(9), 37.5, 0.001);
+    TEST_CHECK_NEAR(newer.getSeriesPoint(10), 41.5, 0.001);
+    TEST_CHECK_NEAR(newer.getSeriesPoint(11), 44.0, 0.001);
+}
+
+void testSeriesOverflow() {
+    TemperatureLog older;
+    addSamples(older, 0.0f, TemperatureLog::SERIES_SIZE);
+    TemperatureLog newer;
+    addSamples(newer, (float)TemperatureLog::SERIES_SIZE, TemperatureLog::SERIES_SIZE);
+
+    // Twice the points fit at half the resolution and still span both periods
+    newer.merge(older);
+    TEST_CHECK(newer.getSeriesStride() == 2);
+    TEST_CHECK(newer.getSeriesSize() == TemperatureLog::SERIES_SIZE);
+    for (size_t i = 0; i < newer.getSeriesSize(); i++) {
+        TEST_CHECK_NEAR(newer.getSeriesPoint(i), 2.0f * i + 0.5f, 0.001);
+    }
+}
+
+void testEmpty() {
+    TemperatureLog older;
+    TemperatureLog newer;
+    addSamples(newer, 0.0f, 3);
+
+    newer.merge(older);
+    TEST_CHECK(newer.getSummary().count == 3);
+    TEST_CHECK(newer.getSeriesSize() == 3);
+
+    // Merging into an empty log takes the other log as is
+    TemperatureLog fresh;
+    fresh.merge(newer);
+    TEST_CHECK(fresh.getSummary().count == 3);
+    TEST_CHECK(fresh.getSeriesSize() == 3);
+    TEST_CHECK_NEAR(fresh.getSeriesPoint(2), 2.0, 0.001);
+}
+
+} // anonymous namespace
+
+int main() {
+    testSummary();
+    testSeriesOrder();
+    testSeriesStride();
+    testSeriesOverflow();
+    testEmpty();
+
+    return TEST_RESULT();
+}
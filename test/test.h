@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+// Minimal assertions for host tests of the modules that have no system dependencies.  Each test
+// binary returns non-zero if any check failed.
+
+static unsigned int testFailures = 0;
+
+#define TEST_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            testFailures++; \
+        } \
+    } while (0)
+
+#define TEST_CHECK_NEAR(value, expected, tolerance) \
+    do { \
+        auto testValue_ = (value); \
+        auto testExpected_ = (expected); \
+        if (std::fabs((double)testValue_ - (double)testExpected_) > (double)(tolerance)) { \
+            printf("FAIL %s:%d: %s is %g, expected %g\n", __FILE__, __LINE__, #value, (double)testValue_, (double)testExpected_); \
+            testFailures++; \
+        } \
+    } while (0)
+
+#define TEST_RESULT() \
+    (printf("%s: %u failures\n", __FILE__, testFailures), (testFailures) ? 1 : 0)
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+
+#include "test.h"
+#include "thermistor_curve.h"
+
+using namespace particle;
+
+namespace {
+
+constexpr int32_t AdcCounts = 4096;
+
+// Interpolation error bounds, in degrees Celcius, over the full range and the operating range where
+// the curve is nearly linear
+constexpr float MaxError = 0.5;
+constexpr float MaxOperatingError = 0.02;
+constexpr float OperatingMin = -20.0;
+constexpr float OperatingMax = 85.0;
+
+// Same configuration as the tracker, based on Panasonic ERTJ1VR104FM NTC thermistor
+const ThermistorConfig trackerConfig = {
+  .circuit              = ThermistorCircuit::HIGH_SIDE_DIVIDER,
+  .type                 = ThermistorType::NEGATIVE_COEFF,
+  .beta                 = 4200.0,
+  .t0                   = 25.0,
+  .r0                   = 100000.0,
+  .fixedR               = 100000.0,
+  .adcResolution        = 4096.0,
+  .minTemperature       = -40.0,
+  .maxTemperature       = 150.0
+};
+
+void testSweep(const ThermistorConfig& config) {
+    ThermistorCurve curve;
+    curve.configure(config);
+
+    float maxError = 0.0f;
+    float maxOperatingError = 0.0f;
+    for (int32_t val = 0; val < AdcCounts; val++) {
+        float table = curve.convert(val);
+        float exact = curve.convertExact(val);
+        bool tableError = (table == curve.ThermistorError);
+        bool exactError = (exact == curve.ThermistorError);
+
+        // The range check may only disagree within the error bound of a range limit
+        if (tableError != exactError) {
+            float valid = (tableError) ? exact : table;
+            TEST_CHECK((fabsf(valid - config.minTemperature) <= MaxError) || (fabsf(valid - config.maxTemperature) <= MaxError));
+            continue;
+        }
+        if (tableError) {
+            continue;
+        }
+
+        maxError = std::max(maxError, fabsf(table - exact));
+        if ((exact >= OperatingMin) && (exact <= OperatingMax)) {
+            maxOperatingError = std::max(maxOperatingError, fabsf(table - exact));
+        }
+    }
+
+    printf("max error %.3f degC, %.3f degC from %.0f to %.0f degC\n", maxError, maxOperatingError, OperatingMin, OperatingMax);
+    TEST_CHECK(maxError < MaxError);
+    TEST_CHECK(maxOperatingError < MaxOperatingError);
+}
+
+void testLowSide() {
+    auto config = trackerConfig;
+    config.circuit = ThermistorCircuit::LOW_SIDE_DIVIDER;
+    testSweep(config);
+}
+
+void testUnconfigured() {
+    ThermistorCurve curve;
+    TEST_CHECK(curve.convert(AdcCounts / 2) == curve.ThermistorError);
+    TEST_CHECK(curve.convertExact(AdcCounts / 2) == curve.ThermistorError);
+}
+
+} // anonymous namespace
+
+int main() {
+    testSweep(trackerConfig);
+    testLowSide();
+    testUnconfigured();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+#include "threshold.h"
+
+namespace {
+
+struct ThresholdStep {
+    float value;                    // Value given to the threshold
+    uint64_t time;                  // Time of the value, in milliseconds
+    ThresholdTransition expected;   // Transition expected from the update
+    ThresholdState state;           // State expected after the update
+};
+
+template <size_t N>
+void runScript(Threshold& threshold, const ThresholdStep (&steps)[N]) {
+    for (size_t i = 0; i < N; i++) {
+        auto transition = threshold.update(steps[i].value, steps[i].time);
+        if ((transition != steps[i].expected) || (threshold.getState() != steps[i].state)) {
+            printf("FAIL step %zu: value %.2f gave transition %d state %d\n",
+                i, steps[i].value, (int)transition, (int)threshold.getState());
+            testFailures++;
+        }
+    }
+}
+
+void testAbove() {
+    Threshold threshold({"above", ThresholdDirection::ABOVE, 25.0, 5.0, 1});
+    const ThresholdStep steps[] = {
+        {20.0, 0,    ThresholdTransition::NONE,    ThresholdState::NORMAL},
+        {25.0, 1000, ThresholdTransition::ENTERED, ThresholdState::OUTSIDE_LIMIT},
+        {30.0, 2000, ThresholdTransition::NONE,    ThresholdState::OUTSIDE_LIMIT},
+        {22.0, 3000, ThresholdTransition::NONE,    ThresholdState::INSIDE_LIMIT},
+        {26.0, 4000, ThresholdTransition::NONE,    ThresholdState::OUTSIDE_LIMIT},
+        {20.0, 5000, ThresholdTransition::EXITED,  ThresholdState::NORMAL},
+        {24.9, 6000, ThresholdTransition::NONE,    ThresholdState::NORMAL},
+    };
+    runScript(threshold, steps);
+}
+
+void testBelow() {
+    Threshold threshold({"below", ThresholdDirection::BELOW, 0.0, 2.0, 1});
+    const ThresholdStep steps[] = {
+        {5.0,  0,    ThresholdTransition::NONE,    ThresholdState::NORMAL},
+        {0.0,  1000, ThresholdTransition::ENTERED, ThresholdState::OUTSIDE_LIMIT},
+        {1.0,  2000, ThresholdTransition::NONE,    ThresholdState::INSIDE_LIMIT},
+        {1.9,  3000, ThresholdTransition::NONE,    ThresholdState::INSIDE_LIMIT},
+        {2.0,  4000, ThresholdTransition::EXITED,  ThresholdState::NORMAL},
+    };
+    runScript(threshold, steps);
+}
+
+void testHysteresisEdges() {
+    // Both edges are inclusive, and a value that jumps straight past the band exits in one update
+    Threshold threshold({nullptr, ThresholdDirection::ABOVE, 10.0, 2.0, 1});
+    const ThresholdStep steps[] = {
+        {9.99, 0,    ThresholdTransition::NONE,    ThresholdState::NORMAL},
+        {10.0, 1000, ThresholdTransition::ENTERED, ThresholdState::OUTSIDE_LIMIT},
+        {8.01, 2000, ThresholdTransition::NONE,    ThresholdState::INSIDE_LIMIT},
+        {8.0,  3000, ThresholdTransition::EXITED,  ThresholdState::NORMAL},
+        {12.0, 4000, ThresholdTransition::ENTERED, ThresholdState::OUTSIDE_LIMIT},
+        {0.0,  5000, ThresholdTransition::EXITED,  ThresholdState::NORMAL},
+    };
+    runScript(threshold, steps);
+}
+
+void testDebounce() {
+    Threshold threshold({"debounce", ThresholdDirection::ABOVE, 10.0, 1.0, 3});
+    const ThresholdStep steps[] = {
+        {11.0, 0,    ThresholdTransition::NONE,    ThresholdState::NORMAL},
+        {11.0, 1000, ThresholdTransition::NONE,    ThresholdState::NORMAL},
+        {9.0,  2000, ThresholdTransition::NONE,    ThresholdState::NORMAL},
+        {11.0, 3000, ThresholdTransition::NONE,    ThresholdState::NORMAL},
+        {11.0, 4000, ThresholdTransition::NONE,    ThresholdState::NORMAL},
+        {11.0, 5000, ThresholdTransition::ENTERED, ThresholdState::OUTSIDE_LIMIT},
+        {8.0,  6000, ThresholdTransition::NONE,    ThresholdState::INSIDE_LIMIT},
+        {9.5,  7000, ThresholdTransition::NONE,    ThresholdState::INSIDE_LIMIT},
+        {8.0,  8000, ThresholdTransition::NONE,    ThresholdState::INSIDE_LIMIT},
+        {8.0,  9000, ThresholdTransition::NONE,    ThresholdState::INSIDE_LIMIT},
+        {8.0,  10000, ThresholdTransition::EXITED, ThresholdState::NORMAL},
+    };
+    runScript(threshold, steps);
+}
+
+void testDwell() {
+    Threshold threshold({"dwell", ThresholdDirection::ABOVE, 25.0, 5.0, 1});
+    const ThresholdStep steps[] = {
+        {20.0, 0,    ThresholdTransition::NONE,    ThresholdState::NORMAL},
+        {25.0, 1000, ThresholdTransition::ENTERED, ThresholdState::OUTSIDE_LIMIT},
+        {22.0, 3000, ThresholdTransition::NONE,    ThresholdState::INSIDE_LIMIT},
+        {20.0, 5000, ThresholdTransition::EXITED,  ThresholdState::NORMAL},
+        {30.0, 8000, ThresholdTransition::ENTERED, ThresholdState::OUTSIDE_LIMIT},
+    };
+    runScript(threshold, steps);
+
+    // Time in the current state counts up to the time given
+    ThresholdStats stats;
+    threshold.getStats(stats, 10000);
+    TEST_CHECK(stats.entries == 2);
+    TEST_CHECK(stats.transitions == 4);
+    TEST_CHECK(stats.activeMs == 4000 + 2000);
+    TEST_CHECK(stats.inactiveMs == 1000 + 3000);
+    TEST_CHECK(stats.lastTransitionMs == 8000);
+
+    threshold.reset();
+    threshold.getStats(stats, 20000);
+    TEST_CHECK(threshold.getState() == ThresholdState::UNKNOWN);
+    TEST_CHECK(stats.entries == 0);
+    TEST_CHECK(stats.activeMs == 0);
+    TEST_CHECK(stats.inactiveMs == 0);
+}
+
+void testRestore() {
+    Threshold threshold({"restore", ThresholdDirection::ABOVE, 25.0, 5.0, 1});
+    threshold.restore(ThresholdState::OUTSIDE_LIMIT);
+    TEST_CHECK(threshold.isActive());
+    const ThresholdStep steps[] = {
+        {26.0, 0,    ThresholdTransition::NONE,    ThresholdState::OUTSIDE_LIMIT},
+        {19.0, 1000, ThresholdTransition::EXITED,  ThresholdState::NORMAL},
+    };
+    runScript(threshold, steps);
+
+    ThresholdStats stats;
+    threshold.getStats(stats, 1000);
+    TEST_CHECK(stats.entries == 0);
+}
+
+void testSetLimit() {
+    // Moving the limit keeps the state and the next update is judged against the new limit
+    Threshold threshold({"limit", ThresholdDirection::BELOW, 10.0, 1.0, 1});
+    TEST_CHECK(threshold.update(10.0, 0) == ThresholdTransition::ENTERED);
+    threshold.setLimit(5.0, 1.0);
+    TEST_CHECK(threshold.isActive());
+    TEST_CHECK(threshold.update(7.0, 1000) == ThresholdTransition::EXITED);
+}
+
+uint64_t testClockMs = 0;
+uint64_t testClock() {
+    return testClockMs;
+}
+
+const char* loggedName = nullptr;
+ThresholdTransition loggedTransition = ThresholdTransition::NONE;
+float loggedValue = 0.0f;
+unsigned int loggedCount = 0;
+void testLogger(const char* name, ThresholdTransition transition, float value) {
+    loggedName = name;
+    loggedTransition = transition;
+    loggedValue = value;
+    loggedCount++;
+}
+
+void testInjected() {
+    Threshold::setClock(testClock);
+    Threshold::setLogger(testLogger);
+
+    Threshold threshold({"clock", ThresholdDirection::ABOVE, 1.0, 0.5, 1});
+    testClockMs = 100;
+    TEST_CHECK(threshold.update(0.0) == ThresholdTransition::NONE);
+    testClockMs = 400;
+    TEST_CHECK(threshold.update(2.0) == ThresholdTransition::ENTERED);
+    TEST_CHECK(loggedCount == 1);
+    TEST_CHECK(loggedTransition == ThresholdTransition::ENTERED);
+    TEST_CHECK_NEAR(loggedValue, 2.0, 0.0);
+
+    ThresholdStats stats;
+    threshold.getStats(stats, 1400);
+    TEST_CHECK(stats.inactiveMs == 300);
+    TEST_CHECK(stats.activeMs == 1000);
+
+    // Thresholds without a name are not logged
+    Threshold quiet({nullptr, ThresholdDirection::ABOVE, 1.0, 0.5, 1});
+    quiet.update(2.0);
+    TEST_CHECK(loggedCount == 1);
+
+    Threshold::setClock(nullptr);
+    Threshold::setLogger(nullptr);
+}
+
+} // anonymous namespace
+
+int main() {
+    testAbove();
+    testBelow();
+    testHysteresisEdges();
+    testDebounce();
+    testDwell();
+    testRestore();
+    testSetLimit();
+    testInjected();
+
+    return TEST_RESULT();
+}